@@ -13,19 +13,18 @@ TEMPLATE = app
 
 CONFIG += c++11
 
+include(math_expressions/math_expressions.pri)
+
 SOURCES += main.cpp\
         mainwindow.cpp \
     qcustomplot/qcustomplot.cpp \
-    math_expressions/math_expression_evaluator.cpp \
-    math_expressions/math_expression_parser.cpp \
-    math_expressions/math_expression_symbol.cpp
+    data_export/data_export_writer.cpp \
+    sampling/streaming_sampler.cpp
 
 HEADERS  += mainwindow.h \
     qcustomplot/qcustomplot.h \
-    math_expressions/math_expression_evaluator.h \
-    math_expressions/math_expression_functions.h \
-    math_expressions/math_expression_parser.h \
-    math_expressions/math_expression_symbol.h
+    data_export/data_export_writer.h \
+    sampling/streaming_sampler.h
 
 FORMS    += mainwindow.ui
 
@@ -0,0 +1,28 @@
+#-------------------------------------------------
+#
+# Headless batch plotter, shares the engine with FunctionPlotter
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets printsupport
+
+TARGET = FunctionPlotterCli
+TEMPLATE = app
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+
+include(../math_expressions/math_expressions.pri)
+
+SOURCES += main.cpp \
+    plot_job.cpp \
+    ../qcustomplot/qcustomplot.cpp \
+    ../data_export/data_export_writer.cpp
+
+HEADERS  += plot_job.h \
+    ../qcustomplot/qcustomplot.h \
+    ../data_export/data_export_writer.h
@@ -0,0 +1,172 @@
+#include "plot_job.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QThreadPool>
+
+#include <qcustomplot/qcustomplot.h>
+
+static bool parse_size(const QString& text, int* width, int* height)
+{
+    const QStringList parts = text.toLower().split('x');
+    if (parts.size() != 2) return false;
+    bool width_ok = false, height_ok = false;
+    *width = parts[0].toInt(&width_ok);
+    *height = parts[1].toInt(&height_ok);
+    return width_ok && height_ok && *width > 0 && *height > 0;
+}
+
+// QCustomPlot is a widget, so every image is drawn here, in the GUI thread
+static bool render(QCustomPlot* plot, const PlotResult& result,
+                   int width, int height, QString* error)
+{
+    QCPGraph* graph = plot->graph(0);
+    graph->setData(result.xData, result.yData);
+    plot->xAxis->setRange(result.xData.first(), result.xData.last());
+    double y_min = result.yMin, y_max = result.yMax;
+    if (y_min == y_max) {
+        y_min -= 1;
+        y_max += 1;
+    }
+    plot->yAxis->setRange(y_min, y_max);
+
+    foreach (const QString& output, result.job.outputs) {
+        const QString suffix = QFileInfo(output).suffix().toLower();
+        bool saved = true;
+        if (suffix == "png") {
+            saved = plot->savePng(output, width, height);
+        } else if (suffix == "jpg" || suffix == "jpeg") {
+            saved = plot->saveJpg(output, width, height);
+        } else if (suffix == "bmp") {
+            saved = plot->saveBmp(output, width, height);
+        } else if (suffix == "pdf") {
+            saved = plot->savePdf(output, false, width, height);
+        }
+        if (!saved) {
+            *error = QString("%1: could not be written").arg(output);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    // There is no display on the servers this runs on
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication a(argc, argv);
+    QApplication::setApplicationName("FunctionPlotterCli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+                "Evaluates expressions of x over a range and writes the "
+                "samples (csv, npy, npz, raw) and/or the plot (png, jpg, "
+                "bmp, pdf). Every output extension picks its format.");
+    parser.addHelpOption();
+    QCommandLineOption expressionOption(
+                QStringList() << "e" << "expression",
+                "Expression to evaluate.", "expression");
+    QCommandLineOption fromOption("from", "Lower bound of x.", "number", "-10");
+    QCommandLineOption toOption("to", "Upper bound of x.", "number", "10");
+    QCommandLineOption samplesOption(
+                QStringList() << "n" << "samples",
+                "Number of samples.", "count", "1000");
+    QCommandLineOption outputOption(
+                QStringList() << "o" << "output",
+                "Output file, may be repeated.", "file");
+    QCommandLineOption jobsOption(
+                QStringList() << "j" << "jobs",
+                "File with one job per line: "
+                "expression;from;to;samples;output[;output...]", "file");
+    QCommandLineOption threadsOption(
+                QStringList() << "t" << "threads",
+                "Evaluation threads (default: one per core).", "count");
+    QCommandLineOption sizeOption("size", "Size of the images.",
+                                  "WIDTHxHEIGHT", "800x600");
+    parser.addOption(expressionOption);
+    parser.addOption(fromOption);
+    parser.addOption(toOption);
+    parser.addOption(samplesOption);
+    parser.addOption(outputOption);
+    parser.addOption(jobsOption);
+    parser.addOption(threadsOption);
+    parser.addOption(sizeOption);
+    parser.process(a);
+
+    QTextStream err(stderr);
+    QList<PlotJob> jobs;
+    if (parser.isSet(expressionOption)) {
+        const QStringList fields = QStringList()
+                << parser.value(expressionOption) << parser.value(fromOption)
+                << parser.value(toOption) << parser.value(samplesOption)
+                << parser.values(outputOption);
+        PlotJob job;
+        QString error;
+        if (!parse_job_line(fields.join(";"), &job, &error)) {
+            err << "FunctionPlotterCli: " << error << "\n";
+            err.flush();
+            return 2;
+        }
+        jobs << job;
+    }
+    if (parser.isSet(jobsOption)) {
+        QString error;
+        if (!read_job_file(parser.value(jobsOption), &jobs, &error)) {
+            err << "FunctionPlotterCli: " << error << "\n";
+            err.flush();
+            return 2;
+        }
+    }
+    if (jobs.isEmpty()) {
+        parser.showHelp(2);
+    }
+
+    int width = 0, height = 0;
+    if (!parse_size(parser.value(sizeOption), &width, &height)) {
+        err << "FunctionPlotterCli: invalid size, expected WIDTHxHEIGHT\n";
+        err.flush();
+        return 2;
+    }
+
+    QThreadPool pool;
+    if (parser.isSet(threadsOption)) {
+        const int threads = parser.value(threadsOption).toInt();
+        if (threads > 0) pool.setMaxThreadCount(threads);
+    }
+
+    QCustomPlot plot;
+    QPen pen(QColor("blue"));
+    pen.setWidth(2);
+    QCPGraph* graph = plot.addGraph();
+    graph->setPen(pen);
+    graph->setDataStorage(QCP::dsArray);
+
+    ResultQueue queue(2 * pool.maxThreadCount());
+    foreach (const PlotJob& job, jobs) {
+        pool.start(new JobRunner(job, &queue));
+    }
+
+    int failed = 0;
+    for (int i = 0; i < jobs.size(); i++) {
+        const PlotResult result = queue.pop();
+        QString error = result.error;
+        if (error.isEmpty() && !result.xData.isEmpty()) {
+            render(&plot, result, width, height, &error);
+        }
+        if (!error.isEmpty()) {
+            failed++;
+            if (result.job.line > 0) {
+                err << parser.value(jobsOption) << ":" << result.job.line
+                    << ": ";
+            }
+            err << result.job.expression << ": " << error << "\n";
+            err.flush();
+        }
+    }
+    pool.waitForDone();
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+#include "plot_job.h"
+
+#include "math_expressions/math_expression_parser.h"
+#include "math_expressions/math_expression_evaluator.h"
+#include "data_export/data_export_writer.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace math_expression;
+using data_export::ColumnWriter;
+
+bool is_image_output(const QString& path)
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    return suffix == "png" || suffix == "jpg" || suffix == "jpeg"
+            || suffix == "bmp" || suffix == "pdf";
+}
+
+static bool parse_number(const QString& text, double* value)
+{
+    bool ok = false;
+    *value = text.trimmed().toDouble(&ok);
+    return ok;
+}
+
+// expression;from;to;samples;output[;output...]
+bool parse_job_line(const QString& line, PlotJob* job, QString* error)
+{
+    const QStringList fields = line.split(';');
+    if (fields.size() < 5) {
+        *error = "expected 'expression;from;to;samples;output[;output...]'";
+        return false;
+    }
+    job->expression = fields[0].trimmed();
+    if (job->expression.isEmpty()) {
+        *error = "empty expression";
+        return false;
+    }
+    if (!parse_number(fields[1], &job->from) ||
+            !parse_number(fields[2], &job->to)) {
+        *error = "invalid range";
+        return false;
+    }
+    bool ok = false;
+    job->samples = fields[3].trimmed().toInt(&ok);
+    if (!ok || job->samples < 2) {
+        *error = "the sample count must be an integer of at least 2";
+        return false;
+    }
+    job->outputs.clear();
+    for (int i = 4; i < fields.size(); i++) {
+        const QString output = fields[i].trimmed();
+        if (!output.isEmpty()) job->outputs << output;
+    }
+    if (job->outputs.isEmpty()) {
+        *error = "no output files";
+        return false;
+    }
+    return true;
+}
+
+// Blank lines and lines starting with '#' are skipped
+bool read_job_file(const QString& path, QList<PlotJob>* jobs, QString* error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *error = QString("%1: %2").arg(path, file.errorString());
+        return false;
+    }
+    QTextStream in(&file);
+    int line_number = 0;
+    while (!in.atEnd()) {
+        const QString line = in.readLine().trimmed();
+        line_number++;
+        if (line.isEmpty() || line.startsWith('#')) continue;
+        PlotJob job;
+        QString line_error;
+        if (!parse_job_line(line, &job, &line_error)) {
+            *error = QString("%1:%2: %3").arg(path).arg(line_number)
+                    .arg(line_error);
+            return false;
+        }
+        job.line = line_number;
+        jobs->append(job);
+    }
+    return true;
+}
+
+PlotResult run_job(const PlotJob& job)
+{
+    PlotResult result;
+    result.job = job;
+
+    Parser parser(job.expression.toStdString());
+    Tokens tokens = parser.lexical_analysis();
+    if (parser.error() != Parser::NON) {
+        result.error = "bad expression format";
+        return result;
+    }
+    parser.sintax_analysis(tokens);
+    if (parser.error() != Parser::NON) {
+        result.error = "bad expression sintax";
+        return result;
+    }
+    Instructions instructions = parser.generate_algorithm(tokens);
+    Evaluator evaluator(instructions, tokens);
+    evaluator.set_variable_value('e', 2.71828182846);
+    evaluator.set_variable_value('p', 3.14159265359);
+
+    const double lower_bound = std::min(job.from, job.to);
+    const double upper_bound = std::max(job.from, job.to);
+    const double step = (upper_bound - lower_bound) / (job.samples - 1);
+    QVector<double> x_data(job.samples);
+    QVector<double> y_data(job.samples);
+    // Only finite samples widen the range, one pole or NaN must not hide the curve
+    double y_min = std::numeric_limits<double>::max();
+    double y_max = std::numeric_limits<double>::lowest();
+    bool has_finite = false;
+    for (int i = 0; i < job.samples; i++) {
+        const double x = lower_bound + i * step;
+        x_data[i] = x;
+        if (!evaluator.expression_is_constant()) {
+            evaluator.set_variable_value('x', x);
+        }
+        const double y = evaluator.evaluate();
+        y_data[i] = y;
+        if (std::isfinite(y)) {
+            has_finite = true;
+            if (y < y_min) y_min = y;
+            if (y > y_max) y_max = y;
+        }
+    }
+    if (!has_finite) {
+        y_min = -1;
+        y_max = 1;
+    }
+
+    bool has_images = false;
+    foreach (const QString& output, job.outputs) {
+        if (is_image_output(output)) {
+            has_images = true;
+            continue;
+        }
+        const std::string filename = QFile::encodeName(output).constData();
+        const ColumnWriter::Format format =
+                ColumnWriter::format_from_filename(filename);
+        if (format == ColumnWriter::UNKNOWN) {
+            result.error = QString("%1: unknown output format").arg(output);
+            return result;
+        }
+        ColumnWriter writer(x_data.constData(), y_data.constData(),
+                            x_data.size());
+        if (!writer.write(filename, format)) {
+            result.error = QString("%1: could not be written").arg(output);
+            return result;
+        }
+    }
+
+    // The samples only travel to the renderer when there is something to draw
+    if (has_images) {
+        result.xData = x_data;
+        result.yData = y_data;
+        result.yMin = y_min;
+        result.yMax = y_max;
+    }
+    return result;
+}
+
+void ResultQueue::push(const PlotResult& result)
+{
+    freeSlots.acquire();
+    QMutexLocker locker(&mutex);
+    results.enqueue(result);
+    notEmpty.wakeOne();
+}
+
+PlotResult ResultQueue::pop()
+{
+    QMutexLocker locker(&mutex);
+    while (results.isEmpty()) {
+        notEmpty.wait(&mutex);
+    }
+    PlotResult result = results.dequeue();
+    locker.unlock();
+    freeSlots.release();
+    return result;
+}
+
+void JobRunner::run()
+{
+    queue->push(run_job(job));
+}
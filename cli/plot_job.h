@@ -0,0 +1,78 @@
+#ifndef PLOT_JOB_H
+#define PLOT_JOB_H
+
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+
+/*
+  One sweep of the batch plotter: an expression sampled over [from, to]
+  and the files it has to be written to. The extension of every output
+  picks the format, csv/npy/npz/raw are data and png/jpg/bmp/pdf are
+  rendered images.
+ */
+struct PlotJob
+{
+    PlotJob() : from(0), to(0), samples(0), line(0) {}
+    QString expression;
+    double from;
+    double to;
+    int samples;
+    QStringList outputs;
+    int line; // Line of the job file, 0 for the command line job
+};
+
+struct PlotResult
+{
+    PlotResult() : yMin(0), yMax(0) {}
+    PlotJob job;
+    QVector<double> xData;
+    QVector<double> yData;
+    double yMin;
+    double yMax;
+    QString error;
+};
+
+bool is_image_output(const QString& path);
+bool parse_job_line(const QString& line, PlotJob* job, QString* error);
+bool read_job_file(const QString& path, QList<PlotJob>* jobs, QString* error);
+PlotResult run_job(const PlotJob& job);
+
+/*
+  Hands evaluated jobs from the workers to the thread that renders them.
+  It holds at most 'capacity' results, so the workers cannot get ahead of
+  the renderer by more than that many sample buffers.
+ */
+class ResultQueue
+{
+public:
+    explicit ResultQueue(int capacity) : freeSlots(capacity) {}
+    void push(const PlotResult& result);
+    PlotResult pop();
+
+private:
+    QSemaphore freeSlots;
+    QMutex mutex;
+    QWaitCondition notEmpty;
+    QQueue<PlotResult> results;
+};
+
+class JobRunner : public QRunnable
+{
+public:
+    JobRunner(const PlotJob& job, ResultQueue* queue)
+        : job(job), queue(queue) {}
+    void run();
+
+private:
+    PlotJob job;
+    ResultQueue* queue;
+};
+
+#endif // PLOT_JOB_H
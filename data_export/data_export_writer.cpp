@@ -0,0 +1,310 @@
+#include "data_export_writer.h"
+
+#include <cctype>
+#include <cstring>
+
+using namespace std;
+using namespace data_export;
+
+const char RawHeader::MAGIC[8] = {'F', 'P', 'L', 'T', 'C', 'O', 'L', '1'};
+
+static void put_le(unsigned char* bytes, uint64_t value, int size) {
+  for (int i = 0; i < size; i++) {
+    bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+  }
+}
+
+static uint64_t get_le(const unsigned char* bytes, int size) {
+  uint64_t value = 0;
+  for (int i = size - 1; i >= 0; i--) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+void RawHeader::encode(unsigned char* bytes) const {
+  memcpy(bytes, MAGIC, sizeof(MAGIC));
+  put_le(bytes + 8, SIZE, 4);
+  put_le(bytes + 12, column_count, 4);
+  put_le(bytes + 16, row_count, 8);
+  put_le(bytes + 24, dtype, 4);
+  put_le(bytes + 28, 0, 4);
+}
+
+bool RawHeader::decode(const unsigned char* bytes) {
+  if (memcmp(bytes, MAGIC, sizeof(MAGIC)) != 0 || get_le(bytes + 8, 4) != SIZE) {
+    return false;
+  }
+  column_count = static_cast<uint32_t>(get_le(bytes + 12, 4));
+  row_count = get_le(bytes + 16, 8);
+  dtype = static_cast<uint32_t>(get_le(bytes + 24, 4));
+  return dtype == FLOAT64;
+}
+
+bool ColumnWriter::host_is_little_endian() {
+  const uint16_t probe = 1;
+  unsigned char first;
+  memcpy(&first, &probe, 1);
+  return first == 1;
+}
+
+/*
+  Standard reflected CRC-32 (polynomial 0xEDB88320), as required by the
+  zip container of the npz format.
+ */
+static uint32_t crc32_update(uint32_t crc, const unsigned char* bytes, size_t size) {
+  static const struct Table {
+    Table() {
+      for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+          c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        entries[i] = c;
+      }
+    }
+    uint32_t entries[256];
+  } table;
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc = table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+/*
+  Writes (or, when file is null, only checksums) a column of doubles as
+  little-endian float64. On little-endian hosts the column is handed to
+  fwrite in one call, straight from the caller's buffer; otherwise it is
+  byte-swapped through a fixed size staging buffer.
+ */
+static bool write_column(FILE* file, const double* column, size_t rows, uint32_t* crc) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(column);
+  if (ColumnWriter::host_is_little_endian()) {
+    if (crc) *crc = crc32_update(*crc, bytes, rows * sizeof(double));
+    return !file || fwrite(column, sizeof(double), rows, file) == rows;
+  }
+  const size_t CHUNK = 4096;
+  unsigned char staging[CHUNK * sizeof(double)];
+  for (size_t first = 0; first < rows; first += CHUNK) {
+    const size_t count = rows - first < CHUNK ? rows - first : CHUNK;
+    for (size_t i = 0; i < count; i++) {
+      const unsigned char* value = bytes + (first + i) * sizeof(double);
+      for (size_t b = 0; b < sizeof(double); b++) {
+        staging[i * sizeof(double) + b] = value[sizeof(double) - 1 - b];
+      }
+    }
+    if (crc) *crc = crc32_update(*crc, staging, count * sizeof(double));
+    if (file && fwrite(staging, sizeof(double), count, file) != count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+  Builds a version 1.0 npy header for little-endian doubles. The header is
+  padded with spaces so the data starts at a multiple of 64 bytes.
+ */
+static string npy_header(const string& shape, bool fortran_order) {
+  string dict = "{'descr': '<f8', 'fortran_order': ";
+  dict += fortran_order ? "True" : "False";
+  dict += ", 'shape': " + shape + ", }";
+  const size_t preamble = 10;
+  size_t total = preamble + dict.size() + 1;
+  dict.append((64 - total % 64) % 64, ' ');
+  dict += '\n';
+  string header("\x93NUMPY\x01\x00", 8);
+  header += static_cast<char>(dict.size() & 0xFF);
+  header += static_cast<char>(dict.size() >> 8);
+  return header + dict;
+}
+
+ColumnWriter::Format ColumnWriter::format_from_filename(const string& filename) {
+  const size_t dot = filename.find_last_of('.');
+  if (dot == string::npos) return UNKNOWN;
+  string extension = filename.substr(dot + 1);
+  for (char& c : extension) c = tolower(c);
+  if (extension == "csv") return CSV;
+  if (extension == "npy") return NPY;
+  if (extension == "npz") return NPZ;
+  if (extension == "raw") return RAW;
+  return UNKNOWN;
+}
+
+bool ColumnWriter::write(const string& filename, Format format) const {
+  if (format == UNKNOWN || (rows > 0 && (!x || !y))) return false;
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (!file) return false;
+  bool ok = false;
+  switch (format) {
+    case CSV: ok = write_csv(file); break;
+    case NPY: ok = write_npy(file); break;
+    case NPZ: ok = write_npz(file); break;
+    case RAW: ok = write_raw(file); break;
+    case UNKNOWN: break;
+  }
+  return fclose(file) == 0 && ok;
+}
+
+bool ColumnWriter::write_csv(FILE* file) const {
+  for (size_t i = 0; i < rows; i++) {
+    if (fprintf(file, "%.17g,%.17g\n", x[i], y[i]) < 0) return false;
+  }
+  return true;
+}
+
+bool ColumnWriter::write_npy(FILE* file) const {
+  // Fortran order of a (rows, 2) array is the x column followed by y
+  const string header = npy_header("(" + to_string(rows) + ", 2)", true);
+  return fwrite(header.data(), 1, header.size(), file) == header.size() &&
+         write_column(file, x, rows, nullptr) &&
+         write_column(file, y, rows, nullptr);
+}
+
+bool ColumnWriter::write_raw(FILE* file) const {
+  RawHeader header;
+  header.row_count = rows;
+  unsigned char bytes[RawHeader::SIZE];
+  header.encode(bytes);
+  return fwrite(bytes, 1, sizeof(bytes), file) == sizeof(bytes) &&
+         write_column(file, x, rows, nullptr) &&
+         write_column(file, y, rows, nullptr);
+}
+
+/*
+  The npz archive is a plain zip file whose members are stored without
+  compression, so every member is its npy header followed by the raw
+  column. Zip64 records are only emitted when a size or an offset does
+  not fit in 32 bits.
+ */
+bool ColumnWriter::write_npz(FILE* file) const {
+  struct Member {
+    string name;
+    const double* column;
+    string header;
+    uint64_t size;
+    uint64_t offset;
+    uint32_t crc;
+  };
+  const uint32_t LIMIT = 0xFFFFFFFFu;
+  const string shape = "(" + to_string(rows) + ",)";
+  Member members[2] = {
+    {"x.npy", x, npy_header(shape, false), 0, 0, 0},
+    {"y.npy", y, npy_header(shape, false), 0, 0, 0}
+  };
+
+  uint64_t offset = 0;
+  for (Member& member : members) {
+    member.size = member.header.size() + rows * sizeof(double);
+    member.offset = offset;
+    member.crc = crc32_update(0, reinterpret_cast<const unsigned char*>(
+      member.header.data()), member.header.size());
+    write_column(nullptr, member.column, rows, &member.crc);
+    const bool zip64 = member.size >= LIMIT;
+
+    unsigned char local[30];
+    put_le(local, 0x04034b50, 4);
+    put_le(local + 4, zip64 ? 45 : 20, 2);
+    put_le(local + 6, 0, 2); // flags
+    put_le(local + 8, 0, 2); // stored
+    put_le(local + 10, 0, 2); // 00:00:00
+    put_le(local + 12, 0x21, 2); // 1980-01-01
+    put_le(local + 14, member.crc, 4);
+    put_le(local + 18, zip64 ? LIMIT : member.size, 4);
+    put_le(local + 22, zip64 ? LIMIT : member.size, 4);
+    put_le(local + 26, member.name.size(), 2);
+    put_le(local + 28, zip64 ? 20 : 0, 2);
+    const size_t local_size = sizeof(local);
+    if (fwrite(local, 1, local_size, file) != local_size) return false;
+    if (fwrite(member.name.data(), 1, member.name.size(), file) != member.name.size()) return false;
+    if (zip64) {
+      unsigned char extra[20];
+      put_le(extra, 0x0001, 2);
+      put_le(extra + 2, 16, 2);
+      put_le(extra + 4, member.size, 8);
+      put_le(extra + 12, member.size, 8);
+      if (fwrite(extra, 1, sizeof(extra), file) != sizeof(extra)) return false;
+    }
+    if (fwrite(member.header.data(), 1, member.header.size(), file) != member.header.size() ||
+        !write_column(file, member.column, rows, nullptr)) {
+      return false;
+    }
+    offset += local_size + member.name.size() + (zip64 ? 20 : 0) + member.size;
+  }
+
+  const uint64_t directory_offset = offset;
+  uint64_t directory_size = 0;
+  for (const Member& member : members) {
+    const bool large_size = member.size >= LIMIT;
+    const bool large_offset = member.offset >= LIMIT;
+    const int extra_size = (large_size ? 16 : 0) + (large_offset ? 8 : 0);
+    unsigned char central[46 + 4 + 24];
+    put_le(central, 0x02014b50, 4);
+    put_le(central + 4, 45, 2); // made by
+    put_le(central + 6, extra_size ? 45 : 20, 2);
+    put_le(central + 8, 0, 2);
+    put_le(central + 10, 0, 2);
+    put_le(central + 12, 0, 2);
+    put_le(central + 14, 0x21, 2);
+    put_le(central + 16, member.crc, 4);
+    put_le(central + 20, large_size ? LIMIT : member.size, 4);
+    put_le(central + 24, large_size ? LIMIT : member.size, 4);
+    put_le(central + 28, member.name.size(), 2);
+    put_le(central + 30, extra_size ? extra_size + 4 : 0, 2);
+    put_le(central + 32, 0, 2); // comment
+    put_le(central + 34, 0, 2); // disk
+    put_le(central + 36, 0, 2); // internal attributes
+    put_le(central + 38, 0, 4); // external attributes
+    put_le(central + 42, large_offset ? LIMIT : member.offset, 4);
+    if (fwrite(central, 1, 46, file) != 46) return false;
+    if (fwrite(member.name.data(), 1, member.name.size(), file) != member.name.size()) return false;
+    if (extra_size) {
+      unsigned char* extra = central + 46;
+      put_le(extra, 0x0001, 2);
+      put_le(extra + 2, extra_size, 2);
+      int position = 4;
+      if (large_size) {
+        put_le(extra + position, member.size, 8);
+        put_le(extra + position + 8, member.size, 8);
+        position += 16;
+      }
+      if (large_offset) {
+        put_le(extra + position, member.offset, 8);
+        position += 8;
+      }
+      if (fwrite(extra, 1, position, file) != size_t(position)) return false;
+    }
+    directory_size += 46 + member.name.size() + (extra_size ? extra_size + 4 : 0);
+  }
+
+  if (directory_offset >= LIMIT) {
+    unsigned char record[56 + 20];
+    put_le(record, 0x06064b50, 4);
+    put_le(record + 4, 44, 8);
+    put_le(record + 12, 45, 2);
+    put_le(record + 14, 45, 2);
+    put_le(record + 16, 0, 4);
+    put_le(record + 20, 0, 4);
+    put_le(record + 24, 2, 8);
+    put_le(record + 32, 2, 8);
+    put_le(record + 40, directory_size, 8);
+    put_le(record + 48, directory_offset, 8);
+    unsigned char* locator = record + 56;
+    put_le(locator, 0x07064b50, 4);
+    put_le(locator + 4, 0, 4);
+    put_le(locator + 8, directory_offset + directory_size, 8);
+    put_le(locator + 16, 1, 4);
+    if (fwrite(record, 1, sizeof(record), file) != sizeof(record)) return false;
+  }
+  unsigned char end[22];
+  put_le(end, 0x06054b50, 4);
+  put_le(end + 4, 0, 2);
+  put_le(end + 6, 0, 2);
+  put_le(end + 8, 2, 2);
+  put_le(end + 10, 2, 2);
+  put_le(end + 12, directory_size, 4);
+  put_le(end + 16, directory_offset >= LIMIT ? LIMIT : directory_offset, 4);
+  put_le(end + 20, 0, 2);
+  return fwrite(end, 1, sizeof(end), file) == sizeof(end);
+}
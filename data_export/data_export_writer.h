@@ -0,0 +1,73 @@
+#ifndef DATA_EXPORT_WRITER_H
+#define DATA_EXPORT_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace data_export {
+  class ColumnWriter;
+  struct RawHeader;
+}
+
+/*
+  Header of the raw columnar format (*.raw). Every field is stored
+  little-endian, followed by the x column and then the y column, each one
+  as row_count little-endian doubles.
+
+    offset | size | field
+         0 |    8 | magic "FPLTCOL1"
+         8 |    4 | header_size (bytes, currently 32)
+        12 |    4 | column_count (currently 2: x, y)
+        16 |    8 | row_count
+        24 |    4 | dtype (1 = float64)
+        28 |    4 | reserved
+
+  @author Christian González León
+ */
+struct data_export::RawHeader {
+  static const char MAGIC[8];
+  static const std::uint32_t SIZE = 32;
+  static const std::uint32_t FLOAT64 = 1;
+  std::uint32_t column_count = 2;
+  std::uint64_t row_count = 0;
+  std::uint32_t dtype = FLOAT64;
+  void encode(unsigned char* bytes) const;
+  bool decode(const unsigned char* bytes);
+};
+
+/*
+  Writes two equally sized columns of samples (x and y) straight from
+  their buffers. The binary formats never convert the samples to text:
+  each column is written with a single call from the original memory
+  (on little-endian hosts), so they are suitable for huge sweeps.
+
+    CSV  - text, one "x,y" line per sample
+    NPY  - NumPy array of shape (rows, 2) stored in fortran order,
+           which is exactly the x column followed by the y column
+    NPZ  - uncompressed NumPy archive with the members x.npy and y.npy
+    RAW  - RawHeader followed by the columns
+ */
+class data_export::ColumnWriter {
+ public:
+  enum Format {
+    CSV, NPY, NPZ, RAW, UNKNOWN
+  };
+  ColumnWriter(const double* x, const double* y, std::size_t rows)
+    : x(x), y(y), rows(rows) {}
+  bool write(const std::string& filename, Format format) const;
+  static Format format_from_filename(const std::string& filename);
+  static bool host_is_little_endian();
+ private:
+  bool write_csv(std::FILE* file) const;
+  bool write_npy(std::FILE* file) const;
+  bool write_npz(std::FILE* file) const;
+  bool write_raw(std::FILE* file) const;
+
+  const double* x;
+  const double* y;
+  const std::size_t rows;
+};
+
+#endif // DATA_EXPORT_WRITER_H
@@ -3,17 +3,23 @@
 
 #include "math_expressions/math_expression_parser.h"
 #include "math_expressions/math_expression_evaluator.h"
+#include "math_expressions/math_expression_fused_program.h"
+#include "data_export/data_export_writer.h"
+#include "sampling/streaming_sampler.h"
 
 #include <QDebug>
+#include <QDir>
 #include <QHBoxLayout>
 #include <QFileDialog>
 #include <QVector>
 #include <QToolTip>
 #include <QColor>
 #include <QMessageBox>
+#include <QTemporaryFile>
+#include <QStorageInfo>
 
 #include <algorithm>
-#include <limits>
+#include <cmath>
 
 #include <qcustomplot/qcustomplot.h>
 
@@ -31,6 +37,16 @@ static const QColor COLORS[COLORS_COUNT] = {
     QColor("magenta"), QColor("black"), QColor("yellow")
 };
 
+// Sweeps above this many samples are streamed to disk instead of RAM
+static const int STREAMING_SAMPLES = 1 << 24;
+
+// Streamed sweeps are refused above this many samples, whatever the disk
+static const quint64 MAX_STREAMING_SAMPLES = Q_UINT64_C(1) << 36;
+
+// Disk taken by every streamed sample: the x and y columns, plus the min/max
+// pyramid, which stays under one more double per sample
+static const quint64 STREAMED_SAMPLE_BYTES = 3 * sizeof(double);
+
 typedef QVector<double> Vector;
 
 using namespace std;
@@ -38,7 +54,8 @@ using namespace math_expression;
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow)
+    ui(new Ui::MainWindow),
+    streamedData(nullptr)
 {
     ui->setupUi(this);
     setWindowFlags(Qt::Window);
@@ -61,6 +78,7 @@ MainWindow::~MainWindow()
     delete functionPlot;
     delete horizontalLayout;
     delete ui;
+    delete streamedData;
 }
 
 void MainWindow::on_actionExit_triggered()
@@ -72,7 +90,9 @@ void MainWindow::on_actionSave_plot_triggered()
 {
     QString selectedFilter;
     QString filename = QFileDialog::getSaveFileName(
-                this, "Save", "", "Plot (*.png);;Data (*.csv)",
+                this, "Save", "",
+                "Plot (*.png);;Data (*.csv);;NumPy array (*.npy);;"
+                "NumPy archive (*.npz);;Raw columns (*.raw)",
                 &selectedFilter);
     QString toolTipMessage;
     if (!filename.isEmpty()) {
@@ -82,16 +102,31 @@ void MainWindow::on_actionSave_plot_triggered()
             } else {
                 toolTipMessage = "Error creating image!";
             }
+        } else if (selectedFilter != "Data (*.csv)" &&
+                   ui->tableWidget->columnCount() > 2) {
+            // The binary formats have a single column of values
+            toolTipMessage = "Several expressions can only be saved as csv!";
+        } else if (selectedFilter != "Data (*.csv)" || streamedData) {
+            // Streamed sweeps are not in the table, their csv is written
+            // from the samples on disk
+            if (save_column_data(filename, selectedFilter)) {
+                toolTipMessage = "Data file created correctly!";
+            } else {
+                toolTipMessage = "Error creating data file!";
+            }
         } else {
             QFile file(filename);
             if (file.open(QIODevice::WriteOnly)) {
                 QTextStream textStream(&file);
+                // One column for x and one for every expression
                 const int rows = ui->tableWidget->rowCount();
+                const int columns = ui->tableWidget->columnCount();
                 for (int i = 0; i < rows; i++) {
-                    auto item1 = ui->tableWidget->item(i, 0);
-                    auto item2 = ui->tableWidget->item(i, 1);
-                    textStream << item1->text() << ','
-                               << item2->text() << '\n';
+                    for (int j = 0; j < columns; j++) {
+                        if (j > 0) textStream << ',';
+                        textStream << ui->tableWidget->item(i, j)->text();
+                    }
+                    textStream << '\n';
                 }
                 file.flush();
                 file.close();
@@ -104,6 +139,73 @@ void MainWindow::on_actionSave_plot_triggered()
     show_lineedit_tooltip(toolTipMessage);
 }
 
+/*
+  Writes the columns of a raw file in another format. The columns are
+  mapped instead of read, so they don't need to fit in memory.
+ */
+static bool convert_raw_data(const QString& raw_path, const QString& filename,
+                             data_export::ColumnWriter::Format format)
+{
+    using data_export::ColumnWriter;
+    using data_export::RawHeader;
+    using sampling::MappedFile;
+    MappedFile raw;
+    if (!ColumnWriter::host_is_little_endian() ||
+            !raw.open(QFile::encodeName(raw_path).constData())) {
+        return false;
+    }
+    MappedFile::View header_view = raw.map(0, RawHeader::SIZE);
+    RawHeader header;
+    const bool valid = header_view.data && header.decode(
+                reinterpret_cast<const unsigned char*>(header_view.data));
+    MappedFile::unmap(header_view);
+    if (!valid || header.column_count != 2 ||
+            header.dtype != RawHeader::FLOAT64) {
+        return false;
+    }
+    const quint64 rows = header.row_count;
+    MappedFile::View columns = raw.map(RawHeader::SIZE,
+                                       2 * rows * sizeof(double));
+    if (!columns.data) return false;
+    const double* x = reinterpret_cast<const double*>(columns.data);
+    ColumnWriter writer(x, x + rows, rows);
+    const bool written =
+            writer.write(QFile::encodeName(filename).constData(), format);
+    MappedFile::unmap(columns);
+    return written;
+}
+
+bool MainWindow::save_column_data(const QString& filename,
+                                  const QString& filter) const
+{
+    using data_export::ColumnWriter;
+    ColumnWriter::Format format = ColumnWriter::RAW;
+    if (filter == "NumPy array (*.npy)") {
+        format = ColumnWriter::NPY;
+    } else if (filter == "NumPy archive (*.npz)") {
+        format = ColumnWriter::NPZ;
+    } else if (filter == "Data (*.csv)") {
+        format = ColumnWriter::CSV;
+    }
+    if (streamedData) {
+        // Streamed sweeps only exist on disk, already in the raw format
+        if (format == ColumnWriter::RAW) {
+            QFile::remove(filename);
+            return QFile::copy(streamedData->fileName(), filename);
+        }
+        return convert_raw_data(streamedData->fileName(), filename, format);
+    }
+    ColumnWriter writer(lastXData.constData(), lastYData.constData(),
+                        lastXData.size());
+    return writer.write(QFile::encodeName(filename).constData(), format);
+}
+
+void MainWindow::clear_streamed_data()
+{
+    delete streamedData;
+    streamedData = nullptr;
+}
+
 void MainWindow::show_lineedit_tooltip(const QString& str) const
 {
     QToolTip::showText(ui->functionLineEdit->pos(), str,
@@ -154,6 +256,36 @@ void MainWindow::configure_widgets()
     ui->tableWidget->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
 }
 
+void MainWindow::sweep_range(double& lower_bound, double& upper_bound,
+                             double& step) const
+{
+    const double a = ui->fromLineEdit->text().toDouble();
+    const double b = ui->toLineEdit->text().toDouble();
+    lower_bound = min(a, b);
+    upper_bound = max(a, b);
+    step = ui->samplesLineEdit->text().toDouble();
+    const int option = ui->comboBox->currentIndex();
+
+    if (option == 0) {
+        step = (upper_bound - lower_bound) / step;
+    } else {
+        if (step >= (upper_bound - lower_bound) / 2) {
+            step = (upper_bound - lower_bound) * 0.05;
+            show_lineedit_tooltip(
+                        "Steps set automatically "
+                        "to 5 percent of the range");
+        }
+    }
+}
+
+void MainWindow::reset_table(const QStringList& functions)
+{
+    ui->tableWidget->clearContents();
+    ui->tableWidget->setRowCount(0);
+    ui->tableWidget->setColumnCount(functions.size() + 1);
+    ui->tableWidget->setHorizontalHeaderLabels(QStringList("X") + functions);
+}
+
 void MainWindow::on_plotButton_clicked()
 {
     if (!valid_numbers()) {
@@ -171,7 +303,21 @@ void MainWindow::on_plotButton_clicked()
 
     qDebug() << "Numeros validos";
 
-    auto expression = ui->functionLineEdit->text().toStdString();
+    // Blank entries, e.g. after a trailing ';', are not expressions
+    QStringList expressions;
+    for (const QString& part : ui->functionLineEdit->text().split(';')) {
+        if (!part.trimmed().isEmpty()) {
+            expressions << part;
+        }
+    }
+    if (expressions.size() > 1) {
+        plot_fused(expressions);
+        return;
+    }
+
+    auto expression = expressions.isEmpty()
+            ? ui->functionLineEdit->text().toStdString()
+            : expressions.first().toStdString();
     Parser parser(expression);
     Tokens tokens = parser.lexical_analysis();
     if (parser.error() == Parser::NON) {
@@ -182,33 +328,31 @@ void MainWindow::on_plotButton_clicked()
             Evaluator evaluator(instructions, tokens);
             evaluator.set_variable_value('e', 2.71828182846);
             evaluator.set_variable_value('p', 3.14159265359);
-            const double a = ui->fromLineEdit->text().toDouble();
-            const double b = ui->toLineEdit->text().toDouble();
-            const double lower_bound = min(a, b);
-            const double upper_bound = max(a, b);
-            double step = ui->samplesLineEdit->text().toDouble();
-            const int option = ui->comboBox->currentIndex();
-
-            if (option == 0) {
-                step = (upper_bound - lower_bound) / step;
-            } else {
-                if (step >= (upper_bound - lower_bound) / 2) {
-                    step = (upper_bound - lower_bound) * 0.05;
-                    show_lineedit_tooltip(
-                                "Steps set automatically "
-                                "to 5 percent of the range");
-                }
+            double lower_bound, upper_bound, step;
+            sweep_range(lower_bound, upper_bound, step);
+            const double samples = (upper_bound - lower_bound) / step;
+            if (!std::isfinite(samples) || samples < 0) {
+                show_lineedit_tooltip("Invalid number of samples");
+                return;
+            }
+            if (samples > MAX_STREAMING_SAMPLES) {
+                show_lineedit_tooltip(QString("Too many samples, at most %1 "
+                                              "can be streamed")
+                                      .arg(MAX_STREAMING_SAMPLES));
+                return;
             }
+            reset_table(QStringList("f(X)"));
 
-            ui->tableWidget->clearContents();
-            ui->tableWidget->setRowCount(0);
+            if (samples > STREAMING_SAMPLES) {
+                plot_streamed(evaluator, lower_bound, upper_bound, samples);
+                return;
+            }
+            clear_streamed_data();
 
-            int data_lenght = (upper_bound - lower_bound) / step;
+            int data_lenght = samples;
             double x = lower_bound;
             Vector x_data(data_lenght);
             Vector y_data(data_lenght);
-            double y_min = numeric_limits<double>::max();
-            double y_max = numeric_limits<double>::lowest();
 
             qDebug() << "Computando funcion";
             for (int i = 0; i < data_lenght; i++) {
@@ -227,21 +371,12 @@ void MainWindow::on_plotButton_clicked()
                 item2->setTextAlignment(Qt::AlignCenter);
                 ui->tableWidget->setItem(i, 0, item1);
                 ui->tableWidget->setItem(i, 1, item2);
-
-                if (y_data[i] < y_min) y_min = y_data[i];
-                if (y_data[i] > y_max) y_max = y_data[i];
                 x += step;
             }
             qDebug() << "Funcion computada";
-            functionPlot->addGraph();
-            int last_graph_index = functionPlot->graphCount() - 1;
-            QPen pen(COLORS[last_graph_index % COLORS_COUNT]);
-            pen.setWidth(3);
-            functionPlot->graph(last_graph_index)->setPen(pen);
-            functionPlot->graph(last_graph_index)->setData(x_data, y_data);
-            functionPlot->xAxis->setRange(lower_bound, upper_bound);
-            functionPlot->yAxis->setRange(y_min, y_max);
-            functionPlot->replot();
+            lastXData = x_data;
+            lastYData = y_data;
+            add_graph(x_data, y_data, QCPRange(lower_bound, upper_bound));
         } else { // Sintax error
             show_lineedit_tooltip("Bad expression sintax");
         }
@@ -250,6 +385,194 @@ void MainWindow::on_plotButton_clicked()
     }
 }
 
+/*
+  The y axis is fitted to the values of the graph inside x_range, which the
+  graph finds without scanning its samples. With enlarge_y_range, the y
+  range only grows, to fit several graphs.
+ */
+void MainWindow::add_graph(const QVector<double>& x_data,
+                           const QVector<double>& y_data,
+                           const QCPRange& x_range, bool enlarge_y_range,
+                           bool replot)
+{
+    functionPlot->addGraph();
+    int last_graph_index = functionPlot->graphCount() - 1;
+    QPen pen(COLORS[last_graph_index % COLORS_COUNT]);
+    pen.setWidth(3);
+    functionPlot->graph(last_graph_index)->setPen(pen);
+    // Sampled functions come sorted by x, so the arrays are loaded as they are
+    functionPlot->graph(last_graph_index)->setDataStorage(QCP::dsArray);
+    functionPlot->graph(last_graph_index)->setData(x_data, y_data);
+    functionPlot->xAxis->setRange(x_range);
+    functionPlot->graph(last_graph_index)->rescaleValueAxis(enlarge_y_range,
+                                                            false, true);
+    if (replot) {
+        functionPlot->replot();
+    }
+}
+
+/*
+  Samples the function in fixed size chunks into a temporary raw file and
+  plots it from the min/max pyramid built while streaming, so neither the
+  samples nor the table ever need to fit in memory.
+ */
+void MainWindow::plot_streamed(Evaluator& evaluator, double lower_bound,
+                               double upper_bound, quint64 samples)
+{
+    // Unique names, so several instances never share their samples. The
+    // files are removed with their QTemporaryFile.
+    const QDir tempDir = QDir::temp();
+    const qint64 available = QStorageInfo(tempDir).bytesAvailable();
+    if (available >= 0 &&
+            samples > static_cast<quint64>(available) / STREAMED_SAMPLE_BYTES) {
+        show_lineedit_tooltip(QString("Not enough free space in %1 to stream "
+                                      "%2 samples")
+                              .arg(QDir::toNativeSeparators(tempDir.path()))
+                              .arg(samples));
+        return;
+    }
+    QTemporaryFile* dataFile =
+            new QTemporaryFile(tempDir.filePath("function_plotter_XXXXXX.raw"));
+    QTemporaryFile pyramidFile(tempDir.filePath("function_plotter_XXXXXX.lod"));
+    if (!dataFile->open() || !pyramidFile.open()) {
+        delete dataFile;
+        show_lineedit_tooltip("Error creating the temporary sample files");
+        return;
+    }
+    // The sampler writes them through its own handles
+    dataFile->close();
+    pyramidFile.close();
+    const QString dataPath = dataFile->fileName();
+    const QString pyramidPath = pyramidFile.fileName();
+    const bool constant = evaluator.expression_is_constant();
+    sampling::StreamingSampler sampler([&evaluator, constant](double x) {
+        if (!constant) {
+            evaluator.set_variable_value('x', x);
+        }
+        return evaluator.evaluate();
+    });
+
+    qDebug() << "Computando funcion en disco";
+    sampling::LodPyramid pyramid;
+    if (!sampler.run(lower_bound, upper_bound, samples,
+                     QFile::encodeName(dataPath).constData(),
+                     QFile::encodeName(pyramidPath).constData()) ||
+            !pyramid.open(QFile::encodeName(pyramidPath).constData())) {
+        delete dataFile;
+        show_lineedit_tooltip("Error streaming the samples to disk");
+        return;
+    }
+    clear_streamed_data();
+    streamedData = dataFile;
+    lastXData.clear();
+    lastYData.clear();
+
+    const int level = pyramid.level_for(samples, functionPlot->axisRect()->width());
+    const int buckets = pyramid.bucket_count(level);
+    Vector minima(buckets);
+    Vector maxima(buckets);
+    pyramid.read(level, 0, buckets, minima.data(), maxima.data());
+    const double bucket_width =
+            (upper_bound - lower_bound) / samples * pyramid.bucket_size(level);
+    Vector x_data;
+    Vector y_data;
+    x_data.reserve(2 * buckets);
+    y_data.reserve(2 * buckets);
+    for (int i = 0; i < buckets; i++) {
+        const double x = lower_bound + i * bucket_width;
+        // The last bucket may be partial, its points stay inside the range
+        x_data << min(x + bucket_width * 0.25, upper_bound)
+               << min(x + bucket_width * 0.75, upper_bound);
+        y_data << minima[i] << maxima[i];
+    }
+    add_graph(x_data, y_data, QCPRange(lower_bound, upper_bound));
+    show_lineedit_tooltip(QString("%1 samples streamed to %2")
+                          .arg(samples).arg(QDir::toNativeSeparators(dataPath)));
+}
+
+/*
+  Plots several ';' separated expressions over the same samples of x. They
+  are compiled into one FusedProgram, so the subexpressions they have in
+  common are evaluated once per sample, and every graph is built from the
+  same x vector.
+ */
+void MainWindow::plot_fused(const QStringList& expressions)
+{
+    FusedProgram program;
+    for (const QString& expression : expressions) {
+        Parser parser(expression.trimmed().toStdString());
+        Tokens tokens = parser.lexical_analysis();
+        if (parser.error() == Parser::NON) {
+            parser.sintax_analysis(tokens);
+        }
+        if (parser.error() == Parser::LEXICAL) {
+            show_lineedit_tooltip("Bad expression format: " + expression);
+            return;
+        } else if (parser.error() == Parser::GRAMMAR) {
+            show_lineedit_tooltip("Bad expression sintax: " + expression);
+            return;
+        }
+        program.add_expression(parser.generate_algorithm(tokens));
+    }
+    program.set_variable_value('e', 2.71828182846);
+    program.set_variable_value('p', 3.14159265359);
+
+    double lower_bound, upper_bound, step;
+    sweep_range(lower_bound, upper_bound, step);
+    const double samples = (upper_bound - lower_bound) / step;
+    if (!std::isfinite(samples) || samples < 0) {
+        show_lineedit_tooltip("Invalid number of samples");
+        return;
+    }
+    if (samples > STREAMING_SAMPLES) {
+        show_lineedit_tooltip("Too many samples to plot several "
+                              "expressions at once");
+        return;
+    }
+    clear_streamed_data();
+
+    const int data_lenght = samples;
+    const int count = expressions.size();
+    Vector x_data(data_lenght);
+    for (int i = 0; i < data_lenght; i++) {
+        x_data[i] = lower_bound + i * step;
+    }
+    QVector<Vector> y_data(count, Vector(data_lenght));
+    QVector<double*> outputs(count);
+    for (int j = 0; j < count; j++) {
+        outputs[j] = y_data[j].data();
+    }
+    qDebug() << "Computando" << count << "funciones," <<
+                program.operation_count() << "operaciones por muestra";
+    program.evaluate(x_data.constData(), data_lenght, outputs.constData());
+
+    QStringList functions;
+    for (int j = 0; j < count; j++) {
+        functions << expressions[j].trimmed();
+    }
+    reset_table(functions);
+    ui->tableWidget->setRowCount(data_lenght);
+    for (int i = 0; i < data_lenght; i++) {
+        for (int j = 0; j <= count; j++) {
+            const double value = j == 0 ? x_data[i] : y_data[j - 1][i];
+            auto item = new QTableWidgetItem(QString::number(value));
+            item->setFlags(item->flags() & ~Qt::ItemIsEditable);
+            item->setTextAlignment(Qt::AlignCenter);
+            ui->tableWidget->setItem(i, j, item);
+        }
+    }
+
+    // Only the csv export, written from the table, holds several
+    // expressions, the binary exports are refused
+    lastXData.clear();
+    lastYData.clear();
+    for (int j = 0; j < count; j++) {
+        add_graph(x_data, y_data[j], QCPRange(lower_bound, upper_bound),
+                  j > 0, false);
+    }
+    functionPlot->replot();
+}
+
 void MainWindow::on_youTubeBtn_clicked()
 {
     QUrl url("https://www.youtube.com/channel/UCMuuMrfDz0Mh9fQOcbBlffQ");
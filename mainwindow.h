@@ -3,13 +3,21 @@
 
 #include <QMainWindow>
 #include <QRegExp>
+#include <QStringList>
+#include <QVector>
 
 namespace Ui {
   class MainWindow;
 }
 
 class QCustomPlot;
+class QCPRange;
 class QHBoxLayout;
+class QTemporaryFile;
+
+namespace math_expression {
+  class Evaluator;
+}
 
 class MainWindow : public QMainWindow {
   Q_OBJECT
@@ -33,6 +41,9 @@ private:
 
   QCustomPlot* functionPlot;
   QHBoxLayout* horizontalLayout;
+  QVector<double> lastXData;
+  QVector<double> lastYData;
+  QTemporaryFile* streamedData; // raw samples of the last streamed sweep
 
   static const QRegExp NUMBERS_REGEX;
   static const QString ABOUT_STR;
@@ -40,6 +51,17 @@ private:
   bool valid_numbers() const;
   void configure_widgets();
   void show_lineedit_tooltip(const QString& str) const;
+  bool save_column_data(const QString& filename, const QString& filter) const;
+  void clear_streamed_data();
+  void add_graph(const QVector<double>& x_data, const QVector<double>& y_data,
+                 const QCPRange& x_range, bool enlarge_y_range = false,
+                 bool replot = true);
+  void sweep_range(double& lower_bound, double& upper_bound,
+                   double& step) const;
+  void reset_table(const QStringList& functions);
+  void plot_fused(const QStringList& expressions);
+  void plot_streamed(math_expression::Evaluator& evaluator, double lower_bound,
+                     double upper_bound, quint64 samples);
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,9 @@
+#include "math_expression_global.h"
+
+int math_expression::version() {
+  return MATH_EXPRESSION_VERSION;
+}
+
+const char* math_expression::version_string() {
+  return MATH_EXPRESSION_VERSION_STRING;
+}
@@ -0,0 +1,28 @@
+#ifndef MATH_EXPRESSION_H
+#define MATH_EXPRESSION_H
+
+/*
+  Public header of the math_expressions library, the only one programs
+  linking it need to include:
+
+    math_expression::Parser parser("sin(x) * 2");
+    math_expression::Tokens tokens = parser.lexical_analysis();
+    parser.sintax_analysis(tokens);
+    if (parser.error() == math_expression::Parser::NON) {
+      math_expression::Evaluator evaluator(
+          parser.generate_algorithm(tokens), tokens);
+      evaluator.set_variable_value('x', 0.5);
+      double y = evaluator.evaluate();
+    }
+
+  @author Christian González León
+ */
+
+#include "math_expression_global.h"
+#include "math_expression_symbol.h"
+#include "math_expression_functions.h"
+#include "math_expression_parser.h"
+#include "math_expression_evaluator.h"
+#include "math_expression_fused_program.h"
+
+#endif // MATH_EXPRESSION_H
@@ -10,7 +10,7 @@ namespace math_expression {
   class Evaluator;
 }
 
-class math_expression::Evaluator {
+class MATH_EXPRESSION_API math_expression::Evaluator {
  public:
   Evaluator(const Instructions& instructions, const Tokens& tokens = {});
   ~Evaluator() { delete[] adress; }
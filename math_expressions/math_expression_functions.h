@@ -24,7 +24,9 @@ namespace math_expression {
   inline double division(double a, double b) {
     return a / b;
   }
-  // The pow function is already in cmath
+  inline double power(double a, double b) {
+    return ::pow(a, b);
+  }
   // sin, cos, ..., etc spect one argument but I need two
   inline double sin(double x, double /*unused*/) {
     return ::sin(x);
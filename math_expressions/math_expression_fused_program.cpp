@@ -0,0 +1,240 @@
+#include "math_expression_fused_program.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <string>
+
+using namespace std;
+using namespace math_expression;
+
+const size_t FusedProgram::CHUNK_SIZE;
+
+// Every other function ignores its second argument. The addresses compared
+// are the ones the parser of this library stored in the instructions.
+static bool is_binary(Function function) {
+  return function == binary_addition || function == binary_subtraction ||
+         function == multiplication || function == division ||
+         function == power;
+}
+
+FusedProgram::FusedProgram(char sweep_variable)
+    : sweep_variable(sweep_variable), compiled(false), register_count(0) {}
+
+int FusedProgram::intern(const Node& node) {
+  uint64_t bits = 0;
+  memcpy(&bits, &node.value, sizeof bits);
+  const NodeKey key(node.kind, bits, node.variable,
+                    reinterpret_cast<uintptr_t>(node.function),
+                    node.left, node.right);
+  auto found = node_index.find(key);
+  if (found != node_index.end()) return found->second;
+  nodes.push_back(node);
+  node_index[key] = nodes.size() - 1;
+  return nodes.size() - 1;
+}
+
+int FusedProgram::constant_node(double value) {
+  Node node = {CONSTANT, value, 0, nullptr, -1, -1};
+  return intern(node);
+}
+
+// Same interpretation of the operands as Evaluator::evaluate
+int FusedProgram::operand_node(const Operand& operand,
+                               const vector<int>& adresses) {
+  if (isalpha(static_cast<unsigned char>(operand.value[0]))) {
+    Node node = {VARIABLE, 0, operand.value[0], nullptr, -1, -1};
+    return intern(node);
+  }
+  const double value = stod(operand.value);
+  if (operand.is_value) return constant_node(value);
+  const int adress = int(value);
+  if (adress < 0 || adress >= int(adresses.size()) || adresses[adress] < 0) {
+    return constant_node(0);
+  }
+  return adresses[adress];
+}
+
+/*
+  Merges the instructions of an expression into the program and returns
+  the index of its output.
+ */
+int FusedProgram::add_expression(const Instructions& instructions) {
+  vector<int> adresses(instructions.size(), -1);
+  for (const Operation& operation : instructions) {
+    int left = operand_node(operation.left, adresses);
+    int right = is_binary(operation.function)
+        ? operand_node(operation.right, adresses) : constant_node(0);
+    // a + b and b + a are the same node
+    if ((operation.function == binary_addition ||
+         operation.function == multiplication) && left > right) {
+      swap(left, right);
+    }
+    Node node = {OPERATION, 0, 0, operation.function, left, right};
+    const int index = intern(node);
+    if (operation.result_adress >= 0 &&
+        operation.result_adress < int(adresses.size())) {
+      adresses[operation.result_adress] = index;
+    }
+  }
+  // The value of an expression is the one at its last adress
+  int output = adresses.empty() ? -1 : adresses.back();
+  if (output < 0) output = constant_node(0);
+  outputs.push_back(output);
+  compiled = false;
+  return outputs.size() - 1;
+}
+
+void FusedProgram::set_variable_value(char var, double value) {
+  if (var == sweep_variable) return;
+  variables[var] = value;
+  compiled = false;
+}
+
+/*
+  Folds every node that does not depend on the sweep variable and lays out
+  the rest as a list of steps, in the order the nodes were created (which
+  is already a topological order). A register holds one chunk of values
+  and is reused as soon as the last step reading it has run.
+ */
+void FusedProgram::compile() {
+  const int N = nodes.size();
+  vector<bool> uniform(N, true);
+  vector<double> value(N, 0);
+  for (int i = 0; i < N; i++) {
+    const Node& node = nodes[i];
+    if (node.kind == CONSTANT) {
+      value[i] = node.value;
+    } else if (node.kind == VARIABLE) {
+      if (node.variable == sweep_variable) {
+        uniform[i] = false;
+      } else {
+        auto found = variables.find(node.variable);
+        value[i] = found == variables.end() ? 0 : found->second;
+      }
+    } else {
+      uniform[i] = uniform[node.left] && uniform[node.right];
+      if (uniform[i]) {
+        value[i] = node.function(value[node.left], value[node.right]);
+      }
+    }
+  }
+
+  vector<bool> needed(N, false);
+  for (int output : outputs) needed[output] = true;
+  for (int i = N - 1; i >= 0; i--) {
+    if (needed[i] && !uniform[i] && nodes[i].kind == OPERATION) {
+      needed[nodes[i].left] = true;
+      needed[nodes[i].right] = true;
+    }
+  }
+
+  const int ALWAYS = numeric_limits<int>::max();
+  vector<int> step_of(N, -1);
+  vector<int> last_use(N, -1);
+  int step_count = 0;
+  for (int i = 0; i < N; i++) {
+    if (needed[i] && !uniform[i] && nodes[i].kind == OPERATION) {
+      last_use[nodes[i].left] = step_count;
+      last_use[nodes[i].right] = step_count;
+      step_of[i] = step_count++;
+    }
+  }
+  for (int output : outputs) last_use[output] = ALWAYS;
+
+  vector<int> register_of(N, -1);
+  vector<int> free_registers;
+  register_count = 0;
+  auto slot_of = [&](int i) {
+    Slot slot = {Slot::CONSTANT, value[i], -1};
+    if (!uniform[i]) {
+      if (nodes[i].kind == VARIABLE) {
+        slot.kind = Slot::SWEEP;
+      } else {
+        slot.kind = Slot::REGISTER;
+        slot.index = register_of[i];
+      }
+    }
+    return slot;
+  };
+
+  steps.clear();
+  for (int i = 0; i < N; i++) {
+    if (step_of[i] < 0) continue;
+    const Node& node = nodes[i];
+    Step step = {node.function, slot_of(node.left), slot_of(node.right), -1};
+    // Operands read for the last time can hold the result, the steps
+    // work element by element
+    for (int operand : {node.left, node.right}) {
+      if (last_use[operand] == step_of[i] && register_of[operand] >= 0) {
+        free_registers.push_back(register_of[operand]);
+        register_of[operand] = -1;
+      }
+    }
+    if (free_registers.empty()) {
+      register_of[i] = register_count++;
+    } else {
+      register_of[i] = free_registers.back();
+      free_registers.pop_back();
+    }
+    step.result = register_of[i];
+    steps.push_back(step);
+  }
+
+  output_slots.clear();
+  for (int output : outputs) output_slots.push_back(slot_of(output));
+  registers.assign(register_count * CHUNK_SIZE, 0);
+  compiled = true;
+}
+
+size_t FusedProgram::operation_count() {
+  if (!compiled) compile();
+  return steps.size();
+}
+
+/*
+  Fills outputs[i][0 .. count) with the values of the i-th expression at
+  x[0 .. count).
+ */
+void FusedProgram::evaluate(const double* x, size_t count,
+                            double* const* outputs) {
+  if (!compiled) compile();
+  double* const base = registers.data();
+  for (size_t first = 0; first < count; first += CHUNK_SIZE) {
+    const size_t n = min(CHUNK_SIZE, count - first);
+    const double* sweep = x + first;
+    for (const Step& step : steps) {
+      double* result = base + step.result * CHUNK_SIZE;
+      const Slot& left = step.left;
+      const Slot& right = step.right;
+      const double* a = left.kind == Slot::SWEEP ? sweep
+                      : left.kind == Slot::REGISTER
+                      ? base + left.index * CHUNK_SIZE : nullptr;
+      const double* b = right.kind == Slot::SWEEP ? sweep
+                      : right.kind == Slot::REGISTER
+                      ? base + right.index * CHUNK_SIZE : nullptr;
+      const Function function = step.function;
+      if (left.kind != Slot::CONSTANT && right.kind != Slot::CONSTANT) {
+        for (size_t i = 0; i < n; i++) result[i] = function(a[i], b[i]);
+      } else if (right.kind == Slot::CONSTANT && left.kind != Slot::CONSTANT) {
+        const double value = right.value;
+        for (size_t i = 0; i < n; i++) result[i] = function(a[i], value);
+      } else {
+        const double value = left.value;
+        for (size_t i = 0; i < n; i++) result[i] = function(value, b[i]);
+      }
+    }
+    for (size_t j = 0; j < output_slots.size(); j++) {
+      const Slot& slot = output_slots[j];
+      double* output = outputs[j] + first;
+      if (slot.kind == Slot::CONSTANT) {
+        fill(output, output + n, slot.value);
+      } else {
+        const double* values = slot.kind == Slot::SWEEP ? sweep
+                             : base + slot.index * CHUNK_SIZE;
+        copy(values, values + n, output);
+      }
+    }
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef MATH_EXPRESSION_FUSED_PROGRAM_H
+#define MATH_EXPRESSION_FUSED_PROGRAM_H
+
+#include "math_expression_global.h"
+#include "math_expression_parser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace math_expression {
+  class FusedProgram;
+}
+
+/*
+  Evaluates several expressions over the same samples of one variable
+  (x by default) in a single pass. The instructions of every expression
+  are merged into one graph where equal subexpressions, like the sin(x) or
+  x^2 shared by a family of approximations, are a single node, so they are
+  computed once per sample. Every other variable is a constant of the
+  program and everything that only depends on constants is folded when
+  compiling. The samples are processed in chunks, each node producing a
+  whole chunk of values at a time.
+
+  Usage:
+    FusedProgram program;
+    program.add_expression(parser1.generate_algorithm(tokens1));
+    program.add_expression(parser2.generate_algorithm(tokens2));
+    program.set_variable_value('p', 3.14159265359);
+    double* outputs[] = {y1, y2};
+    program.evaluate(x, n, outputs);
+
+  @author Christian González León
+ */
+class MATH_EXPRESSION_API math_expression::FusedProgram {
+ public:
+  explicit FusedProgram(char sweep_variable = 'x');
+  int add_expression(const Instructions& instructions);
+  void set_variable_value(char var, double value);
+  void compile();
+  void evaluate(const double* x, std::size_t count, double* const* outputs);
+  std::size_t expression_count() const { return outputs.size(); }
+  std::size_t node_count() const { return nodes.size(); }
+  std::size_t operation_count(); // per sample operations once compiled
+
+  static const std::size_t CHUNK_SIZE = 256;
+ private:
+  enum NodeKind {
+    CONSTANT, VARIABLE, OPERATION
+  };
+  struct Node {
+    NodeKind kind;
+    double value; // CONSTANT
+    char variable; // VARIABLE
+    Function function; // OPERATION
+    int left, right; // OPERATION
+  };
+  typedef std::tuple<int, std::uint64_t, char, std::uintptr_t, int, int> NodeKey;
+  // Source of the values of an operand during evaluation
+  struct Slot {
+    enum Kind { CONSTANT, SWEEP, REGISTER } kind;
+    double value;
+    int index;
+  };
+  struct Step {
+    Function function;
+    Slot left, right;
+    int result; // register
+  };
+
+  int intern(const Node& node);
+  int constant_node(double value);
+  int operand_node(const Operand& operand, const std::vector<int>& adresses);
+
+  char sweep_variable;
+  std::vector<Node> nodes;
+  std::map<NodeKey, int> node_index;
+  std::vector<int> outputs; // node of every expression
+  std::map<char, double> variables;
+
+  bool compiled;
+  std::vector<Step> steps;
+  std::vector<Slot> output_slots;
+  int register_count;
+  std::vector<double> registers;
+};
+
+#endif // MATH_EXPRESSION_FUSED_PROGRAM_H
@@ -0,0 +1,44 @@
+#ifndef MATH_EXPRESSION_GLOBAL_H
+#define MATH_EXPRESSION_GLOBAL_H
+
+/*
+  Version and linkage of the math_expressions library. The version follows
+  semantic versioning: the major number only changes when the public
+  headers stop being source or binary compatible.
+
+  The library is static by default. When it is built as a shared library
+  it is compiled with MATH_EXPRESSION_BUILD_SHARED and its users have to
+  define MATH_EXPRESSION_SHARED.
+
+  @author Christian González León
+ */
+
+#define MATH_EXPRESSION_VERSION_MAJOR 1
+#define MATH_EXPRESSION_VERSION_MINOR 0
+#define MATH_EXPRESSION_VERSION_PATCH 0
+#define MATH_EXPRESSION_VERSION_STRING "1.0.0"
+#define MATH_EXPRESSION_VERSION \
+  ((MATH_EXPRESSION_VERSION_MAJOR << 16) | \
+   (MATH_EXPRESSION_VERSION_MINOR << 8) | MATH_EXPRESSION_VERSION_PATCH)
+
+#if defined(MATH_EXPRESSION_BUILD_SHARED)
+#  if defined(_WIN32)
+#    define MATH_EXPRESSION_API __declspec(dllexport)
+#  else
+#    define MATH_EXPRESSION_API __attribute__((visibility("default")))
+#  endif
+#elif defined(MATH_EXPRESSION_SHARED) && defined(_WIN32)
+#  define MATH_EXPRESSION_API __declspec(dllimport)
+#else
+#  define MATH_EXPRESSION_API
+#endif
+
+namespace math_expression {
+  // Version of the library the program runs with, which may differ from
+  // MATH_EXPRESSION_VERSION (the one it was compiled against) when linked
+  // as a shared library.
+  MATH_EXPRESSION_API int version();
+  MATH_EXPRESSION_API const char* version_string();
+}
+
+#endif // MATH_EXPRESSION_GLOBAL_H
@@ -351,7 +351,7 @@ Instructions Parser::generate_algorithm(const Tokens& tokens) const {
         Operand right_operand(right_is_value, 
           right_is_value ? right_token.value : to_string(adress[right]));
         adress[left] = last_adress;
-        instructions.push_back(Operation(left_operand, right_operand, last_adress, pow));
+        instructions.push_back(Operation(left_operand, right_operand, last_adress, power));
         instructions_name.push_back(new_tokens[i].value);
         last_adress++;
       }
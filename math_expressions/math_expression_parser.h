@@ -37,7 +37,7 @@ struct math_expression::Operation {
   const Function function;
 };
 
-class math_expression::Parser {
+class MATH_EXPRESSION_API math_expression::Parser {
  public:
   enum Error {
     LEXICAL, GRAMMAR, NON
@@ -4,6 +4,8 @@
 #include <string>
 #include <ostream>
 
+#include "math_expression_global.h"
+
 namespace math_expression {
   struct TerminalSymbol;
   struct Symbol;
@@ -11,7 +13,8 @@ namespace math_expression {
     A = 65, B, C, D, E, F, G, H, I, J, K, L, M, N,
     O, P, Q, R, S, T, U, V, W, X, Y, Z
   };
-  std::ostream& operator<<(std::ostream& os, const TerminalSymbol& ts);
+  MATH_EXPRESSION_API std::ostream& operator<<(std::ostream& os,
+                                                const TerminalSymbol& ts);
 }
 
 struct math_expression::TerminalSymbol {
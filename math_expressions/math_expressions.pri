@@ -0,0 +1,20 @@
+# Sources of the math_expressions library. Projects that compile the
+# evaluator in (instead of linking math_expressions.pro) include this file.
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/math_expression.cpp \
+    $$PWD/math_expression_evaluator.cpp \
+    $$PWD/math_expression_fused_program.cpp \
+    $$PWD/math_expression_parser.cpp \
+    $$PWD/math_expression_symbol.cpp
+
+HEADERS += \
+    $$PWD/math_expression.h \
+    $$PWD/math_expression_global.h \
+    $$PWD/math_expression_evaluator.h \
+    $$PWD/math_expression_fused_program.h \
+    $$PWD/math_expression_functions.h \
+    $$PWD/math_expression_parser.h \
+    $$PWD/math_expression_symbol.h
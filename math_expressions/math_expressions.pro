@@ -0,0 +1,42 @@
+#-------------------------------------------------
+#
+# Standalone math_expressions library, no Qt needed
+#
+#   qmake                               -> static library
+#   qmake CONFIG+=shared_math_expressions -> shared library
+#
+#-------------------------------------------------
+
+TARGET = math_expressions
+TEMPLATE = lib
+
+CONFIG += c++11
+CONFIG -= qt
+
+VERSION = 1.0.0
+
+shared_math_expressions {
+    CONFIG += shared
+    DEFINES += MATH_EXPRESSION_BUILD_SHARED
+    !win32-msvc*: QMAKE_CXXFLAGS += -fvisibility=hidden
+} else {
+    CONFIG += staticlib
+}
+
+include(math_expressions.pri)
+
+headers.files = \
+    math_expression.h \
+    math_expression_global.h \
+    math_expression_evaluator.h \
+    math_expression_fused_program.h \
+    math_expression_functions.h \
+    math_expression_parser.h \
+    math_expression_symbol.h
+headers.path = $$[QT_INSTALL_PREFIX]/include/math_expressions
+target.path = $$[QT_INSTALL_PREFIX]/lib
+!isEmpty(PREFIX) {
+    headers.path = $$PREFIX/include/math_expressions
+    target.path = $$PREFIX/lib
+}
+INSTALLS += target headers
@@ -244,6 +244,267 @@ void QCPPainter::makeNonCosmetic()
   }
 }
 
+/*!
+  Draws the polyline through the \a pointCount points at \a points directly into the pixels of
+  the paint device, without going through the paint engine. Points with a NaN coordinate create a
+  gap in the line, like it is handled in \ref QCPGraph::drawLinePlot.
+  
+  This is only possible for thin solid lines on raster images: the device must be a QImage of
+  format QImage::Format_ARGB32_Premultiplied or QImage::Format_RGB32, the pen must be solid with a
+  width of 0 or 1, and the painter may only be translated, fully opaque and use the SourceOver
+  composition mode. If the painter is antialiased, the line is drawn with Wu's algorithm,
+  otherwise with Bresenham's. The clip rect of the painter is respected.
+  
+  Returns false without drawing anything if one of the conditions isn't met. The caller then has to
+  draw the polyline with the usual QPainter functions.
+*/
+bool QCPPainter::drawRasterPolyline(const QPointF *points, int pointCount)
+{
+  if (!isActive() || !device() || device()->devType() != QInternal::Image)
+    return false;
+  QImage *image = static_cast<QImage*>(device());
+  if (image->format() != QImage::Format_ARGB32_Premultiplied && image->format() != QImage::Format_RGB32)
+    return false;
+  const QPen currentPen = pen();
+  if (currentPen.style() != Qt::SolidLine || currentPen.brush().style() != Qt::SolidPattern ||
+      (currentPen.widthF() != 0 && currentPen.widthF() != 1))
+    return false;
+  const QTransform transform = combinedTransform();
+  if (transform.type() > QTransform::TxTranslate || opacity() < 1.0 || compositionMode() != QPainter::CompositionMode_SourceOver)
+    return false;
+  if (hasClipping() && clipRegion().rectCount() > 1)
+    return false;
+  
+  QRect clip = image->rect();
+  if (hasClipping())
+  {
+    const QRectF deviceClip = transform.mapRect(clipBoundingRect());
+    clip &= QRect(QPoint(qRound(deviceClip.left()), qRound(deviceClip.top())), QPoint(qRound(deviceClip.right())-1, qRound(deviceClip.bottom())-1));
+  }
+  if (clip.isEmpty() || pointCount < 2)
+    return true;
+  
+  // premultiply the pen color, the RGB32 format needs an opaque alpha channel:
+  const QColor color = currentPen.color();
+  const int alpha = color.alpha();
+  QRgb premultiplied = qRgba(color.red()*alpha/255, color.green()*alpha/255, color.blue()*alpha/255, alpha);
+  if (alpha == 0)
+    return true;
+  
+  QRgb *bits = reinterpret_cast<QRgb*>(image->bits());
+  const int stride = image->bytesPerLine()/4;
+  const bool antialiased = testRenderHint(QPainter::Antialiasing);
+  // segments are clipped with one pixel of margin, so the clipped end points are still outside the clip:
+  const QRectF segmentClip = QRectF(clip).adjusted(-1, -1, 1, 1);
+  bool connected = false; // whether the previous segment ended where the current one starts
+  for (int i=1; i<pointCount; ++i)
+  {
+    double x0 = points[i-1].x()+transform.dx();
+    double y0 = points[i-1].y()+transform.dy();
+    double x1 = points[i].x()+transform.dx();
+    double y1 = points[i].y()+transform.dy();
+    if (qIsNaN(x0) || qIsNaN(y0) || qIsNaN(x1) || qIsNaN(y1)) // NaNs create a gap in the line
+    {
+      connected = false;
+      continue;
+    }
+    if (antialiased)
+    {
+      // with antialiasing, pixel centers are at half-integer coordinates:
+      x0 -= 0.5; y0 -= 0.5; x1 -= 0.5; y1 -= 0.5;
+    }
+    const double startX = x0, startY = y0, endX = x1, endY = y1;
+    if (!clipRasterLine(segmentClip, x0, y0, x1, y1))
+    {
+      connected = false;
+      continue;
+    }
+    if (antialiased)
+      rasterizeAntialiasedLine(bits, stride, clip, x0, y0, x1, y1, premultiplied);
+    else
+      rasterizeLine(bits, stride, clip, qRound(x0), qRound(y0), qRound(x1), qRound(y1), premultiplied, connected && x0 == startX && y0 == startY);
+    connected = x1 == endX && y1 == endY;
+  }
+  return true;
+}
+
+/*! \internal
+  
+  Clips the line segment from (\a x0, \a y0) to (\a x1, \a y1) to the rect \a clip with the
+  Liang-Barsky algorithm and writes the clipped end points back. Returns false if no part of the
+  segment is inside \a clip.
+*/
+bool QCPPainter::clipRasterLine(const QRectF &clip, double &x0, double &y0, double &x1, double &y1) const
+{
+  const double dx = x1-x0;
+  const double dy = y1-y0;
+  const double p[4] = {-dx, dx, -dy, dy};
+  const double q[4] = {x0-clip.left(), clip.right()-x0, y0-clip.top(), clip.bottom()-y0};
+  double tEnter = 0;
+  double tLeave = 1;
+  for (int i=0; i<4; ++i)
+  {
+    if (p[i] == 0)
+    {
+      if (q[i] < 0) // parallel to and outside of this edge
+        return false;
+    } else
+    {
+      const double t = q[i]/p[i];
+      if (p[i] < 0)
+      {
+        if (t > tLeave) return false;
+        if (t > tEnter) tEnter = t;
+      } else
+      {
+        if (t < tEnter) return false;
+        if (t < tLeave) tLeave = t;
+      }
+    }
+  }
+  if (tLeave < 1)
+  {
+    x1 = x0+tLeave*dx;
+    y1 = y0+tLeave*dy;
+  }
+  if (tEnter > 0)
+  {
+    x0 = x0+tEnter*dx;
+    y0 = y0+tEnter*dy;
+  }
+  return true;
+}
+
+/*! \internal
+  
+  Draws an aliased line from pixel (\a x0, \a y0) to (\a x1, \a y1) with Bresenham's algorithm.
+  If \a skipFirst is true, the first pixel isn't drawn because the previous segment of the
+  polyline already did, which matters for translucent colors.
+*/
+void QCPPainter::rasterizeLine(QRgb *bits, int stride, const QRect &clip, int x0, int y0, int x1, int y1, QRgb color, bool skipFirst) const
+{
+  const int dx = qAbs(x1-x0);
+  const int dy = -qAbs(y1-y0);
+  const int sx = x0 < x1 ? 1 : -1;
+  const int sy = y0 < y1 ? 1 : -1;
+  int error = dx+dy;
+  bool first = true;
+  while (true)
+  {
+    if (!first || !skipFirst)
+      blendRasterPixel(bits, stride, clip, x0, y0, color, 255);
+    first = false;
+    if (x0 == x1 && y0 == y1)
+      break;
+    const int error2 = 2*error;
+    if (error2 >= dy)
+    {
+      error += dy;
+      x0 += sx;
+    }
+    if (error2 <= dx)
+    {
+      error += dx;
+      y0 += sy;
+    }
+  }
+}
+
+/*! \internal
+  
+  Draws an antialiased line from (\a x0, \a y0) to (\a x1, \a y1) with Wu's algorithm. The
+  coordinates are in pixel units with the pixel centers at integer coordinates.
+*/
+void QCPPainter::rasterizeAntialiasedLine(QRgb *bits, int stride, const QRect &clip, double x0, double y0, double x1, double y1, QRgb color) const
+{
+  const bool steep = qAbs(y1-y0) > qAbs(x1-x0);
+  if (steep) // walk along y, so the major axis is always called x below
+  {
+    qSwap(x0, y0);
+    qSwap(x1, y1);
+  }
+  if (x0 > x1)
+  {
+    qSwap(x0, x1);
+    qSwap(y0, y1);
+  }
+  const double gradient = x1 == x0 ? 1.0 : (y1-y0)/(x1-x0);
+  
+  // end points, weighted by how much of their pixel the segment covers along the major axis:
+  const int xStart = qRound(x0);
+  const int xEnd = qRound(x1);
+  const double yStart = y0+gradient*(xStart-x0);
+  const double yEnd = y1+gradient*(xEnd-x1);
+  const double startGap = 1.0-(x0+0.5-qFloor(x0+0.5));
+  const double endGap = x1+0.5-qFloor(x1+0.5);
+  const double ends[2][2] = {{yStart, startGap}, {yEnd, endGap}};
+  for (int e=0; e<2; ++e)
+  {
+    const int x = e == 0 ? xStart : xEnd;
+    const int y = qFloor(ends[e][0]);
+    const double fraction = ends[e][0]-y;
+    const int coverageLow = qRound((1.0-fraction)*ends[e][1]*255);
+    const int coverageHigh = qRound(fraction*ends[e][1]*255);
+    if (steep)
+    {
+      blendRasterPixel(bits, stride, clip, y, x, color, coverageLow);
+      blendRasterPixel(bits, stride, clip, y+1, x, color, coverageHigh);
+    } else
+    {
+      blendRasterPixel(bits, stride, clip, x, y, color, coverageLow);
+      blendRasterPixel(bits, stride, clip, x, y+1, color, coverageHigh);
+    }
+  }
+  
+  // pixels between the end points, split between the two pixels the line passes:
+  double intersection = yStart+gradient;
+  for (int x=xStart+1; x<xEnd; ++x)
+  {
+    const int y = qFloor(intersection);
+    const int coverageHigh = qRound((intersection-y)*255);
+    if (steep)
+    {
+      blendRasterPixel(bits, stride, clip, y, x, color, 255-coverageHigh);
+      blendRasterPixel(bits, stride, clip, y+1, x, color, coverageHigh);
+    } else
+    {
+      blendRasterPixel(bits, stride, clip, x, y, color, 255-coverageHigh);
+      blendRasterPixel(bits, stride, clip, x, y+1, color, coverageHigh);
+    }
+    intersection += gradient;
+  }
+}
+
+/*! \internal
+  
+  Blends the premultiplied \a color with the given \a coverage (0 to 255) onto pixel (\a x, \a y)
+  of the image \a bits, if the pixel is inside \a clip.
+*/
+void QCPPainter::blendRasterPixel(QRgb *bits, int stride, const QRect &clip, int x, int y, QRgb color, int coverage) const
+{
+  if (coverage <= 0 || !clip.contains(x, y))
+    return;
+  QRgb &pixel = bits[y*stride+x];
+  // two channels are scaled at once, the factors are mapped from 0..255 to 0..256 to divide by 256:
+  if (coverage < 255) // scale all four channels of the premultiplied color by the coverage
+  {
+    const uint factor = coverage+(coverage >> 7);
+    const uint redBlue = ((color & 0x00ff00ff)*factor + 0x00800080) >> 8;
+    const uint alphaGreen = (((color >> 8) & 0x00ff00ff)*factor + 0x00800080) >> 8;
+    color = (redBlue & 0x00ff00ff) | ((alphaGreen & 0x00ff00ff) << 8);
+  }
+  uint inverseAlpha = 255-qAlpha(color);
+  if (inverseAlpha == 0)
+  {
+    pixel = color;
+    return;
+  }
+  inverseAlpha += inverseAlpha >> 7;
+  const uint redBlue = ((pixel & 0x00ff00ff)*inverseAlpha + 0x00800080) >> 8;
+  const uint alphaGreen = (((pixel >> 8) & 0x00ff00ff)*inverseAlpha + 0x00800080) >> 8;
+  pixel = color + ((redBlue & 0x00ff00ff) | ((alphaGreen & 0x00ff00ff) << 8));
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////// QCPScatterStyle
@@ -455,6 +716,7 @@ QCPScatterStyle::QCPScatterStyle(const QPainterPath &customPath, const QPen &pen
 void QCPScatterStyle::setSize(double size)
 {
   mSize = size;
+  mStamp = QImage();
 }
 
 /*!
@@ -468,6 +730,7 @@ void QCPScatterStyle::setSize(double size)
 void QCPScatterStyle::setShape(QCPScatterStyle::ScatterShape shape)
 {
   mShape = shape;
+  mStamp = QImage();
 }
 
 /*!
@@ -517,6 +780,7 @@ void QCPScatterStyle::setCustomPath(const QPainterPath &customPath)
 {
   setShape(ssCustom);
   mCustomPath = customPath;
+  mStamp = QImage();
 }
 
 /*!
@@ -674,6 +938,111 @@ void QCPScatterStyle::drawShape(QCPPainter *painter, double x, double y) const
   }
 }
 
+/*!
+  Draws the scatter shape with \a painter at all \a positions. Like \ref drawShape, this function
+  uses the pen and brush of \a painter, so \ref applyTo should be called before.
+  
+  On raster devices, the shape is rendered only once into a small image (the stamp), which is then
+  copied to the pixel-rounded positions. The stamp is kept until the shape, size, pen, brush or
+  antialiasing changes. Positions that round to the same pixel as an earlier one, and positions
+  whose shape can't touch the clip rect of \a painter, are skipped.
+  
+  For vectorized painting and exports (see \ref QCPPainter::PainterMode), for \ref ssPixmap and if
+  \a painter is rotated or scaled, each shape is drawn with \ref drawShape.
+*/
+void QCPScatterStyle::drawShapes(QCPPainter *painter, const QVector<QPointF> &positions) const
+{
+  if (!canUseStamp(painter))
+  {
+    for (int i=0; i<positions.size(); ++i)
+      drawShape(painter, positions.at(i));
+    return;
+  }
+  
+  const QPen pen = painter->pen();
+  const QBrush brush = painter->brush();
+  const bool antialiased = painter->antialiasing();
+  const int extent = stampExtent(pen);
+  if (mStamp.isNull() || mStampPen != pen || mStampBrush != brush || mStampAntialiased != antialiased)
+  {
+    mStamp = QImage(2*extent+1, 2*extent+1, QImage::Format_ARGB32_Premultiplied);
+    mStamp.fill(Qt::transparent);
+    QCPPainter stampPainter(&mStamp);
+    stampPainter.setAntialiasing(antialiased);
+    stampPainter.setPen(pen);
+    stampPainter.setBrush(brush);
+    drawShape(&stampPainter, extent, extent);
+    stampPainter.end();
+    mStampPen = pen;
+    mStampBrush = brush;
+    mStampAntialiased = antialiased;
+  }
+  
+  // the stamps are placed in device pixels. With antialiasing, QCPPainter shifts by half a pixel,
+  // which the stamp already contains:
+  const QTransform transform = painter->transform();
+  const double shift = antialiased ? 0.5 : 0;
+  const double offsetX = transform.dx()-shift;
+  const double offsetY = transform.dy()-shift;
+  QRect clip(0, 0, painter->device()->width(), painter->device()->height());
+  if (painter->hasClipping())
+    clip &= transform.mapRect(painter->clipBoundingRect()).toAlignedRect();
+  const QRect area = clip.adjusted(-extent, -extent, extent, extent); // centers whose stamp may touch the clip rect
+  if (area.isEmpty())
+    return;
+  QBitArray drawn(area.width()*area.height()); // pixels that already have a stamp centered on them
+  
+  painter->save();
+  painter->resetTransform();
+  for (int i=0; i<positions.size(); ++i)
+  {
+    const double x = positions.at(i).x()+offsetX;
+    const double y = positions.at(i).y()+offsetY;
+    if (!(x > area.left()-0.5 && x < area.right()+0.5 && y > area.top()-0.5 && y < area.bottom()+0.5)) // also rejects NaN
+      continue;
+    const int pixelX = qRound(x);
+    const int pixelY = qRound(y);
+    const int index = (pixelY-area.top())*area.width()+pixelX-area.left();
+    if (index < 0 || index >= drawn.size() || drawn.testBit(index))
+      continue;
+    drawn.setBit(index);
+    painter->drawImage(pixelX-extent, pixelY-extent, mStamp);
+  }
+  painter->restore();
+}
+
+/*! \internal
+  
+  Returns whether \ref drawShapes may draw with a stamp on \a painter.
+*/
+bool QCPScatterStyle::canUseStamp(QCPPainter *painter) const
+{
+  if (mShape == ssNone || mShape == ssPixmap)
+    return false;
+  if (painter->modes().testFlag(QCPPainter::pmVectorized) || painter->modes().testFlag(QCPPainter::pmNoCaching))
+    return false;
+  if (!painter->device() || (painter->device()->devType() != QInternal::Image && painter->device()->devType() != QInternal::Pixmap))
+    return false;
+  return painter->transform().type() <= QTransform::TxTranslate;
+}
+
+/*! \internal
+  
+  Returns the distance from the center of the stamp to its border, so the shape drawn with \a pen
+  fits inside.
+*/
+int QCPScatterStyle::stampExtent(const QPen &pen) const
+{
+  double radius = mSize/2.0;
+  if (mShape == ssCustom)
+  {
+    const QRectF bounds = mCustomPath.boundingRect();
+    radius = qMax(qMax(qAbs(bounds.left()), qAbs(bounds.right())), qMax(qAbs(bounds.top()), qAbs(bounds.bottom())))*mSize/6.0;
+  }
+  const double penWidth = pen.style() == Qt::NoPen ? 0 : qMax(1.0, pen.widthF());
+  return qCeil(radius+penWidth)+1;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////// QCPLayer
@@ -719,6 +1088,16 @@ void QCPScatterStyle::drawShape(QCPPainter *painter, double x, double y) const
   
   When a layer is deleted, the objects on it are not deleted with it, but fall on the layer below
   the deleted layer, see QCustomPlot::removeLayer.
+  
+  \section layer-buffering Layer buffering
+  
+  By default, layers only define the rendering order (\ref lmLogical), and a replot redraws all of
+  them. Layers with frequently changing but cheap content, like a tracer or cursor following the
+  mouse, may be set to \ref lmBuffered with \ref setMode. Such a layer is rendered into a paint
+  buffer of its own, and the logical layers between the buffered ones share one buffer per group.
+  Calling \ref replot on a buffered layer then only redraws that layer and composites the frame from
+  the cached buffers of the others. So a cursor layer can be updated at display rate above graphs
+  with millions of points.
 */
 
 /* start documentation of inline functions */
@@ -752,7 +1131,9 @@ QCPLayer::QCPLayer(QCustomPlot *parentPlot, const QString &layerName) :
   mParentPlot(parentPlot),
   mName(layerName),
   mIndex(-1), // will be set to a proper value by the QCustomPlot layer creation function
-  mVisible(true)
+  mVisible(true),
+  mMode(lmLogical),
+  mBufferIndex(-1)
 {
   // Note: no need to make sure layerName is unique, because layer
   // management is done with QCustomPlot functions.
@@ -785,6 +1166,101 @@ void QCPLayer::setVisible(bool visible)
   mVisible = visible;
 }
 
+/*!
+  Sets whether this layer has a paint buffer of its own (\ref lmBuffered) or shares it with the
+  neighbouring layers (\ref lmLogical, the default).
+  
+  Only buffered layers can be replotted individually with \ref replot. Each buffered layer costs
+  a buffer of the size of the QCustomPlot and a composition step per replot, so only layers whose
+  content changes much more often than the rest of the plot should be buffered.
+  
+  \see replot
+*/
+void QCPLayer::setMode(QCPLayer::LayerMode mode)
+{
+  if (mMode != mode)
+  {
+    mMode = mode;
+    if (mParentPlot)
+      mParentPlot->mLayerBuffersValid = false;
+  }
+}
+
+/*!
+  Replots this layer only, if it is a buffered layer (see \ref setMode). Its layerables are redrawn
+  into the layer's buffer, and the frame is composited from the buffers the other layers kept from
+  the last \ref QCustomPlot::replot. So the other layers must not have changed since then. Finally,
+  the QCustomPlot widget is updated.
+  
+  Only the region the layer covered before and after the replot is cleared, composited and
+  repainted on the widget (see \ref QCPLayerable::drawnRect). So a small cursor or tracer costs
+  little, even on a large plot.
+  
+  This falls back to a complete \ref QCustomPlot::replot if this is a logical layer, or if the axis
+  ranges or the geometry of the axis rects changed since the last complete replot, because then
+  the cached buffers of the other layers are outdated.
+  
+  \see setMode
+*/
+void QCPLayer::replot()
+{
+  if (mMode == lmBuffered && mParentPlot->mLayerBuffersValid && !mParentPlot->mReplotting &&
+      mBufferIndex >= 0 && mBufferIndex < mParentPlot->mLayerBuffers.size() &&
+      mParentPlot->mLayerBuffers.at(mBufferIndex).size() == mParentPlot->mPaintBuffer.size() &&
+      mParentPlot->layerBufferGeometry() == mParentPlot->mLayerBufferGeometry)
+  {
+    QImage &buffer = mParentPlot->mLayerBuffers[mBufferIndex];
+    const QRegion oldRegion = mDrawnRegion;
+    mParentPlot->preparePlottables(QList<QCPLayer*>() << this);
+    QCPPainter painter;
+    if (painter.begin(&buffer))
+    {
+      // the buffer is transparent outside of what the layer drew last time:
+      painter.setCompositionMode(QPainter::CompositionMode_Source);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0) // QRegion::rects() is deprecated since Qt 5.11, the region itself can be iterated since 5.8
+      for (const QRect &rect : oldRegion)
+#else
+      foreach (const QRect &rect, oldRegion.rects())
+#endif
+        painter.fillRect(rect, Qt::transparent);
+      painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+      painter.setRenderHint(QPainter::HighQualityAntialiasing);
+      draw(&painter);
+      painter.end();
+      const QRegion dirtyRegion = oldRegion | mDrawnRegion;
+      if (mParentPlot->composeLayerBuffers(dirtyRegion))
+        mParentPlot->update(dirtyRegion);
+    }
+  } else
+    mParentPlot->replot();
+}
+
+/*! \internal
+  
+  Draws the visible layerables of this layer with \a painter, in the order of \ref children.
+  
+  Before a layerable draws itself, its drawn region (see \ref QCPLayerable::drawnRect) is reset to
+  its clip rect. Afterwards, the union of the drawn regions of all layerables is kept in \ref
+  mDrawnRegion, so \ref replot knows which pixels this layer covers.
+*/
+void QCPLayer::draw(QCPPainter *painter)
+{
+  mDrawnRegion = QRegion();
+  foreach (QCPLayerable *child, mChildren)
+  {
+    if (child->realVisibility())
+    {
+      painter->save();
+      painter->setClipRect(child->clipRect().translated(0, -1));
+      child->applyDefaultAntialiasingHint(painter);
+      child->mDrawnRegion = child->clipRect().adjusted(0, -1, 0, 0); // draw implementations may narrow it via setDrawnRect
+      child->draw(painter);
+      painter->restore();
+      mDrawnRegion += child->mDrawnRegion;
+    }
+  }
+}
+
 /*! \internal
   
   Adds the \a layerable to the list of this layer. If \a prepend is set to true, the layerable will
@@ -854,6 +1330,20 @@ void QCPLayer::removeChild(QCPLayerable *layerable)
   set manually by the user.
 */
 
+/*! \fn QRect QCPLayerable::drawnRect() const
+ 
+  Returns the pixel rect that contained everything this layerable painted when it was last drawn,
+  and thus also everything it could be hit at. \ref QCustomPlot::layerableAt skips the \ref
+  selectTest of layerables whose drawn rect, grown by the \ref QCustomPlot::setSelectionTolerance
+  "selection tolerance", doesn't contain the tested position.
+  
+  Before each layerable is drawn, its drawn region is reset to its clip rect, which is all its
+  drawing can ever cover. Subclasses that know their geometry narrow it in their draw method via
+  \ref setDrawnRect and \ref addDrawnRect. The region (rather than only its bounding rect) tells
+  \ref QCPLayer::replot which part of the widget needs to be repainted. A null rect means the
+  layerable wasn't drawn yet, it is then never skipped.
+*/
+
 /* end documentation of inline functions */
 /* start documentation of pure virtual functions */
 
@@ -1165,6 +1655,75 @@ void QCPLayerable::applyAntialiasingHint(QCPPainter *painter, bool localAntialia
     painter->setAntialiasing(localAntialiased);
 }
 
+/*! \internal
+
+  Narrows the region this layerable painted (see \ref drawnRect) to \a rect grown by \a margin.
+  \a rect must enclose everything \ref selectTest could report a hit on, and \a margin must cover
+  what is painted beyond it, e.g. half the pen width or the size of scatter symbols, in pixels.
+  Subclasses call this in their \ref draw implementation.
+  
+  The rect is grown by another pixel for antialiasing, limited to the \ref clipRect and rounded
+  outward to whole pixels. If it lies completely outside the clip rect, nothing was painted and the
+  drawn region becomes empty. (\ref QCustomPlot::layerableAt then doesn't skip the layerable, the
+  same as if it was never drawn.)
+  
+  \see addDrawnRect
+*/
+void QCPLayerable::setDrawnRect(const QRectF &rect, double margin)
+{
+  mDrawnRegion = QRegion();
+  addDrawnRect(rect, margin);
+}
+
+/*! \internal
+  \overload
+  
+  Narrows the drawn region to the bounding rect of \a points, grown by \a margin. Points with NaN
+  coordinates (gaps in line data) are ignored.
+*/
+void QCPLayerable::setDrawnRect(const QVector<QPointF> &points, double margin)
+{
+  double left = std::numeric_limits<double>::max();
+  double right = -std::numeric_limits<double>::max();
+  double top = std::numeric_limits<double>::max();
+  double bottom = -std::numeric_limits<double>::max();
+  for (int i=0; i<points.size(); ++i)
+  {
+    const QPointF &p = points.at(i);
+    if (qIsNaN(p.x()) || qIsNaN(p.y()))
+      continue;
+    if (p.x() < left) left = p.x();
+    if (p.x() > right) right = p.x();
+    if (p.y() < top) top = p.y();
+    if (p.y() > bottom) bottom = p.y();
+  }
+  if (left <= right)
+    setDrawnRect(QRectF(QPointF(left, top), QPointF(right, bottom)), margin);
+}
+
+/*! \internal
+  
+  Adds \a rect grown by \a margin to the region this layerable painted, for layerables that consist
+  of several parts far apart from each other, like the two lines of a crosshair. Call \ref
+  setDrawnRect for the first part.
+  
+  Note that this doesn't use QRectF::intersected, since rects of zero width or height (e.g. of a
+  horizontal line) must not be lost before they are grown.
+*/
+void QCPLayerable::addDrawnRect(const QRectF &rect, double margin)
+{
+  const QRect clip = clipRect().adjusted(0, -1, 0, 0); // QCPLayer::draw clips to the clip rect translated up by one pixel
+  const QRectF normRect = rect.normalized();
+  const double pad = margin+1;
+  const double left = qMax(normRect.left()-pad, (double)clip.left());
+  const double right = qMin(normRect.right()+pad, (double)clip.right());
+  const double top = qMax(normRect.top()-pad, (double)clip.top());
+  const double bottom = qMin(normRect.bottom()+pad, (double)clip.bottom());
+  if (left > right || top > bottom) // also catches NaN
+    return;
+  mDrawnRegion += QRect(QPoint(qFloor(left), qFloor(top)), QPoint(qCeil(right), qCeil(bottom)));
+}
+
 /*! \internal
 
   This function is called by \ref initializeParentPlot, to allow subclasses to react on the setting
@@ -4049,6 +4608,7 @@ QCPAxis::QCPAxis(QCPAxisRect *parent, AxisType type) :
   mCachedMarginValid(false),
   mCachedMargin(0)
 {
+  mTickMemo.valid = false;
   mGrid->setVisible(false);
   setAntialiased(false);
   setLayer(mParentPlot->currentLayer()); // it's actually on that layer already, but we want it in front of the grid, so we place it on there again
@@ -4800,6 +5360,7 @@ void QCPAxis::setTickVector(const QVector<double> &vec)
   // don't check whether mTickVector != vec here, because it takes longer than we would save
   mTickVector = vec;
   mCachedMarginValid = false;
+  mTickMemo.valid = false;
 }
 
 /*!
@@ -4818,6 +5379,7 @@ void QCPAxis::setTickVectorLabels(const QVector<QString> &vec)
   // don't check whether mTickVectorLabels != vec here, because it takes longer than we would save
   mTickVectorLabels = vec;
   mCachedMarginValid = false;
+  mTickMemo.valid = false;
 }
 
 /*!
@@ -5515,12 +6077,33 @@ QCPAxis::AxisType QCPAxis::opposite(QCPAxis::AxisType type)
   \ref setAutoTicks is set to true, appropriate tick values are determined automatically via \ref
   generateAutoTicks. If it's set to false, the signal ticksRequest is emitted, which can be used to
   provide external tick positions. Then the sub tick vectors and tick label vectors are created.
+  
+  When both ticks and tick labels are generated automatically, the results are memoized: If the
+  range and all tick and label parameters are the same as in the previous call, the vectors are
+  kept as they are. If only the ticks changed (e.g. while the range is dragged), the labels of ticks
+  that were already labeled in the previous call are reused instead of being formatted again. This
+  is counted in \ref QCPRenderStatistics.
 */
 void QCPAxis::setupTickVectors()
 {
   if (!mParentPlot) return;
   if ((!mTicks && !mTickLabels && !mGrid->visible()) || mRange.size() <= 0) return;
   
+  bool memoized = mAutoTicks && mAutoTickLabels && mTickMemo.valid;
+  if (memoized && tickMemoHasSameTicks() && tickMemoHasSameLabels())
+  {
+    ++mParentPlot->mRenderStatistics.tickSetupsReused;
+    return;
+  }
+  // ticks and labels of the previous call, to reuse the labels of ticks that are still visible:
+  QVector<double> previousTicks;
+  QVector<QString> previousLabels;
+  if (memoized && tickMemoHasSameLabels())
+  {
+    previousTicks = mTickVector;
+    previousLabels = mTickVectorLabels;
+  }
+  
   // fill tick vectors, either by auto generating or by notifying user to fill the vectors himself
   if (mAutoTicks)
   {
@@ -5534,6 +6117,7 @@ void QCPAxis::setupTickVectors()
   if (mTickVector.isEmpty())
   {
     mSubTickVector.clear();
+    updateTickMemo();
     return;
   }
   
@@ -5572,22 +6156,32 @@ void QCPAxis::setupTickVectors()
   if (mAutoTickLabels)
   {
     int vecsize = mTickVector.size();
-    mTickVectorLabels.resize(vecsize);
-    if (mTickLabelType == ltNumber)
-    {
-      for (int i=mLowestVisibleTick; i<=mHighestVisibleTick; ++i)
-        mTickVectorLabels[i] = mParentPlot->locale().toString(mTickVector.at(i), mNumberFormatChar.toLatin1(), mNumberPrecision);
-    } else if (mTickLabelType == ltDateTime)
+    QVector<QString> newLabels(vecsize);
+    int previousIndex = 0; // both tick vectors are sorted, so the previous ticks are searched only once
+    for (int i=mLowestVisibleTick; i<=mHighestVisibleTick; ++i)
     {
-      for (int i=mLowestVisibleTick; i<=mHighestVisibleTick; ++i)
+      while (previousIndex < previousTicks.size() && previousTicks.at(previousIndex) < mTickVector.at(i))
+        ++previousIndex;
+      if (previousIndex < previousTicks.size() && previousTicks.at(previousIndex) == mTickVector.at(i) && !previousLabels.value(previousIndex).isEmpty())
+      {
+        newLabels[i] = previousLabels.at(previousIndex);
+        ++mParentPlot->mRenderStatistics.tickLabelsReused;
+        continue;
+      }
+      if (mTickLabelType == ltNumber)
+      {
+        newLabels[i] = mParentPlot->locale().toString(mTickVector.at(i), mNumberFormatChar.toLatin1(), mNumberPrecision);
+      } else if (mTickLabelType == ltDateTime)
       {
 #if QT_VERSION < QT_VERSION_CHECK(4, 7, 0) // use fromMSecsSinceEpoch function if available, to gain sub-second accuracy on tick labels (e.g. for format "hh:mm:ss:zzz")
-        mTickVectorLabels[i] = mParentPlot->locale().toString(QDateTime::fromTime_t(mTickVector.at(i)).toTimeSpec(mDateTimeSpec), mDateTimeFormat);
+        newLabels[i] = mParentPlot->locale().toString(QDateTime::fromTime_t(mTickVector.at(i)).toTimeSpec(mDateTimeSpec), mDateTimeFormat);
 #else
-        mTickVectorLabels[i] = mParentPlot->locale().toString(QDateTime::fromMSecsSinceEpoch(mTickVector.at(i)*1000).toTimeSpec(mDateTimeSpec), mDateTimeFormat);
+        newLabels[i] = mParentPlot->locale().toString(QDateTime::fromMSecsSinceEpoch(mTickVector.at(i)*1000).toTimeSpec(mDateTimeSpec), mDateTimeFormat);
 #endif
       }
+      ++mParentPlot->mRenderStatistics.tickLabelsFormatted;
     }
+    mTickVectorLabels = newLabels;
   } else // mAutoTickLabels == false
   {
     if (mAutoTicks) // ticks generated automatically, but not ticklabels, so emit ticksRequest here for labels
@@ -5598,6 +6192,7 @@ void QCPAxis::setupTickVectors()
     if (mTickVectorLabels.size() < mTickVector.size())
       mTickVectorLabels.resize(mTickVector.size());
   }
+  updateTickMemo();
 }
 
 /*! \internal
@@ -5884,6 +6479,64 @@ void QCPAxis::visibleTickBounds(int &lowIndex, int &highIndex) const
     highIndex = lowIndex-1;
 }
 
+/*! \internal
+  
+  Returns whether the range and the parameters that determine the tick and sub tick positions are
+  the same as in the last call of \ref setupTickVectors.
+*/
+bool QCPAxis::tickMemoHasSameTicks() const
+{
+  return mTickMemo.range == mRange &&
+         mTickMemo.scaleType == mScaleType &&
+         mTickMemo.scaleLogBase == mScaleLogBase &&
+         mTickMemo.tickStep == mTickStep &&
+         mTickMemo.autoTickCount == mAutoTickCount &&
+         mTickMemo.subTickCount == mSubTickCount &&
+         mTickMemo.autoTickStep == mAutoTickStep &&
+         mTickMemo.autoSubTicks == mAutoSubTicks;
+}
+
+/*! \internal
+  
+  Returns whether the parameters that determine how a tick label is formatted are the same as in
+  the last call of \ref setupTickVectors, i.e. whether a label of the previous call can be reused
+  for a tick at the same position.
+*/
+bool QCPAxis::tickMemoHasSameLabels() const
+{
+  return mTickMemo.tickLabelType == mTickLabelType &&
+         mTickMemo.numberFormatChar == mNumberFormatChar.toLatin1() &&
+         mTickMemo.numberPrecision == mNumberPrecision &&
+         mTickMemo.dateTimeFormat == mDateTimeFormat &&
+         mTickMemo.dateTimeSpec == mDateTimeSpec &&
+         mTickMemo.locale == mParentPlot->locale();
+}
+
+/*! \internal
+  
+  Stores the current tick and label parameters, for comparison in the next call of \ref
+  setupTickVectors. The memo is only valid if ticks and tick labels are generated automatically,
+  since otherwise the vectors are provided externally.
+*/
+void QCPAxis::updateTickMemo()
+{
+  mTickMemo.valid = mAutoTicks && mAutoTickLabels;
+  mTickMemo.range = mRange;
+  mTickMemo.scaleType = mScaleType;
+  mTickMemo.scaleLogBase = mScaleLogBase;
+  mTickMemo.tickStep = mTickStep;
+  mTickMemo.autoTickCount = mAutoTickCount;
+  mTickMemo.subTickCount = mSubTickCount;
+  mTickMemo.autoTickStep = mAutoTickStep;
+  mTickMemo.autoSubTicks = mAutoSubTicks;
+  mTickMemo.tickLabelType = mTickLabelType;
+  mTickMemo.numberFormatChar = mNumberFormatChar.toLatin1();
+  mTickMemo.numberPrecision = mNumberPrecision;
+  mTickMemo.dateTimeFormat = mDateTimeFormat;
+  mTickMemo.dateTimeSpec = mDateTimeSpec;
+  mTickMemo.locale = mParentPlot->locale();
+}
+
 /*! \internal
   
   A log function with the base mScaleLogBase, used mostly for coordinate transforms in logarithmic
@@ -6045,47 +6698,204 @@ QCP::Interaction QCPAxis::selectionCategory() const
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////// QCPAxisPainterPrivate
+//////////////////// QCPLabelAtlas
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-/*! \class QCPAxisPainterPrivate
+/*! \class QCPLabelAtlas
 
   \internal
   \brief (Private)
   
   This is a private class and not part of the public QCustomPlot interface.
   
-  It is used by QCPAxis to do the low-level drawing of axis backbone, tick marks, tick labels and
-  axis label. It also buffers the labels to reduce replot times. The parameters are configured by
-  directly accessing the public member variables.
+  It holds the glyphs numeric tick labels consist of (digits, signs, decimal separators, the
+  exponent character and the multiplication signs of beautiful powers). Each QCustomPlot owns one
+  instance that is shared by all its axes. Per font, the glyph metrics are determined once, and per
+  font and color the glyphs are rendered once into a strip pixmap. A label is then measured by
+  summing up the glyph advances and drawn as a set of pixmap fragments of the strip, so no text
+  layout is done for it.
+  
+  Only texts that consist entirely of the supported glyphs can be handled, see \ref measure.
+  
+  The atlas doesn't need to be cleared when fonts or colors change, since it is keyed by them. It
+  is bounded instead: the glyphs of at most 16 fonts are kept, the least recently used font is
+  dropped first, and each font keeps strips for at most 16 colors.
 */
 
 /*!
-  Constructs a QCPAxisPainterPrivate instance. Make sure to not create a new instance on every
-  redraw, to utilize the caching mechanisms.
+  Creates an empty label atlas. Glyphs are created on demand.
 */
-QCPAxisPainterPrivate::QCPAxisPainterPrivate(QCustomPlot *parentPlot) :
-  type(QCPAxis::atLeft),
-  basePen(QPen(Qt::black, 0, Qt::SolidLine, Qt::SquareCap)),
-  lowerEnding(QCPLineEnding::esNone),
-  upperEnding(QCPLineEnding::esNone),
-  labelPadding(0),
-  tickLabelPadding(0),
-  tickLabelRotation(0),
-  tickLabelSide(QCPAxis::lsOutside),
-  substituteExponent(true),
-  numberMultiplyCross(false),
-  tickLengthIn(5),
-  tickLengthOut(0),
-  subTickLengthIn(2),
-  subTickLengthOut(0),
-  tickPen(QPen(Qt::black, 0, Qt::SolidLine, Qt::SquareCap)),
-  subTickPen(QPen(Qt::black, 0, Qt::SolidLine, Qt::SquareCap)),
-  offset(0),
-  abbreviateDecimalPowers(false),
+QCPLabelAtlas::QCPLabelAtlas() :
+  mCharacters(QLatin1String("0123456789.,+-eE")+QChar(215)+QChar(183)),
+  mGlyphSets(16) // keep the glyphs of at most 16 fonts
+{
+}
+
+/*!
+  Calculates the bounding rect of \a text drawn with \a font and stores it in \a bounds, with the
+  top left corner at the origin. The width is the sum of the glyph advances and the height the
+  height of the font, i.e. the same as QFontMetrics::boundingRect yields for unkerned text.
+  
+  Returns false and leaves \a bounds unchanged if \a text contains characters that are not in the
+  atlas. Such texts must be laid out and drawn the usual way.
+*/
+bool QCPLabelAtlas::measure(const QFont &font, const QString &text, QRect *bounds)
+{
+  if (!contains(text))
+    return false;
+  const GlyphSet *glyphs = glyphSet(font);
+  int width = 0;
+  for (int i=0; i<text.size(); ++i)
+    width += glyphs->glyphs.at(mCharacters.indexOf(text.at(i))).advance;
+  *bounds = QRect(0, 0, width, glyphs->height);
+  return true;
+}
+
+/*!
+  Draws \a text with \a font and \a color such that the top left corner of its bounding rect (see
+  \ref measure) is at \a pos, which is rounded to full pixels. All glyphs are drawn with a single
+  QPainter::drawPixmapFragments call.
+  
+  \a text must only consist of characters for which \ref measure returned true.
+*/
+void QCPLabelAtlas::draw(QCPPainter *painter, const QPointF &pos, const QFont &font, const QColor &color, const QString &text)
+{
+  GlyphSet *glyphs = glyphSet(font);
+  const QPixmap &glyphStrip = strip(glyphs, font, color);
+  QVector<QPainter::PixmapFragment> fragments;
+  fragments.reserve(text.size());
+  double x = qRound(pos.x());
+  double centerY = qRound(pos.y())+glyphs->height*0.5;
+  for (int i=0; i<text.size(); ++i)
+  {
+    const Glyph &glyph = glyphs->glyphs.at(mCharacters.indexOf(text.at(i)));
+    fragments.append(QPainter::PixmapFragment::create(QPointF(x+glyph.left+glyph.width*0.5, centerY), QRectF(glyph.x, 0, glyph.width, glyphs->height)));
+    x += glyph.advance;
+  }
+  painter->drawPixmapFragments(fragments.constData(), fragments.size(), glyphStrip);
+}
+
+/*! \internal
+  
+  Returns whether every character of \a text is in the atlas.
+*/
+bool QCPLabelAtlas::contains(const QString &text) const
+{
+  for (int i=0; i<text.size(); ++i)
+  {
+    if (!mCharacters.contains(text.at(i)))
+      return false;
+  }
+  return true;
+}
+
+/*! \internal
+  
+  Returns the glyph metrics for \a font, creating them if the font wasn't used before. Each glyph
+  cell covers the advance and the ink of the glyph plus a pixel on both sides for antialiasing, so
+  overhanging glyphs (e.g. of italic fonts) aren't clipped.
+*/
+QCPLabelAtlas::GlyphSet *QCPLabelAtlas::glyphSet(const QFont &font)
+{
+  const QString key = font.key();
+  GlyphSet *result = mGlyphSets.object(key);
+  if (!result)
+  {
+    result = new GlyphSet;
+    QFontMetrics metrics(font);
+    result->height = metrics.height();
+    result->ascent = metrics.ascent();
+    result->stripWidth = 0;
+    result->glyphs.reserve(mCharacters.size());
+    for (int i=0; i<mCharacters.size(); ++i)
+    {
+      QRect ink = metrics.boundingRect(mCharacters.at(i));
+      Glyph glyph;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0) // QFontMetrics::width() is deprecated since Qt 5.11
+      glyph.advance = metrics.horizontalAdvance(mCharacters.at(i));
+#else
+      glyph.advance = metrics.width(mCharacters.at(i));
+#endif
+      glyph.left = qMin(0, ink.left())-1;
+      glyph.width = qMax(glyph.advance, ink.right()+1)+1-glyph.left;
+      glyph.x = result->stripWidth;
+      result->stripWidth += glyph.width;
+      result->glyphs.append(glyph);
+    }
+    mGlyphSets.insert(key, result, 1);
+  }
+  return result;
+}
+
+/*! \internal
+  
+  Returns the strip pixmap holding the glyphs of \a glyphSet rendered with \a font and \a color,
+  rendering it if it doesn't exist yet.
+*/
+const QPixmap &QCPLabelAtlas::strip(GlyphSet *glyphSet, const QFont &font, const QColor &color)
+{
+  if (!glyphSet->strips.contains(color.rgba()))
+  {
+    if (glyphSet->strips.size() >= 16) // colors that aren't used anymore, e.g. after animating the label color
+      glyphSet->strips.clear();
+    QPixmap newStrip(qMax(1, glyphSet->stripWidth), qMax(1, glyphSet->height));
+    newStrip.fill(Qt::transparent);
+    QPainter stripPainter(&newStrip);
+    stripPainter.setFont(font);
+    stripPainter.setPen(color);
+    for (int i=0; i<mCharacters.size(); ++i)
+    {
+      const Glyph &glyph = glyphSet->glyphs.at(i);
+      stripPainter.drawText(QPointF(glyph.x-glyph.left, glyphSet->ascent), QString(mCharacters.at(i)));
+    }
+    stripPainter.end();
+    glyphSet->strips.insert(color.rgba(), newStrip);
+  }
+  return glyphSet->strips[color.rgba()];
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPAxisPainterPrivate
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPAxisPainterPrivate
+
+  \internal
+  \brief (Private)
+  
+  This is a private class and not part of the public QCustomPlot interface.
+  
+  It is used by QCPAxis to do the low-level drawing of axis backbone, tick marks, tick labels and
+  axis label. Numeric tick labels are composed from the glyphs of the parent plot's \ref
+  QCPLabelAtlas to reduce replot times. The parameters are configured by directly accessing the
+  public member variables.
+*/
+
+/*!
+  Constructs a QCPAxisPainterPrivate instance.
+*/
+QCPAxisPainterPrivate::QCPAxisPainterPrivate(QCustomPlot *parentPlot) :
+  type(QCPAxis::atLeft),
+  basePen(QPen(Qt::black, 0, Qt::SolidLine, Qt::SquareCap)),
+  lowerEnding(QCPLineEnding::esNone),
+  upperEnding(QCPLineEnding::esNone),
+  labelPadding(0),
+  tickLabelPadding(0),
+  tickLabelRotation(0),
+  tickLabelSide(QCPAxis::lsOutside),
+  substituteExponent(true),
+  numberMultiplyCross(false),
+  tickLengthIn(5),
+  tickLengthOut(0),
+  subTickLengthIn(2),
+  subTickLengthOut(0),
+  tickPen(QPen(Qt::black, 0, Qt::SolidLine, Qt::SquareCap)),
+  subTickPen(QPen(Qt::black, 0, Qt::SolidLine, Qt::SquareCap)),
+  offset(0),
+  abbreviateDecimalPowers(false),
   reversedEndings(false),
-  mParentPlot(parentPlot),
-  mLabelCache(16) // cache at most 16 (tick) labels
+  mParentPlot(parentPlot)
 {
 }
 
@@ -6102,13 +6912,6 @@ QCPAxisPainterPrivate::~QCPAxisPainterPrivate()
 */
 void QCPAxisPainterPrivate::draw(QCPPainter *painter)
 {
-  QByteArray newHash = generateLabelParameterHash();
-  if (newHash != mLabelParameterHash)
-  {
-    mLabelCache.clear();
-    mLabelParameterHash = newHash;
-  }
-  
   QPoint origin;
   switch (type)
   {
@@ -6329,39 +7132,11 @@ int QCPAxisPainterPrivate::size() const
 
 /*! \internal
   
-  Clears the internal label cache. Upon the next \ref draw, all labels will be created new. This
-  method is called automatically in \ref draw, if any parameters have changed that invalidate the
-  cached labels, such as font, color, etc.
-*/
-void QCPAxisPainterPrivate::clearCache()
-{
-  mLabelCache.clear();
-}
-
-/*! \internal
-  
-  Returns a hash that allows uniquely identifying whether the label parameters have changed such
-  that the cached labels must be refreshed (\ref clearCache). It is used in \ref draw. If the
-  return value of this method hasn't changed since the last redraw, the respective label parameters
-  haven't changed and cached labels may be used.
-*/
-QByteArray QCPAxisPainterPrivate::generateLabelParameterHash() const
-{
-  QByteArray result;
-  result.append(QByteArray::number(tickLabelRotation));
-  result.append(QByteArray::number((int)tickLabelSide));
-  result.append(QByteArray::number((int)substituteExponent));
-  result.append(QByteArray::number((int)numberMultiplyCross));
-  result.append(tickLabelColor.name().toLatin1()+QByteArray::number(tickLabelColor.alpha(), 16));
-  result.append(tickLabelFont.toString().toLatin1());
-  return result;
-}
-
-/*! \internal
-  
-  Draws a single tick label with the provided \a painter, utilizing the internal label cache to
-  significantly speed up drawing of labels that were drawn in previous calls. The tick label is
-  always bound to an axis, the distance to the axis is controllable via \a distanceToAxis in
+  Draws a single tick label with the provided \a painter. If label caching is enabled (\ref
+  QCP::phCacheLabels) and the label can be composed from the glyphs of the parent plot's label atlas,
+  it is drawn with \ref drawComposedTickLabel, otherwise the text is laid out and drawn with \ref
+  drawTickLabel. The outcome is counted in \ref QCPRenderStatistics::labelAtlasHits and \ref
+  QCPRenderStatistics::labelAtlasMisses. The tick label is always bound to an axis, the distance to the axis is controllable via \a distanceToAxis in
   pixels. The pixel position in the axis direction is passed in the \a position parameter. Hence
   for the bottom axis, \a position would indicate the horizontal pixel position (not coordinate),
   at which the label should be drawn.
@@ -6389,61 +7164,38 @@ void QCPAxisPainterPrivate::placeTickLabel(QCPPainter *painter, double position,
     case QCPAxis::atTop:    labelAnchor = QPointF(position, axisRect.top()-distanceToAxis-offset); break;
     case QCPAxis::atBottom: labelAnchor = QPointF(position, axisRect.bottom()+distanceToAxis+offset); break;
   }
-  if (mParentPlot->plottingHints().testFlag(QCP::phCacheLabels) && !painter->modes().testFlag(QCPPainter::pmNoCaching)) // label caching enabled
+  // compose the label from the label atlas only if this painter draws it from there. Glyph pixmaps
+  // would be resampled by a scaling or rotating painter, so only on translated painters:
+  bool cacheLabels = mParentPlot->plottingHints().testFlag(QCP::phCacheLabels) && !painter->modes().testFlag(QCPPainter::pmNoCaching);
+  bool useAtlas = cacheLabels && painter->transform().type() <= QTransform::TxTranslate;
+  TickLabelData labelData = getTickLabelData(painter->font(), text, useAtlas);
+  QPointF finalPosition = labelAnchor + getTickLabelDrawOffset(labelData);
+  // if label would be partly clipped by widget border on sides, don't draw it (only for outside tick labels):
+  if (tickLabelSide == QCPAxis::lsOutside)
   {
-    if (!mLabelCache.contains(text))  // no cached label exists, create it
+    if (QCPAxis::orientation(type) == Qt::Horizontal)
     {
-      CachedLabel *newCachedLabel = new CachedLabel;
-      TickLabelData labelData = getTickLabelData(painter->font(), text);
-      newCachedLabel->offset = getTickLabelDrawOffset(labelData)+labelData.rotatedTotalBounds.topLeft();
-      newCachedLabel->pixmap = QPixmap(labelData.rotatedTotalBounds.size());
-      newCachedLabel->pixmap.fill(Qt::transparent);
-      QCPPainter cachePainter(&newCachedLabel->pixmap);
-      cachePainter.setPen(painter->pen());
-      drawTickLabel(&cachePainter, -labelData.rotatedTotalBounds.topLeft().x(), -labelData.rotatedTotalBounds.topLeft().y(), labelData);
-      mLabelCache.insert(text, newCachedLabel, 1);
-    }
-    // draw cached label:
-    const CachedLabel *cachedLabel = mLabelCache.object(text);
-    // if label would be partly clipped by widget border on sides, don't draw it (only for outside tick labels):
-    if (tickLabelSide == QCPAxis::lsOutside)
+      if (finalPosition.x()+(labelData.rotatedTotalBounds.width()+labelData.rotatedTotalBounds.left()) > viewportRect.right() ||
+          finalPosition.x()+labelData.rotatedTotalBounds.left() < viewportRect.left())
+        return;
+    } else
     {
-      if (QCPAxis::orientation(type) == Qt::Horizontal)
-      {
-        if (labelAnchor.x()+cachedLabel->offset.x()+cachedLabel->pixmap.width() > viewportRect.right() ||
-            labelAnchor.x()+cachedLabel->offset.x() < viewportRect.left())
-          return;
-      } else
-      {
-        if (labelAnchor.y()+cachedLabel->offset.y()+cachedLabel->pixmap.height() >viewportRect.bottom() ||
-            labelAnchor.y()+cachedLabel->offset.y() < viewportRect.top())
-          return;
-      }
+      if (finalPosition.y()+(labelData.rotatedTotalBounds.height()+labelData.rotatedTotalBounds.top()) > viewportRect.bottom() ||
+          finalPosition.y()+labelData.rotatedTotalBounds.top() < viewportRect.top())
+        return;
     }
-    painter->drawPixmap(labelAnchor+cachedLabel->offset, cachedLabel->pixmap);
-    finalSize = cachedLabel->pixmap.size();
-  } else // label caching disabled, draw text directly on surface:
+  }
+  if (labelData.composable)
+  {
+    drawComposedTickLabel(painter, finalPosition.x(), finalPosition.y(), labelData);
+    ++mParentPlot->mRenderStatistics.labelAtlasHits;
+  } else
   {
-    TickLabelData labelData = getTickLabelData(painter->font(), text);
-    QPointF finalPosition = labelAnchor + getTickLabelDrawOffset(labelData);
-    // if label would be partly clipped by widget border on sides, don't draw it (only for outside tick labels):
-    if (tickLabelSide == QCPAxis::lsOutside)
-    {
-      if (QCPAxis::orientation(type) == Qt::Horizontal)
-      {
-        if (finalPosition.x()+(labelData.rotatedTotalBounds.width()+labelData.rotatedTotalBounds.left()) > viewportRect.right() ||
-            finalPosition.x()+labelData.rotatedTotalBounds.left() < viewportRect.left())
-          return;
-      } else
-      {
-        if (finalPosition.y()+(labelData.rotatedTotalBounds.height()+labelData.rotatedTotalBounds.top()) > viewportRect.bottom() ||
-            finalPosition.y()+labelData.rotatedTotalBounds.top() < viewportRect.top())
-          return;
-      }
-    }
     drawTickLabel(painter, finalPosition.x(), finalPosition.y(), labelData);
-    finalSize = labelData.rotatedTotalBounds.size();
+    if (cacheLabels)
+      ++mParentPlot->mRenderStatistics.labelAtlasMisses;
   }
+  finalSize = labelData.rotatedTotalBounds.size();
   
   // expand passed tickLabelsSize if current tick label is larger:
   if (finalSize.width() > tickLabelsSize->width())
@@ -6457,9 +7209,9 @@ void QCPAxisPainterPrivate::placeTickLabel(QCPPainter *painter, double position,
   This is a \ref placeTickLabel helper function.
   
   Draws the tick label specified in \a labelData with \a painter at the pixel positions \a x and \a
-  y. This function is used by \ref placeTickLabel to create new tick labels for the cache, or to
-  directly draw the labels on the QCustomPlot surface when label caching is disabled, i.e. when
-  QCP::phCacheLabels plotting hint is not set.
+  y. This function is used by \ref placeTickLabel for labels that can't be composed from the label
+  atlas (see \ref drawComposedTickLabel), and for all labels when label caching is disabled, i.e.
+  when QCP::phCacheLabels plotting hint is not set.
 */
 void QCPAxisPainterPrivate::drawTickLabel(QCPPainter *painter, double x, double y, const TickLabelData &labelData) const
 {
@@ -6490,6 +7242,26 @@ void QCPAxisPainterPrivate::drawTickLabel(QCPPainter *painter, double x, double
   painter->setFont(oldFont);
 }
 
+/*! \internal
+  
+  This is a \ref placeTickLabel helper function.
+  
+  Draws the tick label specified in \a labelData with \a painter at the pixel positions \a x and \a
+  y, like \ref drawTickLabel, but composed from the glyphs of the parent plot's \ref QCPLabelAtlas.
+  \a labelData must be composable (see \ref getTickLabelData). The label is drawn in the color of
+  the painter's pen.
+  
+  Since the bounds of a composable label are the summed glyph advances, the centering that \ref
+  drawTickLabel does for labels without beautiful powers is already accounted for.
+*/
+void QCPAxisPainterPrivate::drawComposedTickLabel(QCPPainter *painter, double x, double y, const TickLabelData &labelData) const
+{
+  QColor color = painter->pen().color();
+  mParentPlot->mLabelAtlas.draw(painter, QPointF(x, y), labelData.baseFont, color, labelData.basePart);
+  if (!labelData.expPart.isEmpty()) // indicator that beautiful powers must be used
+    mParentPlot->mLabelAtlas.draw(painter, QPointF(x+labelData.baseBounds.width()+1, y), labelData.expFont, color, labelData.expPart);
+}
+
 /*! \internal
   
   This is a \ref placeTickLabel helper function.
@@ -6497,10 +7269,16 @@ void QCPAxisPainterPrivate::drawTickLabel(QCPPainter *painter, double x, double
   Transforms the passed \a text and \a font to a tickLabelData structure that can then be further
   processed by \ref getTickLabelDrawOffset and \ref drawTickLabel. It splits the text into base and
   exponent if necessary (member substituteExponent) and calculates appropriate bounding boxes.
+  
+  If \a useAtlas is true, the label isn't rotated and all parts consist of glyphs of the parent
+  plot's label atlas, the bounding boxes are taken from the atlas and the label is marked as
+  composable, so it must be drawn with \ref drawComposedTickLabel. Otherwise they are calculated
+  with QFontMetrics, for drawing with \ref drawTickLabel.
 */
-QCPAxisPainterPrivate::TickLabelData QCPAxisPainterPrivate::getTickLabelData(const QFont &font, const QString &text) const
+QCPAxisPainterPrivate::TickLabelData QCPAxisPainterPrivate::getTickLabelData(const QFont &font, const QString &text, bool useAtlas) const
 {
   TickLabelData result;
+  result.composable = false;
   
   // determine whether beautiful decimal powers should be used
   bool useBeautifulPowers = false;
@@ -6512,6 +7290,9 @@ QCPAxisPainterPrivate::TickLabelData QCPAxisPainterPrivate::getTickLabelData(con
       useBeautifulPowers = true;
   }
   
+  // the label atlas only holds unrotated glyphs:
+  bool tryAtlas = useAtlas && qFuzzyIsNull(tickLabelRotation);
+  
   // calculate text bounding rects and do string preparation for beautiful decimal powers:
   result.baseFont = font;
   if (result.baseFont.pointSizeF() > 0) // On some rare systems, this sometimes is initialized with -1 (Qt bug?), so we check here before possibly setting a negative value in the next line
@@ -6535,13 +7316,21 @@ QCPAxisPainterPrivate::TickLabelData QCPAxisPainterPrivate::getTickLabelData(con
     result.expFont = font;
     result.expFont.setPointSize(result.expFont.pointSize()*0.75);
     // calculate bounding rects of base part, exponent part and total one:
-    result.baseBounds = QFontMetrics(result.baseFont).boundingRect(0, 0, 0, 0, Qt::TextDontClip, result.basePart);
-    result.expBounds = QFontMetrics(result.expFont).boundingRect(0, 0, 0, 0, Qt::TextDontClip, result.expPart);
+    result.composable = tryAtlas &&
+        mParentPlot->mLabelAtlas.measure(result.baseFont, result.basePart, &result.baseBounds) &&
+        mParentPlot->mLabelAtlas.measure(result.expFont, result.expPart, &result.expBounds);
+    if (!result.composable)
+    {
+      result.baseBounds = QFontMetrics(result.baseFont).boundingRect(0, 0, 0, 0, Qt::TextDontClip, result.basePart);
+      result.expBounds = QFontMetrics(result.expFont).boundingRect(0, 0, 0, 0, Qt::TextDontClip, result.expPart);
+    }
     result.totalBounds = result.baseBounds.adjusted(0, 0, result.expBounds.width()+2, 0); // +2 consists of the 1 pixel spacing between base and exponent (see drawTickLabel) and an extra pixel to include AA
   } else // useBeautifulPowers == false
   {
     result.basePart = text;
-    result.totalBounds = QFontMetrics(result.baseFont).boundingRect(0, 0, 0, 0, Qt::TextDontClip | Qt::AlignHCenter, result.basePart);
+    result.composable = tryAtlas && mParentPlot->mLabelAtlas.measure(result.baseFont, result.basePart, &result.totalBounds);
+    if (!result.composable)
+      result.totalBounds = QFontMetrics(result.baseFont).boundingRect(0, 0, 0, 0, Qt::TextDontClip | Qt::AlignHCenter, result.basePart);
   }
   result.totalBounds.moveTopLeft(QPoint(0, 0)); // want bounding box aligned top left at origin, independent of how it was created, to make further processing simpler
   
@@ -6669,17 +7458,10 @@ QPointF QCPAxisPainterPrivate::getTickLabelDrawOffset(const TickLabelData &label
 */
 void QCPAxisPainterPrivate::getMaxTickLabelSize(const QFont &font, const QString &text,  QSize *tickLabelsSize) const
 {
-  // note: this function must return the same tick label sizes as the placeTickLabel function.
-  QSize finalSize;
-  if (mParentPlot->plottingHints().testFlag(QCP::phCacheLabels) && mLabelCache.contains(text)) // label caching enabled and have cached label
-  {
-    const CachedLabel *cachedLabel = mLabelCache.object(text);
-    finalSize = cachedLabel->pixmap.size();
-  } else // label caching disabled or no label with this text cached:
-  {
-    TickLabelData labelData = getTickLabelData(font, text);
-    finalSize = labelData.rotatedTotalBounds.size();
-  }
+  // note: this function must return the same tick label sizes as the placeTickLabel function. The
+  // painter isn't known during the layout, so the atlas is used like for a replot on the widget:
+  TickLabelData labelData = getTickLabelData(font, text, mParentPlot->plottingHints().testFlag(QCP::phCacheLabels));
+  QSize finalSize = labelData.rotatedTotalBounds.size();
   
   // expand passed tickLabelsSize if current tick label is larger:
   if (finalSize.width() > tickLabelsSize->width())
@@ -7181,6 +7963,23 @@ QCP::Interaction QCPAbstractPlottable::selectionCategory() const
   return QCP::iSelectPlottables;
 }
 
+/*! \internal
+  
+  Called by the parent plot right before \ref draw, after the layout and the axis ranges are
+  final. Plottables may transform their visible data to pixel coordinates here and keep the result
+  for the following \ref draw, which then only paints it.
+  
+  If the plotting hint \ref QCP::phParallelPreparation is set, this function is called for
+  several plottables at once, each on a thread of the global QThreadPool. Reimplementations must
+  therefore only read the data and axes and only write members of their own plottable. They must
+  not paint or emit signals.
+  
+  The default implementation does nothing, so the plottable prepares its data in \ref draw.
+*/
+void QCPAbstractPlottable::prepareDraw()
+{
+}
+
 /*! \internal
   
   Convenience function for transforming a key/value pair to pixels on the QCustomPlot surface,
@@ -8726,6 +9525,140 @@ QCP::Interaction QCPAbstractItem::selectionCategory() const
 
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPPlottablePreparation
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPPlottablePreparation
+  \brief Runs QCPAbstractPlottable::prepareDraw of one plottable on a thread pool
+  
+  This class is only used internally by \ref QCustomPlot::preparePlottables. It releases the
+  passed semaphore once the plottable is prepared, so the plot knows when it may start painting.
+*/
+class QCPPlottablePreparation : public QRunnable
+{
+public:
+  QCPPlottablePreparation(QCPAbstractPlottable *plottable, QSemaphore *finished) :
+    mPlottable(plottable),
+    mFinished(finished)
+  {
+  }
+  
+  virtual void run()
+  {
+    mPlottable->prepareDraw();
+    mFinished->release();
+  }
+  
+private:
+  QCPAbstractPlottable *mPlottable;
+  QSemaphore *mFinished;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPRenderStatistics
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPRenderStatistics
+  \brief Counters and frame times collected by QCustomPlot while replotting
+  
+  A copy of the current statistics is returned by \ref QCustomPlot::renderStatistics, and they are
+  reset with \ref QCustomPlot::resetRenderStatistics.
+  
+  \a frames is the number of finished replots, with their durations in \a lastFrameTime, \a
+  maxFrameTime and \a totalFrameTime (see also \ref averageFrameTime). For asynchronous replots
+  (\ref QCustomPlot::setAsynchronousReplot), the time until the frame was rasterized is counted.
+  
+  \a coalescedRequests counts the replot requests that were merged into an already scheduled
+  replot (see \ref QCustomPlot::rpQueuedReplot), \a droppedFrames the replots that were skipped
+  because an asynchronous frame was still being rasterized.
+  
+  With label caching enabled (\ref QCP::phCacheLabels), \a labelAtlasHits counts the tick labels
+  that were composed from the glyphs shared by all axes, and \a labelAtlasMisses the ones that had
+  to be laid out as text, because they contain other characters (e.g. date labels) or are rotated.
+  
+  \a tickSetupsReused counts the axis tick setups that were skipped because neither the range nor
+  the tick and label parameters of the axis had changed. Of the tick labels that were set up, \a
+  tickLabelsReused were taken over from ticks at the same position in the previous setup, and \a
+  tickLabelsFormatted had to be formatted (see \ref QCPAxis::setAutoTickLabels).
+*/
+
+/*! \fn double QCPRenderStatistics::averageFrameTime() const
+  
+  Returns the average duration of a frame in milliseconds, or 0 if there were no frames.
+*/
+
+/*!
+  Constructs statistics with all counters and times set to zero.
+*/
+QCPRenderStatistics::QCPRenderStatistics() :
+  frames(0),
+  droppedFrames(0),
+  coalescedRequests(0),
+  labelAtlasHits(0),
+  labelAtlasMisses(0),
+  tickSetupsReused(0),
+  tickLabelsReused(0),
+  tickLabelsFormatted(0),
+  lastFrameTime(0),
+  maxFrameTime(0),
+  totalFrameTime(0)
+{
+}
+
+/*!
+  Counts a finished frame that took \a frameTime milliseconds.
+*/
+void QCPRenderStatistics::addFrame(double frameTime)
+{
+  ++frames;
+  lastFrameTime = frameTime;
+  maxFrameTime = qMax(maxFrameTime, frameTime);
+  totalFrameTime += frameTime;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPAsyncReplot
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPAsyncReplot
+  \brief Rasterizes a recorded frame of a QCustomPlot on a worker thread
+  
+  This class is only used internally by \ref QCustomPlot::startAsyncReplot. It plays the QPicture
+  recorded in the GUI thread back into a new QImage and passes the image to \ref
+  QCustomPlot::finishAsyncReplot with a queued call.
+*/
+class QCPAsyncReplot : public QRunnable
+{
+public:
+  QCPAsyncReplot(QCustomPlot *parentPlot, const QPicture &picture, const QSize &size, const QColor &background) :
+    mParentPlot(parentPlot),
+    mPicture(picture),
+    mSize(size),
+    mBackground(background)
+  {
+  }
+  
+  virtual void run()
+  {
+    QImage frame(mSize, QImage::Format_ARGB32_Premultiplied);
+    frame.fill(mBackground);
+    QPainter painter(&frame);
+    painter.drawPicture(0, 0, mPicture);
+    painter.end();
+    QMetaObject::invokeMethod(mParentPlot, "finishAsyncReplot", Qt::QueuedConnection, Q_ARG(QImage, frame));
+  }
+  
+private:
+  QCustomPlot *mParentPlot;
+  QPicture mPicture;
+  QSize mSize;
+  QColor mBackground;
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////// QCustomPlot
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -9049,11 +9982,15 @@ QCustomPlot::QCustomPlot(QWidget *parent) :
   mBackgroundScaled(true),
   mBackgroundScaledMode(Qt::KeepAspectRatioByExpanding),
   mCurrentLayer(0),
-  mPlottingHints(QCP::phCacheLabels|QCP::phForceRepaint),
+  mPlottingHints(QCP::phCacheLabels|QCP::phForceRepaint|QCP::phParallelPreparation),
   mMultiSelectModifier(Qt::ControlModifier),
-  mPaintBuffer(size()),
+  mAsynchronousReplot(false),
+  mPaintBuffer(size(), QImage::Format_ARGB32_Premultiplied),
+  mLayerBuffersValid(false),
   mMouseEventElement(0),
-  mReplotting(false)
+  mReplotting(false),
+  mAsyncReplotRunning(false),
+  mAsyncReplotPending(false)
 {
   setAttribute(Qt::WA_NoMousePropagation);
   setAttribute(Qt::WA_OpaquePaintEvent);
@@ -9061,6 +9998,9 @@ QCustomPlot::QCustomPlot(QWidget *parent) :
   QLocale currentLocale = locale();
   currentLocale.setNumberOptions(QLocale::OmitGroupSeparator);
   setLocale(currentLocale);
+  mAsyncPool.setMaxThreadCount(1); // frames are rasterized one after the other
+  mReplotTimer.setSingleShot(true);
+  connect(&mReplotTimer, SIGNAL(timeout()), this, SLOT(replot()));
   
   // create initial layers:
   mLayers.append(new QCPLayer(this, QLatin1String("background")));
@@ -9105,6 +10045,7 @@ QCustomPlot::QCustomPlot(QWidget *parent) :
 
 QCustomPlot::~QCustomPlot()
 {
+  mAsyncPool.waitForDone(); // a frame still being rasterized would report back to this instance
   clearPlottables();
   clearItems();
 
@@ -9369,6 +10310,38 @@ void QCustomPlot::setMultiSelectModifier(Qt::KeyboardModifier modifier)
   mMultiSelectModifier = modifier;
 }
 
+/*!
+  Sets whether \ref replot rasterizes the plot on a worker thread instead of the GUI thread.
+  
+  If \a enabled, \ref replot only records the paint operations of the plot into a QPicture, which
+  is cheap compared to rasterizing them, especially for antialiased lines and fills of large data
+  sets. The picture is then played back into a QImage (QImage::Format_ARGB32_Premultiplied) on a
+  worker thread, while the GUI thread keeps handling events. When the frame is done, it replaces
+  the previously shown frame as a whole and the widget is updated. Replots requested while a frame
+  is still being rasterized are coalesced into a single replot of the latest state, once that
+  frame is done.
+  
+  Since the picture is a snapshot of the paint operations, the plot may be changed freely while the
+  frame is rasterized. Cached axis labels (\ref QCP::phCacheLabels) and the fast polyline drawing
+  (\ref QCP::phFastPolylines) aren't used for asynchronous frames. Buffered layers (\ref
+  QCPLayer::setMode) aren't used either, \ref QCPLayer::replot causes a full replot.
+  
+  Exports like \ref savePng or \ref toPixmap are not affected by this setting.
+*/
+void QCustomPlot::setAsynchronousReplot(bool enabled)
+{
+  if (mAsynchronousReplot == enabled)
+    return;
+  mAsynchronousReplot = enabled;
+  if (!enabled)
+  {
+    mAsyncPool.waitForDone();
+    mAsyncReplotPending = false;
+    mAsyncFrame = QImage();
+    mLayerBuffersValid = false;
+  }
+}
+
 /*!
   Sets the viewport of this QCustomPlot. The Viewport is the area that the top level layout
   (QCustomPlot::plotLayout()) uses as its rect. Normally, the viewport is the entire widget rect.
@@ -10115,6 +11088,7 @@ bool QCustomPlot::addLayer(const QString &name, QCPLayer *otherLayer, QCustomPlo
   QCPLayer *newLayer = new QCPLayer(this, name);
   mLayers.insert(otherLayer->index() + (insertMode==limAbove ? 1:0), newLayer);
   updateLayerIndices();
+  mLayerBuffersValid = false;
   return true;
 }
 
@@ -10166,6 +11140,7 @@ bool QCustomPlot::removeLayer(QCPLayer *layer)
   delete layer;
   mLayers.removeOne(layer);
   updateLayerIndices();
+  mLayerBuffersValid = false;
   return true;
 }
 
@@ -10193,6 +11168,7 @@ bool QCustomPlot::moveLayer(QCPLayer *layer, QCPLayer *otherLayer, QCustomPlot::
   
   mLayers.move(layer->index(), otherLayer->index() + (insertMode==limAbove ? 1:0));
   updateLayerIndices();
+  mLayerBuffersValid = false;
   return true;
 }
 
@@ -10375,28 +11351,89 @@ void QCustomPlot::deselectAll()
   afterReplot is emitted. It is safe to mutually connect the replot slot with any of those two
   signals on two QCustomPlots to make them replot synchronously, it won't cause an infinite
   recursion.
+  
+  If there are buffered layers (see \ref QCPLayer::setMode), every layer is drawn into its buffer
+  and the frame is composited from the buffers. A single buffered layer can then be redrawn on its
+  own with \ref QCPLayer::replot.
+  
+  If asynchronous replots are enabled (see \ref setAsynchronousReplot), this function returns
+  before the new frame is rasterized, and \a refreshPriority is ignored.
+  
+  With \a refreshPriority \ref rpQueuedReplot, the replot is only scheduled, at the earliest one
+  display refresh interval after the start of the previous replot. Requests arriving before the
+  scheduled replot happens are merged into it. This is what the range drag and zoom interactions
+  use, so input devices with high event rates don't cause more replots than can be shown. Any
+  other replot in the meantime takes the place of the scheduled one.
+  
+  Frame times and the numbers of merged requests and skipped frames are collected in \ref
+  renderStatistics.
 */
 void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
 {
+  if (refreshPriority == rpQueuedReplot)
+  {
+    if (mReplotTimer.isActive())
+      ++mRenderStatistics.coalescedRequests;
+    else
+    {
+      const int interval = frameInterval();
+      const qint64 sinceLastFrame = mFrameClock.isValid() ? mFrameClock.elapsed() : interval;
+      mReplotTimer.start(int(qMax(qint64(0), interval-sinceLastFrame)));
+    }
+    return;
+  }
   if (mReplotting) // incase signals loop back to replot slot
     return;
+  mReplotTimer.stop(); // this replot also serves a scheduled one
   mReplotting = true;
+  mFrameClock.start();
   emit beforeReplot();
   
-  mPaintBuffer.fill(mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color() : Qt::transparent);
-  QCPPainter painter;
-  painter.begin(&mPaintBuffer);
-  if (painter.isActive())
+  bool painted = false;
+  if (mAsynchronousReplot)
+  {
+    if (mAsyncReplotRunning)
+    {
+      // skip this frame, finishAsyncReplot replots the latest state once the running frame is done:
+      if (mAsyncReplotPending)
+        ++mRenderStatistics.coalescedRequests;
+      else
+        ++mRenderStatistics.droppedFrames;
+      mAsyncReplotPending = true;
+      painted = true;
+    } else
+      painted = startAsyncReplot();
+    if (!painted)
+      qDebug() << Q_FUNC_INFO << "Couldn't activate painter on picture. This usually happens because QCustomPlot has width or height zero.";
+    emit afterReplot();
+    mReplotting = false;
+    return;
+  }
+  if (hasBufferedLayers())
+  {
+    painted = drawLayerBuffers();
+  } else
+  {
+    mPaintBuffer.fill(mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color() : Qt::transparent);
+    QCPPainter painter;
+    painter.begin(&mPaintBuffer);
+    if (painter.isActive())
+    {
+      painter.setRenderHint(QPainter::HighQualityAntialiasing); // to make Antialiasing look good if using the OpenGL graphicssystem
+      if (mBackgroundBrush.style() != Qt::SolidPattern && mBackgroundBrush.style() != Qt::NoBrush)
+        painter.fillRect(mViewport, mBackgroundBrush);
+      draw(&painter);
+      painter.end();
+      painted = true;
+    }
+  }
+  if (painted)
   {
-    painter.setRenderHint(QPainter::HighQualityAntialiasing); // to make Antialiasing look good if using the OpenGL graphicssystem
-    if (mBackgroundBrush.style() != Qt::SolidPattern && mBackgroundBrush.style() != Qt::NoBrush)
-      painter.fillRect(mViewport, mBackgroundBrush);
-    draw(&painter);
-    painter.end();
     if ((refreshPriority == rpHint && mPlottingHints.testFlag(QCP::phForceRepaint)) || refreshPriority==rpImmediate)
       repaint();
     else
       update();
+    mRenderStatistics.addFrame(mFrameClock.nsecsElapsed()/1e6);
   } else // might happen if QCustomPlot has width or height zero
     qDebug() << Q_FUNC_INFO << "Couldn't activate painter on buffer. This usually happens because QCustomPlot has width or height zero.";
   
@@ -10404,6 +11441,14 @@ void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
   mReplotting = false;
 }
 
+/*!
+  Resets all counters and times of \ref renderStatistics to zero.
+*/
+void QCustomPlot::resetRenderStatistics()
+{
+  mRenderStatistics = QCPRenderStatistics();
+}
+
 /*!
   Rescales the axes such that all plottables (like graphs) in the plot are fully visible.
   
@@ -10663,25 +11708,45 @@ QSize QCustomPlot::sizeHint() const
 /*! \internal
   
   Event handler for when the QCustomPlot widget needs repainting. This does not cause a \ref replot, but
-  draws the internal buffer on the widget surface.
+  draws the part of the internal buffer inside the event's region on the widget surface.
 */
 void QCustomPlot::paintEvent(QPaintEvent *event)
 {
-  Q_UNUSED(event);
   QPainter painter(this);
-  painter.drawPixmap(0, 0, mPaintBuffer);
-}
-
-/*! \internal
-  
-  Event handler for a resize of the QCustomPlot widget. Causes the internal buffer to be resized to
+  if (mAsynchronousReplot && !mAsyncFrame.isNull())
+  {
+    // until the frame for a new widget size is done, the uncovered part shows the background:
+    if (mAsyncFrame.size() != size())
+      painter.fillRect(event->rect(), mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color() : palette().color(backgroundRole()));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0) // QRegion::rects() is deprecated since Qt 5.11, the region itself can be iterated since 5.8
+    for (const QRect &rect : event->region())
+#else
+    foreach (const QRect &rect, event->region().rects())
+#endif
+      painter.drawImage(rect, mAsyncFrame, rect);
+    return;
+  }
+  // only blit what needs repainting, e.g. the region passed to update() by QCPLayer::replot:
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+  for (const QRect &rect : event->region())
+#else
+  foreach (const QRect &rect, event->region().rects())
+#endif
+    painter.drawImage(rect, mPaintBuffer, rect);
+}
+
+/*! \internal
+  
+  Event handler for a resize of the QCustomPlot widget. Causes the internal buffer to be resized to
   the new size. The viewport (which becomes the outer rect of mPlotLayout) is resized
   appropriately. Finally a \ref replot is performed.
 */
 void QCustomPlot::resizeEvent(QResizeEvent *event)
 {
   // resize and repaint the buffer:
-  mPaintBuffer = QPixmap(event->size());
+  mPaintBuffer = QImage(event->size(), QImage::Format_ARGB32_Premultiplied);
+  // asynchronous replots don't paint into the buffer, but paintEvent shows it until their first frame is done:
+  mPaintBuffer.fill(mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color() : QColor(Qt::transparent));
   setViewport(rect());
   replot(rpQueued); // queued update is important here, to prevent painting issues in some contexts
 }
@@ -10882,29 +11947,15 @@ void QCustomPlot::wheelEvent(QWheelEvent *event)
 */
 void QCustomPlot::draw(QCPPainter *painter)
 {
-  // run through layout phases:
-  mPlotLayout->update(QCPLayoutElement::upPreparation);
-  mPlotLayout->update(QCPLayoutElement::upMargins);
-  mPlotLayout->update(QCPLayoutElement::upLayout);
+  updateLayout();
+  preparePlottables(mLayers);
   
   // draw viewport background pixmap:
   drawBackground(painter);
 
   // draw all layered objects (grid, axes, plottables, items, legend,...):
   foreach (QCPLayer *layer, mLayers)
-  {
-    foreach (QCPLayerable *child, layer->children())
-    {
-      if (child->realVisibility())
-      {
-        painter->save();
-        painter->setClipRect(child->clipRect().translated(0, -1));
-        child->applyDefaultAntialiasingHint(painter);
-        child->draw(painter);
-        painter->restore();
-      }
-    }
-  }
+    layer->draw(painter);
   
   /* Debug code to draw all layout element rects
   foreach (QCPLayoutElement* el, findChildren<QCPLayoutElement*>())
@@ -10957,6 +12008,261 @@ void QCustomPlot::drawBackground(QCPPainter *painter)
   }
 }
 
+/*! \internal
+  
+  Runs through the layout phases of the plot layout, so the layout elements (e.g. axis rects) get
+  their final geometry before they are drawn.
+*/
+void QCustomPlot::updateLayout()
+{
+  mPlotLayout->update(QCPLayoutElement::upPreparation);
+  mPlotLayout->update(QCPLayoutElement::upMargins);
+  mPlotLayout->update(QCPLayoutElement::upLayout);
+}
+
+/*! \internal
+  
+  Lets the visible plottables on \a layers prepare their pixel data (see \ref
+  QCPAbstractPlottable::prepareDraw) before they are drawn. The plottables are handed to the global
+  QThreadPool, the calling thread prepares the last one itself and then waits for the others. A
+  plottable for which the pool has no free thread is prepared by the calling thread, too.
+  
+  Does nothing if the plotting hint \ref QCP::phParallelPreparation isn't set, the plottables
+  then prepare their data in their draw function.
+*/
+void QCustomPlot::preparePlottables(const QList<QCPLayer*> &layers)
+{
+  if (!mPlottingHints.testFlag(QCP::phParallelPreparation))
+    return;
+  
+  QList<QCPAbstractPlottable*> plottables;
+  foreach (QCPAbstractPlottable *plottable, mPlottables)
+  {
+    if (plottable->realVisibility() && layers.contains(plottable->layer()))
+      plottables.append(plottable);
+  }
+  if (plottables.isEmpty())
+    return;
+  
+  QThreadPool *pool = QThreadPool::globalInstance();
+  QSemaphore finished;
+  int started = 0;
+  for (int i=0; i<plottables.size()-1; ++i)
+  {
+    QCPPlottablePreparation *preparation = new QCPPlottablePreparation(plottables.at(i), &finished);
+    if (pool->tryStart(preparation))
+      ++started;
+    else
+    {
+      delete preparation;
+      plottables.at(i)->prepareDraw();
+    }
+  }
+  plottables.last()->prepareDraw();
+  finished.acquire(started);
+}
+
+/*! \internal
+  
+  Returns whether any layer has the mode \ref QCPLayer::lmBuffered. Only then \ref replot draws
+  into layer buffers.
+*/
+bool QCustomPlot::hasBufferedLayers() const
+{
+  foreach (QCPLayer *layer, mLayers)
+  {
+    if (layer->mode() == QCPLayer::lmBuffered)
+      return true;
+  }
+  return false;
+}
+
+/*! \internal
+  
+  Assigns each layer the index of the buffer in \ref mLayerBuffers it is drawn into. Every
+  buffered layer gets a buffer of its own, consecutive logical layers share one. The buffers are
+  only reallocated if their number or the size of the paint buffer changed.
+*/
+void QCustomPlot::setupLayerBuffers()
+{
+  int bufferCount = 0;
+  QCPLayer *previousLayer = 0;
+  foreach (QCPLayer *layer, mLayers)
+  {
+    if (!previousLayer || layer->mMode == QCPLayer::lmBuffered || previousLayer->mMode == QCPLayer::lmBuffered)
+      ++bufferCount;
+    layer->mBufferIndex = bufferCount-1;
+    previousLayer = layer;
+  }
+  if (mLayerBuffers.size() != bufferCount || (!mLayerBuffers.isEmpty() && mLayerBuffers.first().size() != mPaintBuffer.size()))
+  {
+    mLayerBuffers.clear();
+    for (int i=0; i<bufferCount; ++i)
+      mLayerBuffers.append(QImage(mPaintBuffer.size(), QImage::Format_ARGB32_Premultiplied));
+  }
+}
+
+/*! \internal
+  
+  Used by \ref replot if there are buffered layers. Updates the layout, draws all layers into their
+  buffers and composites them into the paint buffer. The geometry the buffers were drawn with is
+  remembered, so \ref QCPLayer::replot can tell whether the buffers of the other layers are still
+  valid.
+  
+  Returns false if a buffer couldn't be painted on, e.g. because the plot has zero size.
+*/
+bool QCustomPlot::drawLayerBuffers()
+{
+  if (mPaintBuffer.isNull())
+    return false;
+  updateLayout();
+  preparePlottables(mLayers);
+  setupLayerBuffers();
+  for (int i=0; i<mLayerBuffers.size(); ++i)
+    mLayerBuffers[i].fill(Qt::transparent);
+  
+  QCPPainter painter;
+  int paintedBuffer = -1;
+  foreach (QCPLayer *layer, mLayers)
+  {
+    if (layer->mBufferIndex != paintedBuffer) // first layer of the next buffer
+    {
+      if (painter.isActive())
+        painter.end();
+      paintedBuffer = layer->mBufferIndex;
+      if (!painter.begin(&mLayerBuffers[paintedBuffer]))
+        return false;
+      painter.setRenderHint(QPainter::HighQualityAntialiasing);
+    }
+    layer->draw(&painter);
+  }
+  if (painter.isActive())
+    painter.end();
+  
+  mLayerBufferGeometry = layerBufferGeometry();
+  mLayerBuffersValid = true;
+  return composeLayerBuffers(QRegion(mPaintBuffer.rect()));
+}
+
+/*! \internal
+  
+  Composites the frame in the paint buffer from the background and the layer buffers, bottom to
+  top. Only the pixels in \a region are touched. Returns false if the paint buffer couldn't be
+  painted on.
+*/
+bool QCustomPlot::composeLayerBuffers(const QRegion &region)
+{
+  QCPPainter painter;
+  painter.begin(&mPaintBuffer);
+  if (!painter.isActive())
+    return false;
+  painter.setClipRegion(region);
+  painter.setCompositionMode(QPainter::CompositionMode_Source);
+  painter.fillRect(mPaintBuffer.rect(), mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color() : QColor(Qt::transparent));
+  painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+  if (mBackgroundBrush.style() != Qt::SolidPattern && mBackgroundBrush.style() != Qt::NoBrush)
+    painter.fillRect(mViewport, mBackgroundBrush);
+  drawBackground(&painter);
+  for (int i=0; i<mLayerBuffers.size(); ++i)
+    painter.drawImage(0, 0, mLayerBuffers.at(i));
+  painter.end();
+  return true;
+}
+
+/*! \internal
+  
+  Returns the geometry the layer buffers depend on: the viewport, the rects of all axis rects and
+  the ranges and scales of their axes. If it differs from \ref mLayerBufferGeometry, the buffers
+  drawn in the last \ref replot are outdated.
+*/
+QVector<double> QCustomPlot::layerBufferGeometry() const
+{
+  QVector<double> result;
+  result << mViewport.left() << mViewport.top() << mViewport.width() << mViewport.height();
+  foreach (QCPAxisRect *axisRect, axisRects())
+  {
+    const QRect rect = axisRect->rect();
+    result << rect.left() << rect.top() << rect.width() << rect.height();
+    foreach (QCPAxis *axis, axisRect->axes())
+    {
+      result << axis->range().lower << axis->range().upper << axis->scaleType()
+             << axis->scaleLogBase() << axis->rangeReversed();
+    }
+  }
+  return result;
+}
+
+/*! \internal
+  
+  Records the plot into a QPicture and hands it to \ref mAsyncPool, which rasterizes it into a
+  QImage and passes that to \ref finishAsyncReplot. Returns false if the picture couldn't be
+  painted on.
+  
+  \see setAsynchronousReplot
+*/
+bool QCustomPlot::startAsyncReplot()
+{
+  if (mPaintBuffer.isNull())
+    return false;
+  QPicture picture;
+  QCPPainter painter;
+  if (!painter.begin(&picture))
+    return false;
+  painter.setMode(QCPPainter::pmNoCaching); // cached labels are pixmaps, which may only be used in the GUI thread
+  painter.setRenderHint(QPainter::HighQualityAntialiasing);
+  if (mBackgroundBrush.style() != Qt::SolidPattern && mBackgroundBrush.style() != Qt::NoBrush)
+    painter.fillRect(mViewport, mBackgroundBrush);
+  draw(&painter);
+  painter.end();
+  mLayerBuffersValid = false; // the layer buffers weren't drawn, so QCPLayer::replot must replot everything
+  
+  const QColor background = mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color() : QColor(Qt::transparent);
+  mAsyncReplotRunning = true;
+  mAsyncFrameClock.start();
+  mAsyncPool.start(new QCPAsyncReplot(this, picture, mPaintBuffer.size(), background));
+  return true;
+}
+
+/*! \internal
+  
+  Called in the GUI thread when the worker thread finished rasterizing a frame. The \a frame
+  replaces the shown one and the widget is updated. If replots were requested in the meantime,
+  one replot of the current state follows.
+  
+  \see setAsynchronousReplot
+*/
+void QCustomPlot::finishAsyncReplot(const QImage &frame)
+{
+  mAsyncReplotRunning = false;
+  if (!mAsynchronousReplot)
+    return;
+  mAsyncFrame = frame;
+  mRenderStatistics.addFrame(mAsyncFrameClock.nsecsElapsed()/1e6);
+  update();
+  if (mAsyncReplotPending)
+  {
+    mAsyncReplotPending = false;
+    replot(rpQueued);
+  }
+}
+
+/*! \internal
+  
+  Returns the refresh interval in milliseconds of the screen the widget is shown on, which is the
+  pace of replots scheduled with \ref rpQueuedReplot. Assumes 60 Hz if the refresh rate isn't
+  known, e.g. before Qt5.
+*/
+int QCustomPlot::frameInterval() const
+{
+  double refreshRate = 60;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+  QWindow *windowHandle = window() ? window()->windowHandle() : 0;
+  if (windowHandle && windowHandle->screen() && windowHandle->screen()->refreshRate() > 0)
+    refreshRate = windowHandle->screen()->refreshRate();
+#endif
+  return qMax(1, qRound(1000.0/refreshRate));
+}
+
 
 /*! \internal
   
@@ -11023,6 +12329,11 @@ QCPLayerable *QCustomPlot::layerableAt(const QPointF &pos, bool onlySelectable,
     {
       if (!layerables.at(i)->realVisibility())
         continue;
+      // a hit is closer than the selection tolerance to what was drawn, so anything farther from the
+      // drawn rect can be skipped without running the (possibly expensive) selectTest:
+      const QRect drawnRect = layerables.at(i)->drawnRect();
+      if (!drawnRect.isNull() && !QRectF(drawnRect).adjusted(-selectionTolerance(), -selectionTolerance(), selectionTolerance(), selectionTolerance()).contains(pos))
+        continue;
       QVariant details;
       double dist = layerables.at(i)->selectTest(pos, onlySelectable, &details);
       if (dist >= 0 && dist < minimumDistance)
@@ -12557,7 +13868,7 @@ void QCPAxisRect::mouseMoveEvent(QMouseEvent *event)
     {
       if (mParentPlot->noAntialiasingOnDrag())
         mParentPlot->setNotAntialiasedElements(QCP::aeAll);
-      mParentPlot->replot();
+      mParentPlot->replot(QCustomPlot::rpQueuedReplot);
     }
   }
 }
@@ -12609,7 +13920,7 @@ void QCPAxisRect::wheelEvent(QWheelEvent *event)
         if (mRangeZoomVertAxis.data())
           mRangeZoomVertAxis.data()->scaleRange(factor, mRangeZoomVertAxis.data()->pixelToCoord(event->pos().y()));
       }
-      mParentPlot->replot();
+      mParentPlot->replot(QCustomPlot::rpQueuedReplot);
     }
   }
 }
@@ -14439,149 +15750,1134 @@ QCPData::QCPData(double key, double value) :
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////// QCPGraph
+//////////////////// QCPDataArray
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-/*! \class QCPGraph
-  \brief A plottable representing a graph in a plot.
+/*! \class QCPDataArray
+  \brief Holds the data points of a QCPGraph in sorted, contiguous key and value columns.
 
-  \image html QCPGraph.png
-  
-  Usually QCustomPlot creates graphs internally via QCustomPlot::addGraph and the resulting
-  instance is accessed via QCustomPlot::graph.
+  This is the container a graph uses when its data storage is set to \ref QCP::dsArray (see \ref
+  QCPGraph::setDataStorage). Compared to \ref QCPDataMap, which allocates one tree node per data
+  point, it needs only two doubles per point, lookups by key are binary searches on the key column
+  and iterating the points when drawing touches consecutive memory.
 
-  To plot data, assign it with the \ref setData or \ref addData functions. Alternatively, you can
-  also access and modify the graph's data via the \ref data method, which returns a pointer to the
-  internal \ref QCPDataMap.
-  
-  Graphs are used to display single-valued data. Single-valued means that there should only be one
-  data point per unique key coordinate. In other words, the graph can't have \a loops. If you do
-  want to plot non-single-valued curves, rather use the QCPCurve plottable.
-  
-  \section appearance Changing the appearance
-  
-  The appearance of the graph is mainly determined by the line style, scatter style, brush and pen
-  of the graph (\ref setLineStyle, \ref setScatterStyle, \ref setBrush, \ref setPen).
-  
-  \subsection filling Filling under or between graphs
-  
-  QCPGraph knows two types of fills: Normal graph fills towards the zero-value-line parallel to
-  the key axis of the graph, and fills between two graphs, called channel fills. To enable a fill,
-  just set a brush with \ref setBrush which is neither Qt::NoBrush nor fully transparent.
-  
-  By default, a normal fill towards the zero-value-line will be drawn. To set up a channel fill
-  between this graph and another one, call \ref setChannelFillGraph with the other graph as
-  parameter.
+  Since the keys are kept sorted, loading data that is already sorted by key (which is always the
+  case for sampled functions) only needs a single pass over the input. The columns are implicitly
+  shared QVectors, so in that case \ref set doesn't even copy the passed vectors until either of
+  them is modified. Unsorted input is sorted once, which is still faster than the individual
+  insertions of a map.
 
-  \see QCustomPlot::addGraph, QCustomPlot::graph, QCPLegend::addGraph
-*/
+  The errors of the points (see \ref QCPData) are held in separate columns which only exist if
+  data with key or value errors was set, so points without error bars take two doubles instead of
+  the six of a QCPData. Points added to an array that has error columns get zero errors.
 
-/* start of documentation of inline functions */
+  Data points with a NaN key are dropped, since they have no place in the sorted key column.
 
-/*! \fn QCPDataMap *QCPGraph::data() const
-  
-  Returns a pointer to the internal data storage of type \ref QCPDataMap. You may use it to
-  directly manipulate the data, which may be more convenient and faster than using the regular \ref
-  setData or \ref addData methods, in certain situations.
-*/
+  The \ref const_iterator mirrors the interface of a QCPDataMap::const_iterator (\a key and \a
+  value), so algorithms can be written once for both containers.
 
-/* end of documentation of inline functions */
+  Instead of holding its own columns, the array can also read from key and value buffers that were
+  allocated elsewhere, see \ref adopt. This lets the producer of the data (e.g. an evaluator
+  writing its results, or a memory-mapped file) hand its memory to the graph without any copy.
+
+  Points removed from the front of the columns (\ref removeBefore) aren't moved out immediately,
+  the array just starts reading further back. The dead front is dropped in one go once it's as
+  large as the live data, so removing from the front is amortized constant time per point. With a
+  \ref setCapacity "capacity", this makes the array a ring buffer for live data: appending a point
+  evicts the oldest one in amortized constant time, while the live points stay contiguous and
+  sorted for the binary searches and the drawing.
+
+  For the adaptive sampling of large graphs (see \ref QCPGraph::setAdaptiveSampling) and for the
+  axis rescaling, the array keeps a min/max pyramid of the value column: level 0 holds the value
+  range of every 16 consecutive points (along with their smallest positive and largest negative
+  value, for logarithmic axes), every further level combines two buckets of the level below. With
+  it, \ref valueBounds finds the value range of any index range in logarithmic time, so a replot
+  costs O(pixels log n) instead of touching every visible point, and \ref valueRange doesn't need
+  to scan the data, neither for all points nor for the points within a key range. The pyramid is
+  brought up to date when it's needed: appended points only extend it, other changes rebuild it on
+  the next query.
+*/
 
 /*!
-  Constructs a graph which uses \a keyAxis as its key axis ("x") and \a valueAxis as its value
-  axis ("y"). \a keyAxis and \a valueAxis must reside in the same QCustomPlot instance and not have
-  the same orientation. If either of these restrictions is violated, a corresponding message is
-  printed to the debug output (qDebug), the construction is not aborted, though.
-  
-  The constructed QCPGraph can be added to the plot with QCustomPlot::addPlottable, QCustomPlot
-  then takes ownership of the graph.
-  
-  To directly create a graph inside a plot, you can also use the simpler QCustomPlot::addGraph function.
+  Constructs an empty data array.
 */
-QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
-  QCPAbstractPlottable(keyAxis, valueAxis)
+QCPDataArray::QCPDataArray() :
+  mExternalSize(0),
+  mBegin(0),
+  mCapacity(0),
+  mPyramidPoints(0)
 {
-  mData = new QCPDataMap;
-  
-  setPen(QPen(Qt::blue, 0));
-  setErrorPen(QPen(Qt::black));
-  setBrush(Qt::NoBrush);
-  setSelectedPen(QPen(QColor(80, 80, 255), 2.5));
-  setSelectedBrush(Qt::NoBrush);
-  
-  setLineStyle(lsLine);
-  setErrorType(etNone);
-  setErrorBarSize(6);
-  setErrorBarSkipSymbol(true);
-  setChannelFillGraph(0);
-  setAdaptiveSampling(true);
 }
 
-QCPGraph::~QCPGraph()
+/*!
+  Sets the maximum number of data points the array holds. Whenever adding points exceeds the
+  capacity, the points with the smallest keys are removed, which for streamed data are the oldest.
+  If the array currently holds more than \a capacity points, the surplus is removed right away.
+
+  With a capacity, appending a point and evicting the oldest is amortized constant time and the
+  memory used by the columns stays bounded by twice the capacity. Set \a capacity to 0 (the
+  default) for no limit.
+*/
+void QCPDataArray::setCapacity(int capacity)
 {
-  delete mData;
+  mCapacity = qMax(0, capacity);
+  evict();
 }
 
 /*!
-  Replaces the current data with the provided \a data.
-  
-  If \a copy is set to true, data points in \a data will only be copied. if false, the graph
-  takes ownership of the passed data and replaces the internal data pointer with it. This is
-  significantly faster than copying for large datasets.
-  
-  Alternatively, you can also access and modify the graph's data via the \ref data method, which
-  returns a pointer to the internal \ref QCPDataMap.
+  Returns the data point at \a index, including its errors if the array has error columns.
 */
-void QCPGraph::setData(QCPDataMap *data, bool copy)
+QCPData QCPDataArray::at(int index) const
 {
-  if (mData == data)
+  QCPData data(key(index), value(index));
+  if (hasKeyErrors())
   {
-    qDebug() << Q_FUNC_INFO << "The data pointer is already in (and owned by) this plottable" << reinterpret_cast<quintptr>(data);
-    return;
+    data.keyErrorMinus = mKeyErrorMinus.at(mBegin+index);
+    data.keyErrorPlus = mKeyErrorPlus.at(mBegin+index);
   }
-  if (copy)
+  if (hasValueErrors())
   {
-    *mData = *data;
-  } else
-  {
-    delete mData;
-    mData = data;
+    data.valueErrorMinus = mValueErrorMinus.at(mBegin+index);
+    data.valueErrorPlus = mValueErrorPlus.at(mBegin+index);
   }
+  return data;
 }
 
-/*! \overload
-  
-  Replaces the current data with the provided points in \a key and \a value pairs. The provided
-  vectors should have equal length. Else, the number of added points will be the size of the
-  smallest vector.
+/*!
+  Returns the index of the first data point whose key is not smaller than \a key, or \ref size if
+  there is none.
 */
-void QCPGraph::setData(const QVector<double> &key, const QVector<double> &value)
+int QCPDataArray::lowerBoundIndex(double key) const
 {
-  mData->clear();
-  int n = key.size();
-  n = qMin(n, value.size());
-  QCPData newData;
-  for (int i=0; i<n; ++i)
-  {
-    newData.key = key[i];
-    newData.value = value[i];
-    mData->insertMulti(newData.key, newData);
-  }
+  return std::lower_bound(keys(), keys()+size(), key)-keys();
 }
 
 /*!
-  Replaces the current data with the provided points in \a key and \a value pairs. Additionally the
-  symmetrical value error of the data points are set to the values in \a valueError.
-  For error bars to show appropriately, see \ref setErrorType.
-  The provided vectors should have equal length. Else, the number of added points will be the size of the
-  smallest vector.
-  
-  For asymmetrical errors (plus different from minus), see the overloaded version of this function.
+  Returns the index of the first data point whose key is greater than \a key, or \ref size if
+  there is none.
 */
-void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &valueError)
+int QCPDataArray::upperBoundIndex(double key) const
 {
-  mData->clear();
-  int n = key.size();
+  return std::upper_bound(keys(), keys()+size(), key)-keys();
+}
+
+/*!
+  Returns the range spanned by the keys, restricted to the sign domain \a inSignDomain. Since the
+  keys are sorted, only the ends of the (sign domain of the) key column need to be looked at.
+
+  \a foundRange is set to false if there is no key in the requested sign domain.
+*/
+QCPRange QCPDataArray::keyRange(bool &foundRange, QCPAbstractPlottable::SignDomain inSignDomain) const
+{
+  int first = 0;
+  int last = size()-1;
+  if (inSignDomain == QCPAbstractPlottable::sdNegative)
+    last = lowerBoundIndex(0)-1;
+  else if (inSignDomain == QCPAbstractPlottable::sdPositive)
+    first = upperBoundIndex(0);
+  foundRange = first <= last;
+  if (!foundRange)
+    return QCPRange();
+  return QCPRange(key(first), key(last));
+}
+
+/*!
+  Returns the range spanned by the values, restricted to the sign domain \a inSignDomain. NaN
+  values are ignored.
+
+  \a foundRange is set to false if there is no value in the requested sign domain.
+
+  This reads the min/max pyramid (see the class documentation), so it's only linear in the number
+  of points if the array was modified other than by appending since the last query.
+*/
+QCPRange QCPDataArray::valueRange(bool &foundRange, QCPAbstractPlottable::SignDomain inSignDomain) const
+{
+  double lower, upper;
+  foundRange = valueBounds(0, size(), lower, upper, inSignDomain);
+  if (!foundRange)
+    return QCPRange();
+  return QCPRange(lower, upper);
+}
+
+/*! \overload
+
+  Only takes into account the points with keys inside \a inKeyRange (including its bounds). This
+  is e.g. the value range of the points currently visible on the key axis.
+*/
+QCPRange QCPDataArray::valueRange(bool &foundRange, QCPAbstractPlottable::SignDomain inSignDomain, const QCPRange &inKeyRange) const
+{
+  double lower, upper;
+  foundRange = valueBounds(lowerBoundIndex(inKeyRange.lower), upperBoundIndex(inKeyRange.upper), lower, upper, inSignDomain);
+  if (!foundRange)
+    return QCPRange();
+  return QCPRange(lower, upper);
+}
+
+/*!
+  Sets \a lower and \a upper to the smallest and largest value in the sign domain \a inSignDomain
+  of the points with indices \a from up to (but not including) \a to. NaN values are ignored.
+  Returns false if there is no such value, e.g. if the index range is empty.
+
+  Apart from at most two partial buckets at the ends, which are scanned, this reads the min/max
+  pyramid (see the class documentation), so it takes logarithmic time in the size of the range.
+*/
+bool QCPDataArray::valueBounds(int from, int to, double &lower, double &upper, QCPAbstractPlottable::SignDomain inSignDomain) const
+{
+  double bounds[4] = {std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+                      std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+  const double *data = isExternal() ? mExternalValues.data() : mValues.constData();
+  int first = mBegin+from; // the pyramid covers the whole column, including the dead front
+  int end = mBegin+to;
+  const int bucketSize = 1 << pyramidBaseShift;
+  if (end-first < 2*bucketSize)
+  {
+    for (int i=first; i<end; ++i)
+      foldValue(bounds, data[i]);
+  } else
+  {
+    updatePyramid();
+    // scan the points in front of the first and behind the last full bucket:
+    while (first % bucketSize != 0)
+      foldValue(bounds, data[first++]);
+    while (end % bucketSize != 0)
+      foldValue(bounds, data[--end]);
+    // climb the pyramid, taking the border buckets whose parents would reach beyond the range:
+    int lowBucket = first >> pyramidBaseShift;
+    int highBucket = end >> pyramidBaseShift;
+    for (int level=0; lowBucket < highBucket; ++level)
+    {
+      const double *buckets = mPyramid.at(level).constData();
+      if (lowBucket & 1)
+        foldBounds(bounds, buckets+4*lowBucket++);
+      if (highBucket & 1)
+        foldBounds(bounds, buckets+4*--highBucket);
+      lowBucket >>= 1;
+      highBucket >>= 1;
+    }
+  }
+  switch (inSignDomain)
+  {
+    case QCPAbstractPlottable::sdBoth:     lower = bounds[0]; upper = bounds[1]; break;
+    case QCPAbstractPlottable::sdNegative: lower = bounds[0]; upper = bounds[3]; break;
+    case QCPAbstractPlottable::sdPositive: lower = bounds[2]; upper = bounds[1]; break;
+  }
+  return lower <= upper; // inverted if there was no value in the sign domain
+}
+
+/*!
+  Replaces the data with the points in \a keys and \a values. The provided vectors should have
+  equal length. Else, the number of points will be the size of the smallest vector. The array has
+  no error columns afterwards.
+
+  If \a keys is sorted, this takes linear time at most, and the vectors are shared (not copied) if
+  they have equal length. Otherwise the points are sorted by key first.
+*/
+void QCPDataArray::set(const QVector<double> &keys, const QVector<double> &values)
+{
+  set(keys, values, QVector<double>(), QVector<double>(), QVector<double>(), QVector<double>());
+}
+
+/*! \overload
+
+  Replaces the data with the points in \a keys and \a values, with the errors \a keyErrorMinus,
+  \a keyErrorPlus, \a valueErrorMinus and \a valueErrorPlus. Error vectors that are empty are
+  treated as zero errors. The key (value) error columns are only allocated if one of the key
+  (value) error vectors isn't empty. The number of points is the size of the smallest non-empty
+  vector.
+*/
+void QCPDataArray::set(const QVector<double> &keys, const QVector<double> &values, const QVector<double> &keyErrorMinus, const QVector<double> &keyErrorPlus, const QVector<double> &valueErrorMinus, const QVector<double> &valueErrorPlus)
+{
+  releaseExternal();
+  mBegin = 0;
+  mPyramidPoints = 0;
+  const QVector<double> *errors[4] = {&keyErrorMinus, &keyErrorPlus, &valueErrorMinus, &valueErrorPlus};
+  QVector<double> *errorColumns[4] = {&mKeyErrorMinus, &mKeyErrorPlus, &mValueErrorMinus, &mValueErrorPlus};
+  int n = qMin(keys.size(), values.size());
+  for (int c=0; c<4; ++c)
+  {
+    if (!errors[c]->isEmpty())
+      n = qMin(n, errors[c]->size());
+  }
+  if (isSorted(keys.constData(), n))
+  {
+    mKeys = leading(keys, n);
+    mValues = leading(values, n);
+    for (int c=0; c<4; ++c)
+      *errorColumns[c] = errors[c]->isEmpty() ? QVector<double>() : leading(*errors[c], n);
+  } else
+  {
+    const QVector<int> order = sortedOrder(keys.constData(), n);
+    mKeys = gathered(keys, order);
+    mValues = gathered(values, order);
+    for (int c=0; c<4; ++c)
+      *errorColumns[c] = errors[c]->isEmpty() ? QVector<double>() : gathered(*errors[c], order);
+  }
+  // errors come in pairs, a missing half of a pair is zero:
+  for (int c=0; c<4; c+=2)
+  {
+    if (errorColumns[c]->isEmpty() != errorColumns[c+1]->isEmpty())
+    {
+      errorColumns[c]->resize(size());
+      errorColumns[c+1]->resize(size());
+    }
+  }
+  evict();
+}
+
+/*! \overload
+
+  Replaces the data with the points in \a dataMap. Error columns are only allocated if any of the
+  points has a non-zero key or value error.
+*/
+void QCPDataArray::set(const QCPDataMap &dataMap)
+{
+  clear();
+  reserve(dataMap.size());
+  bool haveKeyErrors = false;
+  bool haveValueErrors = false;
+  QCPDataMap::const_iterator it;
+  for (it = dataMap.constBegin(); it != dataMap.constEnd(); ++it)
+  {
+    if (qIsNaN(it.key()))
+      continue;
+    const QCPData &data = it.value();
+    if (!haveKeyErrors && (data.keyErrorMinus != 0 || data.keyErrorPlus != 0))
+    {
+      // the points before had no key errors:
+      mKeyErrorMinus.resize(mKeys.size());
+      mKeyErrorPlus.resize(mKeys.size());
+      haveKeyErrors = true;
+    }
+    if (!haveValueErrors && (data.valueErrorMinus != 0 || data.valueErrorPlus != 0))
+    {
+      mValueErrorMinus.resize(mKeys.size());
+      mValueErrorPlus.resize(mKeys.size());
+      haveValueErrors = true;
+    }
+    mKeys.append(it.key());
+    mValues.append(data.value);
+    if (haveKeyErrors)
+    {
+      mKeyErrorMinus.append(data.keyErrorMinus);
+      mKeyErrorPlus.append(data.keyErrorPlus);
+    }
+    if (haveValueErrors)
+    {
+      mValueErrorMinus.append(data.valueErrorMinus);
+      mValueErrorPlus.append(data.valueErrorPlus);
+    }
+  }
+  evict();
+}
+
+/*! \typedef QCPDataArray::BufferDeleter
+  
+  The function that releases a buffer passed to \ref adopt, e.g. \ref deleteBuffer for buffers
+  allocated with <tt>new double[n]</tt>.
+*/
+
+/*!
+  Replaces the data with the first \a count points of the external buffers \a keys and \a values,
+  without copying them. The array takes over the ownership of both buffers and releases each of
+  them by calling \a deleter once it doesn't refer to it anymore (copies of the array share the
+  buffers). The default deleter, \ref deleteBuffer, matches buffers allocated with <tt>new
+  double[n]</tt>. Pass a deleter that fits the allocation otherwise (e.g. one that calls \c free or
+  unmaps a file), or \ref keepBuffer if the caller keeps the ownership. In that case the buffers
+  must stay valid as long as the array reads from them, which allows several arrays to read the
+  same buffer, e.g. the key buffer of graphs sampled at the same keys.
+
+  The buffers are only read. Modifying the data through the array (\ref add, \ref remove,...)
+  first copies the points into columns of its own, like an implicitly shared container would. If
+  the caller modifies the buffers while they are adopted, the changes are visible in the array on
+  the next replot, as long as the keys stay sorted. After modifying the values, adopt the buffers
+  again, so the cached value ranges used for the adaptive sampling are rebuilt (see \ref
+  valueBounds).
+
+  The buffers can only be adopted as they are if the keys are sorted and contain no NaN. Otherwise
+  the points are copied and sorted like in \ref set, and the buffers are released right away.
+  In either case, the array has no error columns afterwards. If \a count exceeds the capacity (see
+  \ref setCapacity), the points are copied as well, to evict the surplus.
+*/
+void QCPDataArray::adopt(double *keys, double *values, int count, BufferDeleter deleter)
+{
+  if (!deleter)
+    deleter = keepBuffer;
+  // own the buffers from here on, so they are released on every path:
+  QSharedPointer<double> keyBuffer(keys, deleter);
+  QSharedPointer<double> valueBuffer(values, deleter);
+  if (!keys || !values || count <= 0)
+  {
+    clear();
+    return;
+  }
+  if (isSorted(keys, count))
+  {
+    clear();
+    mExternalKeys = keyBuffer;
+    mExternalValues = valueBuffer;
+    mExternalSize = count;
+  } else
+  {
+    QVector<double> keyVector(count);
+    QVector<double> valueVector(count);
+    std::copy(keys, keys+count, keyVector.begin());
+    std::copy(values, values+count, valueVector.begin());
+    set(keyVector, valueVector);
+  }
+  evict();
+}
+
+/*!
+  Releases \a buffer with <tt>delete[]</tt>. This is the default deleter of \ref adopt, for buffers
+  allocated with <tt>new double[n]</tt>.
+*/
+void QCPDataArray::deleteBuffer(double *buffer)
+{
+  delete[] buffer;
+}
+
+/*!
+  Does nothing. Passed to \ref adopt as deleter, the caller keeps the ownership of the buffers.
+*/
+void QCPDataArray::keepBuffer(double *buffer)
+{
+  Q_UNUSED(buffer)
+}
+
+/*!
+  Adds the points in \a keys and \a values to the data. The provided vectors should have equal
+  length. Else, the number of added points will be the size of the smallest vector.
+
+  If the new keys are sorted and don't start below the current last key (e.g. when data is
+  streamed in), they are simply appended. Otherwise the new points are merged into the columns in
+  linear time, after sorting them if necessary.
+*/
+void QCPDataArray::add(const QVector<double> &keys, const QVector<double> &values)
+{
+  const int n = qMin(keys.size(), values.size());
+  if (n == 0)
+    return;
+  detach();
+  const bool sorted = isSorted(keys.constData(), n);
+  const QVector<int> order = sorted ? QVector<int>() : sortedOrder(keys.constData(), n);
+  const int count = sorted ? n : order.size();
+  if (count == 0)
+    return;
+  const double firstKey = keys.at(sorted ? 0 : order.at(0));
+  if (isEmpty() || firstKey >= key(size()-1))
+  {
+    reserve(size()+count);
+    for (int i=0; i<count; ++i)
+    {
+      const int j = sorted ? i : order.at(i);
+      mKeys.append(keys.at(j));
+      mValues.append(values.at(j));
+    }
+    resizeErrors();
+    evict();
+    return;
+  }
+  // merge the sorted new points into the existing columns:
+  const bool hasErrors = hasKeyErrors() || hasValueErrors();
+  QVector<int> origin; // index of the old point at each merged position, -1 for new points
+  if (hasErrors)
+    origin.resize(size()+count);
+  QVector<double> mergedKeys(size()+count);
+  QVector<double> mergedValues(size()+count);
+  double *keyData = mergedKeys.data();
+  double *valueData = mergedValues.data();
+  int a = 0, b = 0, k = 0;
+  while (a < size() || b < count)
+  {
+    const int j = b < count ? (sorted ? b : order.at(b)) : -1;
+    if (j < 0 || (a < size() && key(a) <= keys.at(j)))
+    {
+      keyData[k] = key(a);
+      valueData[k] = value(a);
+      if (hasErrors)
+        origin[k] = a;
+      ++a;
+    } else
+    {
+      keyData[k] = keys.at(j);
+      valueData[k] = values.at(j);
+      if (hasErrors)
+        origin[k] = -1;
+      ++b;
+    }
+    ++k;
+  }
+  if (hasErrors)
+  {
+    QVector<double> *errorColumns[4] = {&mKeyErrorMinus, &mKeyErrorPlus, &mValueErrorMinus, &mValueErrorPlus};
+    for (int c=0; c<4; ++c)
+    {
+      if (errorColumns[c]->isEmpty())
+        continue;
+      QVector<double> merged(origin.size());
+      for (int i=0; i<origin.size(); ++i)
+        merged[i] = origin.at(i) < 0 ? 0 : errorColumns[c]->at(mBegin+origin.at(i));
+      *errorColumns[c] = merged;
+    }
+  }
+  mKeys = mergedKeys;
+  mValues = mergedValues;
+  mBegin = 0;
+  mPyramidPoints = 0;
+  evict();
+}
+
+/*! \overload
+
+  Adds a single point with the specified \a key and \a value. Appending at the end is amortized
+  constant time (also when the \ref setCapacity "capacity" is reached and the oldest point is
+  evicted), inserting in between has to move the points behind it.
+*/
+void QCPDataArray::add(double key, double value)
+{
+  if (qIsNaN(key))
+    return;
+  detach();
+  if (isEmpty() || key >= this->key(size()-1))
+  {
+    mKeys.append(key);
+    mValues.append(value);
+    resizeErrors();
+  } else
+  {
+    const int index = mBegin+lowerBoundIndex(key);
+    mKeys.insert(index, key);
+    mValues.insert(index, value);
+    mPyramidPoints = qMin(mPyramidPoints, index);
+    QVector<double> *errorColumns[4] = {&mKeyErrorMinus, &mKeyErrorPlus, &mValueErrorMinus, &mValueErrorPlus};
+    for (int c=0; c<4; ++c)
+    {
+      if (!errorColumns[c]->isEmpty())
+        errorColumns[c]->insert(index, 0);
+    }
+  }
+  evict();
+}
+
+/*!
+  Removes all data points with keys smaller than \a key. This is amortized constant time per
+  removed point, see the class documentation.
+*/
+void QCPDataArray::removeBefore(double key)
+{
+  const int count = lowerBoundIndex(key);
+  if (count == 0)
+    return;
+  detach();
+  removePoints(0, count);
+}
+
+/*!
+  Removes all data points with keys greater than \a key.
+*/
+void QCPDataArray::removeAfter(double key)
+{
+  const int first = upperBoundIndex(key);
+  if (isExternal()) // the points behind are simply not read anymore
+  {
+    mExternalSize = first;
+    mPyramidPoints = qMin(mPyramidPoints, first);
+    if (first == 0)
+      releaseExternal();
+    return;
+  }
+  removePoints(first, size()-first);
+}
+
+/*!
+  Removes all data points with keys greater than \a fromKey and smaller or equal to \a toKey, like
+  QCPGraph::removeData does on a \ref QCPDataMap. If \a fromKey is greater or equal to \a toKey,
+  the function does nothing.
+*/
+void QCPDataArray::remove(double fromKey, double toKey)
+{
+  if (fromKey >= toKey || isEmpty())
+    return;
+  const int first = upperBoundIndex(fromKey);
+  const int end = upperBoundIndex(toKey);
+  if (first == end)
+    return;
+  detach();
+  removePoints(first, end-first);
+}
+
+/*! \overload
+
+  Removes all data points with a key equal to \a key.
+*/
+void QCPDataArray::remove(double key)
+{
+  const int first = lowerBoundIndex(key);
+  const int end = upperBoundIndex(key);
+  if (first == end)
+    return;
+  detach();
+  removePoints(first, end-first);
+}
+
+/*!
+  Removes all data points.
+*/
+void QCPDataArray::clear()
+{
+  releaseExternal();
+  mKeys.clear();
+  mValues.clear();
+  mKeyErrorMinus.clear();
+  mKeyErrorPlus.clear();
+  mValueErrorMinus.clear();
+  mValueErrorPlus.clear();
+  mBegin = 0;
+  mPyramidPoints = 0;
+}
+
+/*!
+  Reserves memory for at least \a size data points, so adding points one by one up to that size
+  doesn't reallocate the columns.
+*/
+void QCPDataArray::reserve(int size)
+{
+  detach();
+  mKeys.reserve(mBegin+size);
+  mValues.reserve(mBegin+size);
+}
+
+/*!
+  Releases memory that isn't needed to hold the current data points, e.g. after removing many
+  points.
+*/
+void QCPDataArray::squeeze()
+{
+  compact();
+  mKeys.squeeze();
+  mValues.squeeze();
+  mKeyErrorMinus.squeeze();
+  mKeyErrorPlus.squeeze();
+  mValueErrorMinus.squeeze();
+  mValueErrorPlus.squeeze();
+}
+
+/*! \internal
+
+  Removes \a count points starting at index \a first from all columns. Points at the front are
+  only skipped by advancing \ref mBegin, see \ref compact.
+*/
+void QCPDataArray::removePoints(int first, int count)
+{
+  if (first == 0)
+  {
+    mBegin += count;
+    if (mBegin >= size()) // the dead front is at least as large as the live data
+      compact();
+    return;
+  }
+  first += mBegin;
+  mPyramidPoints = qMin(mPyramidPoints, first); // the buckets before the removed points stay valid
+  QVector<double> *columns[6] = {&mKeys, &mValues, &mKeyErrorMinus, &mKeyErrorPlus, &mValueErrorMinus, &mValueErrorPlus};
+  for (int c=0; c<6; ++c)
+  {
+    if (first+count == columns[c]->size())
+      columns[c]->resize(first);
+    else if (!columns[c]->isEmpty())
+      columns[c]->remove(first, count);
+  }
+}
+
+/*! \internal
+
+  Moves the live points to the front of the columns, dropping the \ref mBegin points that were
+  removed from the front before. The columns keep their allocated memory, so a ring buffer doesn't
+  allocate once it has reached its capacity.
+*/
+void QCPDataArray::compact()
+{
+  if (mBegin == 0)
+    return;
+  QVector<double> *columns[6] = {&mKeys, &mValues, &mKeyErrorMinus, &mKeyErrorPlus, &mValueErrorMinus, &mValueErrorPlus};
+  for (int c=0; c<6; ++c)
+  {
+    if (columns[c]->isEmpty())
+      continue;
+    std::copy(columns[c]->begin()+mBegin, columns[c]->end(), columns[c]->begin());
+    columns[c]->resize(columns[c]->size()-mBegin);
+  }
+  mBegin = 0;
+  mPyramidPoints = 0;
+}
+
+/*! \internal
+
+  Brings the min/max pyramid (see \ref valueBounds) up to date with the value column. Only the
+  buckets from the first changed point onwards are recalculated, so after appending points this
+  takes time proportional to the number of new points.
+*/
+void QCPDataArray::updatePyramid() const
+{
+  const int n = isExternal() ? mExternalSize : mValues.size();
+  if (mPyramidPoints == n && !mPyramid.isEmpty())
+    return;
+  const double *data = isExternal() ? mExternalValues.data() : mValues.constData();
+  const int bucketSize = 1 << pyramidBaseShift;
+  int firstBucket = mPyramidPoints >> pyramidBaseShift;
+  int bucketCount = (n+bucketSize-1) >> pyramidBaseShift;
+  int level = 0;
+  while (true)
+  {
+    if (mPyramid.size() <= level)
+      mPyramid.resize(level+1);
+    mPyramid[level].resize(4*bucketCount);
+    double *buckets = mPyramid[level].data();
+    const double *children = level > 0 ? mPyramid.at(level-1).constData() : 0;
+    const int childCount = level > 0 ? mPyramid.at(level-1).size()/4 : 0;
+    for (int b=firstBucket; b<bucketCount; ++b)
+    {
+      double *bounds = buckets+4*b;
+      bounds[0] = bounds[2] = std::numeric_limits<double>::infinity(); // empty and all-NaN buckets stay inverted
+      bounds[1] = bounds[3] = -std::numeric_limits<double>::infinity();
+      if (level == 0)
+      {
+        const int end = qMin(n, (b+1)*bucketSize);
+        for (int i=b*bucketSize; i<end; ++i)
+          foldValue(bounds, data[i]);
+      } else
+      {
+        const int childEnd = qMin(childCount, 2*b+2);
+        for (int c=2*b; c<childEnd; ++c)
+          foldBounds(bounds, children+4*c);
+      }
+    }
+    if (bucketCount <= 1)
+      break;
+    firstBucket >>= 1;
+    bucketCount = (bucketCount+1) >> 1;
+    ++level;
+  }
+  mPyramid.resize(level+1);
+  mPyramidPoints = n;
+}
+
+/*! \internal
+
+  Extends the value bounds \a bounds by \a value. The bounds are the smallest value, the largest
+  value, the smallest positive value and the largest negative value, so they answer \ref
+  valueBounds for every sign domain. NaN values don't change them.
+*/
+void QCPDataArray::foldValue(double *bounds, double value)
+{
+  if (value < bounds[0])
+    bounds[0] = value;
+  if (value > bounds[1])
+    bounds[1] = value;
+  if (value > 0 && value < bounds[2])
+    bounds[2] = value;
+  if (value < 0 && value > bounds[3])
+    bounds[3] = value;
+}
+
+/*! \internal
+
+  Extends the value bounds \a bounds (see \ref foldValue) by the value bounds \a other.
+*/
+void QCPDataArray::foldBounds(double *bounds, const double *other)
+{
+  bounds[0] = qMin(bounds[0], other[0]);
+  bounds[1] = qMax(bounds[1], other[1]);
+  bounds[2] = qMin(bounds[2], other[2]);
+  bounds[3] = qMax(bounds[3], other[3]);
+}
+
+/*! \internal
+
+  Removes the points with the smallest keys until the array holds no more than the capacity (see
+  \ref setCapacity).
+*/
+void QCPDataArray::evict()
+{
+  if (mCapacity > 0 && size() > mCapacity)
+  {
+    detach();
+    removePoints(0, size()-mCapacity);
+  }
+}
+
+/*! \internal
+
+  Brings the existing error columns to the size of the key column, points appended without errors
+  get zero errors.
+*/
+void QCPDataArray::resizeErrors()
+{
+  QVector<double> *errorColumns[4] = {&mKeyErrorMinus, &mKeyErrorPlus, &mValueErrorMinus, &mValueErrorPlus};
+  for (int c=0; c<4; ++c)
+  {
+    if (!errorColumns[c]->isEmpty())
+      errorColumns[c]->resize(mKeys.size());
+  }
+}
+
+/*! \internal
+
+  If the array reads from adopted external buffers, copies their points into columns of its own
+  and releases the buffers, so the data can be modified. Otherwise does nothing.
+*/
+void QCPDataArray::detach()
+{
+  if (!isExternal())
+    return;
+  mBegin = 0;
+  mKeys.resize(mExternalSize);
+  mValues.resize(mExternalSize);
+  std::copy(mExternalKeys.data(), mExternalKeys.data()+mExternalSize, mKeys.begin());
+  std::copy(mExternalValues.data(), mExternalValues.data()+mExternalSize, mValues.begin());
+  releaseExternal();
+}
+
+/*! \internal
+
+  Drops the references to adopted external buffers, without copying their points.
+*/
+void QCPDataArray::releaseExternal()
+{
+  mExternalKeys.clear();
+  mExternalValues.clear();
+  mExternalSize = 0;
+}
+
+/*! \internal
+
+  Returns the first \a count entries of \a column, sharing the vector if it has no more entries.
+*/
+QVector<double> QCPDataArray::leading(const QVector<double> &column, int count)
+{
+  return column.size() == count ? column : column.mid(0, count);
+}
+
+/*! \internal
+
+  Returns the entries of \a column at the indices in \a order.
+*/
+QVector<double> QCPDataArray::gathered(const QVector<double> &column, const QVector<int> &order)
+{
+  QVector<double> result(order.size());
+  double *data = result.data();
+  for (int i=0; i<order.size(); ++i)
+    data[i] = column.at(order.at(i));
+  return result;
+}
+
+/*! \internal
+
+  Returns whether the first \a count entries of \a keys are sorted ascendingly and contain no NaN.
+*/
+bool QCPDataArray::isSorted(const double *keys, int count)
+{
+  for (int i=0; i<count; ++i)
+  {
+    if (qIsNaN(keys[i]) || (i > 0 && keys[i] < keys[i-1]))
+      return false;
+  }
+  return true;
+}
+
+/*! \internal
+
+  Returns the indices of the first \a count entries of \a keys in ascending key order. Entries
+  with equal keys keep their relative order, entries with NaN keys are left out.
+*/
+QVector<int> QCPDataArray::sortedOrder(const double *keys, int count)
+{
+  QVector<QPair<double, int> > pairs; // the index breaks ties, so equal keys keep their order
+  pairs.reserve(count);
+  for (int i=0; i<count; ++i)
+  {
+    if (!qIsNaN(keys[i]))
+      pairs.append(qMakePair(keys[i], i));
+  }
+  std::sort(pairs.begin(), pairs.end());
+  QVector<int> order(pairs.size());
+  for (int i=0; i<pairs.size(); ++i)
+    order[i] = pairs.at(i).second;
+  return order;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPGraph
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPGraph
+  \brief A plottable representing a graph in a plot.
+
+  \image html QCPGraph.png
+  
+  Usually QCustomPlot creates graphs internally via QCustomPlot::addGraph and the resulting
+  instance is accessed via QCustomPlot::graph.
+
+  To plot data, assign it with the \ref setData or \ref addData functions. Alternatively, you can
+  also access and modify the graph's data via the \ref data method, which returns a pointer to the
+  internal \ref QCPDataMap.
+  
+  For large data sets, consider switching the graph to the array storage with \ref
+  setDataStorage(QCP::dsArray). The points are then held in the sorted columns of a \ref
+  QCPDataArray (see \ref dataArray) instead of the map, which takes a fraction of the memory and
+  makes \ref setData with sorted keys and replots considerably faster.
+  
+  For live data that is appended continuously, \ref setDataCapacity turns the array storage into a
+  ring buffer: appending with \ref addData is amortized constant time and evicts the oldest points
+  once the capacity is reached, so the memory stays flat no matter how long the data streams in.
+  
+  Graphs are used to display single-valued data. Single-valued means that there should only be one
+  data point per unique key coordinate. In other words, the graph can't have \a loops. If you do
+  want to plot non-single-valued curves, rather use the QCPCurve plottable.
+  
+  \section appearance Changing the appearance
+  
+  The appearance of the graph is mainly determined by the line style, scatter style, brush and pen
+  of the graph (\ref setLineStyle, \ref setScatterStyle, \ref setBrush, \ref setPen).
+  
+  \subsection filling Filling under or between graphs
+  
+  QCPGraph knows two types of fills: Normal graph fills towards the zero-value-line parallel to
+  the key axis of the graph, and fills between two graphs, called channel fills. To enable a fill,
+  just set a brush with \ref setBrush which is neither Qt::NoBrush nor fully transparent.
+  
+  By default, a normal fill towards the zero-value-line will be drawn. To set up a channel fill
+  between this graph and another one, call \ref setChannelFillGraph with the other graph as
+  parameter.
+
+  \see QCustomPlot::addGraph, QCustomPlot::graph, QCPLegend::addGraph
+*/
+
+/* start of documentation of inline functions */
+
+/*! \fn QCPDataMap *QCPGraph::data() const
+  
+  Returns a pointer to the internal data storage of type \ref QCPDataMap. You may use it to
+  directly manipulate the data, which may be more convenient and faster than using the regular \ref
+  setData or \ref addData methods, in certain situations.
+  
+  The map is only used if the data storage is \ref QCP::dsMap (the default), see \ref
+  setDataStorage. Otherwise it is empty, and the data is accessible via \ref dataArray.
+*/
+
+/*! \fn QCPDataArray *QCPGraph::dataArray() const
+  
+  Returns a pointer to the internal data storage of type \ref QCPDataArray. It is only used if the
+  data storage is \ref QCP::dsArray, see \ref setDataStorage.
+*/
+
+/*! \fn int QCPGraph::dataCount() const
+  
+  Returns the number of data points of the graph, regardless of the data storage in use.
+*/
+
+/*! \fn int QCPGraph::dataCapacity() const
+  
+  Returns the maximum number of data points the graph holds, or 0 if there is no limit.
+  
+  \see setDataCapacity
+*/
+
+/* end of documentation of inline functions */
+
+/*!
+  Constructs a graph which uses \a keyAxis as its key axis ("x") and \a valueAxis as its value
+  axis ("y"). \a keyAxis and \a valueAxis must reside in the same QCustomPlot instance and not have
+  the same orientation. If either of these restrictions is violated, a corresponding message is
+  printed to the debug output (qDebug), the construction is not aborted, though.
+  
+  The constructed QCPGraph can be added to the plot with QCustomPlot::addPlottable, QCustomPlot
+  then takes ownership of the graph.
+  
+  To directly create a graph inside a plot, you can also use the simpler QCustomPlot::addGraph function.
+*/
+QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+  QCPAbstractPlottable(keyAxis, valueAxis),
+  mDataStorage(QCP::dsMap)
+{
+  mData = new QCPDataMap;
+  mDataArray = new QCPDataArray;
+  
+  setPen(QPen(Qt::blue, 0));
+  setErrorPen(QPen(Qt::black));
+  setBrush(Qt::NoBrush);
+  setSelectedPen(QPen(QColor(80, 80, 255), 2.5));
+  setSelectedBrush(Qt::NoBrush);
+  
+  setLineStyle(lsLine);
+  setErrorType(etNone);
+  setErrorBarSize(6);
+  setErrorBarSkipSymbol(true);
+  setChannelFillGraph(0);
+  setAdaptiveSampling(true);
+  
+  mHitFirstColumn = 0;
+  mHitHorizontal = true;
+  mHitLineStyle = mLineStyle;
+  mDataPrepared = false;
+}
+
+QCPGraph::~QCPGraph()
+{
+  delete mData;
+  delete mDataArray;
+}
+
+/*!
+  Sets the container in which the graph holds its data points. The current data points are moved
+  to the new container.
+  
+  With \ref QCP::dsMap (the default), the data is held in the \ref QCPDataMap returned by \ref
+  data. With \ref QCP::dsArray, it is held in the sorted columns of the \ref QCPDataArray returned
+  by \ref dataArray, which is much faster to fill and draw for large data sets. The array storage
+  only allocates columns for the errors once data with errors is set (e.g. with \ref
+  setDataValueError), so a graph without error bars needs two doubles per point instead of six.
+*/
+void QCPGraph::setDataStorage(QCP::DataStorage storage)
+{
+  if (mDataStorage == storage)
+    return;
+  if (storage == QCP::dsArray)
+  {
+    mDataArray->set(*mData);
+    mData->clear();
+  } else
+  {
+    mData->clear();
+    for (int i=0; i<mDataArray->size(); ++i)
+      mData->insertMulti(mDataArray->key(i), mDataArray->at(i));
+    mDataArray->clear();
+  }
+  mDataStorage = storage;
+}
+
+/*!
+  Limits the number of data points the graph holds to \a capacity, which makes the graph a ring
+  buffer for live data: once the capacity is reached, adding points (e.g. with \ref addData)
+  removes the points with the smallest keys, which are the oldest when the keys are timestamps.
+  Appending a point is then amortized constant time and doesn't allocate, and the visible range is
+  still found with binary searches. Set \a capacity to 0 (the default) for no limit.
+  
+  The capacity is a feature of the array storage, so setting a non-zero capacity switches the data
+  storage to \ref QCP::dsArray (see \ref setDataStorage). See \ref QCPDataArray::setCapacity for
+  the details.
+*/
+void QCPGraph::setDataCapacity(int capacity)
+{
+  if (capacity > 0)
+    setDataStorage(QCP::dsArray);
+  mDataArray->setCapacity(capacity);
+}
+
+/*!
+  Replaces the current data with the provided \a data.
+  
+  If \a copy is set to true, data points in \a data will only be copied. if false, the graph
+  takes ownership of the passed data and replaces the internal data pointer with it. This is
+  significantly faster than copying for large datasets.
+  
+  If the data storage is \ref QCP::dsArray, the keys and values of \a data are loaded into the
+  data array. If \a copy is false, the graph still takes ownership of \a data and deletes it.
+  
+  Alternatively, you can also access and modify the graph's data via the \ref data method, which
+  returns a pointer to the internal \ref QCPDataMap.
+*/
+void QCPGraph::setData(QCPDataMap *data, bool copy)
+{
+  if (mData == data)
+  {
+    qDebug() << Q_FUNC_INFO << "The data pointer is already in (and owned by) this plottable" << reinterpret_cast<quintptr>(data);
+    return;
+  }
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->set(*data);
+    if (!copy)
+      delete data;
+    return;
+  }
+  if (copy)
+  {
+    *mData = *data;
+  } else
+  {
+    delete mData;
+    mData = data;
+  }
+}
+
+/*! \overload
+  
+  Replaces the current data with the provided points in \a key and \a value pairs. The provided
+  vectors should have equal length. Else, the number of added points will be the size of the
+  smallest vector.
+  
+  If the data storage is \ref QCP::dsArray and \a key is sorted, this takes linear time at most
+  (see \ref QCPDataArray::set).
+*/
+void QCPGraph::setData(const QVector<double> &key, const QVector<double> &value)
+{
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->set(key, value);
+    return;
+  }
+  mData->clear();
+  int n = key.size();
+  n = qMin(n, value.size());
+  QCPData newData;
+  for (int i=0; i<n; ++i)
+  {
+    newData.key = key[i];
+    newData.value = value[i];
+    mData->insertMulti(newData.key, newData);
+  }
+}
+
+/*! \overload
+  
+  Replaces the current data with the first \a count points of the externally allocated buffers \a
+  key and \a value, and switches the data storage to \ref QCP::dsArray.
+  
+  The graph takes over the ownership of the buffers and releases them with \a deleter, which by
+  default calls <tt>delete[]</tt>, matching buffers allocated with <tt>new double[n]</tt>. If \a
+  key is sorted, the graph draws directly from the buffers instead of copying them. This way,
+  whatever produces the data can write it straight into the memory the graph is drawn from. See
+  \ref QCPDataArray::adopt for the details and the other deleters.
+*/
+void QCPGraph::setData(double *key, double *value, int count, QCPDataArray::BufferDeleter deleter)
+{
+  if (mDataStorage != QCP::dsArray)
+  {
+    mData->clear();
+    mDataStorage = QCP::dsArray;
+  }
+  mDataArray->adopt(key, value, count, deleter);
+}
+
+/*!
+  Replaces the current data with the provided points in \a key and \a value pairs. Additionally the
+  symmetrical value error of the data points are set to the values in \a valueError.
+  For error bars to show appropriately, see \ref setErrorType.
+  The provided vectors should have equal length. Else, the number of added points will be the size of the
+  smallest vector.
+  
+  For asymmetrical errors (plus different from minus), see the overloaded version of this function.
+*/
+void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &valueError)
+{
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->set(key, value, QVector<double>(), QVector<double>(), valueError, valueError);
+    return;
+  }
+  mData->clear();
+  int n = key.size();
   n = qMin(n, value.size());
   n = qMin(n, valueError.size());
   QCPData newData;
@@ -14606,6 +16902,11 @@ void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<doubl
 */
 void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &valueErrorMinus, const QVector<double> &valueErrorPlus)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->set(key, value, QVector<double>(), QVector<double>(), valueErrorMinus, valueErrorPlus);
+    return;
+  }
   mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
@@ -14633,6 +16934,11 @@ void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<doubl
 */
 void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyError)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->set(key, value, keyError, keyError, QVector<double>(), QVector<double>());
+    return;
+  }
   mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
@@ -14659,6 +16965,11 @@ void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double>
 */
 void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyErrorMinus, const QVector<double> &keyErrorPlus)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->set(key, value, keyErrorMinus, keyErrorPlus, QVector<double>(), QVector<double>());
+    return;
+  }
   mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
@@ -14686,6 +16997,11 @@ void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double>
 */
 void QCPGraph::setDataBothError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyError, const QVector<double> &valueError)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->set(key, value, keyError, keyError, valueError, valueError);
+    return;
+  }
   mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
@@ -14715,6 +17031,11 @@ void QCPGraph::setDataBothError(const QVector<double> &key, const QVector<double
 */
 void QCPGraph::setDataBothError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyErrorMinus, const QVector<double> &keyErrorPlus, const QVector<double> &valueErrorMinus, const QVector<double> &valueErrorPlus)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->set(key, value, keyErrorMinus, keyErrorPlus, valueErrorMinus, valueErrorPlus);
+    return;
+  }
   mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
@@ -14863,6 +17184,11 @@ void QCPGraph::setChannelFillGraph(QCPGraph *targetGraph)
   sampling off. For example, when saving the plot to disk. This can be achieved by setting \a
   enabled to false before issuing a command like \ref QCustomPlot::savePng, and setting \a enabled
   back to true afterwards.
+  
+  With the \ref QCP::dsArray data storage (see \ref setDataStorage), the adaptive sampling of line
+  plots doesn't even visit every visible point. It reads the value range of each pixel from a
+  min/max pyramid that the data array keeps, so the replot time grows with the number of pixels and
+  only logarithmically with the number of points.
 */
 void QCPGraph::setAdaptiveSampling(bool enabled)
 {
@@ -14879,6 +17205,20 @@ void QCPGraph::setAdaptiveSampling(bool enabled)
 */
 void QCPGraph::addData(const QCPDataMap &dataMap)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    QVector<double> keys, values;
+    keys.reserve(dataMap.size());
+    values.reserve(dataMap.size());
+    QCPDataMap::const_iterator it;
+    for (it = dataMap.constBegin(); it != dataMap.constEnd(); ++it)
+    {
+      keys.append(it.key());
+      values.append(it.value().value);
+    }
+    mDataArray->add(keys, values);
+    return;
+  }
   mData->unite(dataMap);
 }
 
@@ -14892,7 +17232,10 @@ void QCPGraph::addData(const QCPDataMap &dataMap)
 */
 void QCPGraph::addData(const QCPData &data)
 {
-  mData->insertMulti(data.key, data);
+  if (mDataStorage == QCP::dsArray)
+    mDataArray->add(data.key, data.value);
+  else
+    mData->insertMulti(data.key, data);
 }
 
 /*! \overload
@@ -14905,6 +17248,11 @@ void QCPGraph::addData(const QCPData &data)
 */
 void QCPGraph::addData(double key, double value)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->add(key, value);
+    return;
+  }
   QCPData newData;
   newData.key = key;
   newData.value = value;
@@ -14921,6 +17269,11 @@ void QCPGraph::addData(double key, double value)
 */
 void QCPGraph::addData(const QVector<double> &keys, const QVector<double> &values)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->add(keys, values);
+    return;
+  }
   int n = qMin(keys.size(), values.size());
   QCPData newData;
   for (int i=0; i<n; ++i)
@@ -14937,6 +17290,11 @@ void QCPGraph::addData(const QVector<double> &keys, const QVector<double> &value
 */
 void QCPGraph::removeDataBefore(double key)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->removeBefore(key);
+    return;
+  }
   QCPDataMap::iterator it = mData->begin();
   while (it != mData->end() && it.key() < key)
     it = mData->erase(it);
@@ -14948,6 +17306,11 @@ void QCPGraph::removeDataBefore(double key)
 */
 void QCPGraph::removeDataAfter(double key)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->removeAfter(key);
+    return;
+  }
   if (mData->isEmpty()) return;
   QCPDataMap::iterator it = mData->upperBound(key);
   while (it != mData->end())
@@ -14963,6 +17326,11 @@ void QCPGraph::removeDataAfter(double key)
 */
 void QCPGraph::removeData(double fromKey, double toKey)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->remove(fromKey, toKey);
+    return;
+  }
   if (fromKey >= toKey || mData->isEmpty()) return;
   QCPDataMap::iterator it = mData->upperBound(fromKey);
   QCPDataMap::iterator itEnd = mData->upperBound(toKey);
@@ -14980,7 +17348,10 @@ void QCPGraph::removeData(double fromKey, double toKey)
 */
 void QCPGraph::removeData(double key)
 {
-  mData->remove(key);
+  if (mDataStorage == QCP::dsArray)
+    mDataArray->remove(key);
+  else
+    mData->remove(key);
 }
 
 /*!
@@ -14990,13 +17361,14 @@ void QCPGraph::removeData(double key)
 void QCPGraph::clearData()
 {
   mData->clear();
+  mDataArray->clear();
 }
 
 /* inherits documentation from base class */
 double QCPGraph::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const
 {
   Q_UNUSED(details)
-  if ((onlySelectable && !mSelectable) || mData->isEmpty())
+  if ((onlySelectable && !mSelectable) || dataCount() == 0)
     return -1;
   if (!mKeyAxis || !mValueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return -1; }
   
@@ -15030,7 +17402,7 @@ void QCPGraph::rescaleKeyAxis(bool onlyEnlarge, bool includeErrorBars) const
 {
   // this code is a copy of QCPAbstractPlottable::rescaleKeyAxis with the only change
   // that getKeyRange is passed the includeErrorBars value.
-  if (mData->isEmpty()) return;
+  if (dataCount() == 0) return;
   
   QCPAxis *keyAxis = mKeyAxis.data();
   if (!keyAxis) { qDebug() << Q_FUNC_INFO << "invalid key axis"; return; }
@@ -15060,13 +17432,18 @@ void QCPGraph::rescaleKeyAxis(bool onlyEnlarge, bool includeErrorBars) const
   Allows to define whether error bars (of kind \ref QCPGraph::etValue) are taken into consideration
   when determining the new axis range.
   
+  If \a inKeyRange is true, only the data points inside the current range of the key axis are
+  taken into account. This fits the value axis to the visible part of the graph, e.g. after the
+  user dragged or zoomed the key axis. With the \ref QCP::dsArray data storage, the value range
+  is found in logarithmic time, see \ref QCPDataArray::valueRange.
+  
   \see rescaleAxes, QCPAbstractPlottable::rescaleValueAxis
 */
-void QCPGraph::rescaleValueAxis(bool onlyEnlarge, bool includeErrorBars) const
+void QCPGraph::rescaleValueAxis(bool onlyEnlarge, bool includeErrorBars, bool inKeyRange) const
 {
   // this code is a copy of QCPAbstractPlottable::rescaleValueAxis with the only change
-  // is that getValueRange is passed the includeErrorBars value.
-  if (mData->isEmpty()) return;
+  // is that getValueRange is passed the includeErrorBars value and possibly the key range.
+  if (dataCount() == 0) return;
   
   QCPAxis *valueAxis = mValueAxis.data();
   if (!valueAxis) { qDebug() << Q_FUNC_INFO << "invalid value axis"; return; }
@@ -15076,7 +17453,11 @@ void QCPGraph::rescaleValueAxis(bool onlyEnlarge, bool includeErrorBars) const
     signDomain = (valueAxis->range().upper < 0 ? sdNegative : sdPositive);
   
   bool foundRange;
-  QCPRange newRange = getValueRange(foundRange, signDomain, includeErrorBars);
+  QCPRange newRange;
+  if (inKeyRange && mKeyAxis)
+    newRange = getValueRange(foundRange, signDomain, includeErrorBars, mKeyAxis.data()->range());
+  else
+    newRange = getValueRange(foundRange, signDomain, includeErrorBars);
   
   if (foundRange)
   {
@@ -15094,8 +17475,9 @@ void QCPGraph::rescaleValueAxis(bool onlyEnlarge, bool includeErrorBars) const
 /* inherits documentation from base class */
 void QCPGraph::draw(QCPPainter *painter)
 {
+  mHitColumnStart.clear(); // the hit index of the last replot doesn't match what's drawn now
   if (!mKeyAxis || !mValueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
-  if (mKeyAxis.data()->range().size() <= 0 || mData->isEmpty()) return;
+  if (mKeyAxis.data()->range().size() <= 0 || dataCount() == 0) return;
   if (mLineStyle == lsNone && mScatterStyle.isNone()) return;
   
   // allocate line and (if necessary) point vectors:
@@ -15104,8 +17486,16 @@ void QCPGraph::draw(QCPPainter *painter)
   if (!mScatterStyle.isNone())
     scatterData = new QVector<QCPData>;
   
-  // fill vectors with data appropriate to plot style:
-  getPlotData(lineData, scatterData);
+  // fill vectors with data appropriate to plot style, unless prepareDraw already did:
+  if (mDataPrepared)
+  {
+    lineData->swap(mPreparedLineData);
+    if (scatterData)
+      scatterData->swap(mPreparedScatterData);
+    mPreparedScatterData.clear();
+    mDataPrepared = false;
+  } else
+    getPlotData(lineData, scatterData);
   
   // check data validity if flag set:
 #ifdef QCUSTOMPLOT_CHECK_DATA
@@ -15132,12 +17522,40 @@ void QCPGraph::draw(QCPPainter *painter)
   if (scatterData)
     drawScatterPlot(painter, scatterData);
   
+  // keep what was drawn for the hit-testing:
+  if (mLineStyle == lsNone)
+  {
+    lineData->clear();
+    lineData->reserve(scatterData->size());
+    for (int i=0; i<scatterData->size(); ++i)
+      lineData->append(coordsToPixels(scatterData->at(i).key, scatterData->at(i).value));
+  }
+  updateHitIndex(lineData, mLineStyle == lsImpulse);
+  
   // free allocated line and point vectors:
   delete lineData;
   if (scatterData)
     delete scatterData;
 }
 
+/*! \internal
+  
+  Fills the line and scatter pixel data the next \ref draw call paints, with the same checks draw
+  does. Runs on a worker thread if \ref QCP::phParallelPreparation is set.
+*/
+void QCPGraph::prepareDraw()
+{
+  mDataPrepared = false;
+  mPreparedLineData.clear();
+  mPreparedScatterData.clear();
+  if (!mKeyAxis || !mValueAxis) return;
+  if (mKeyAxis.data()->range().size() <= 0 || dataCount() == 0) return;
+  if (mLineStyle == lsNone && mScatterStyle.isNone()) return;
+  
+  getPlotData(&mPreparedLineData, mScatterStyle.isNone() ? 0 : &mPreparedScatterData);
+  mDataPrepared = true;
+}
+
 /* inherits documentation from base class */
 void QCPGraph::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
 {
@@ -15202,6 +17620,114 @@ void QCPGraph::getPlotData(QVector<QPointF> *lineData, QVector<QCPData> *scatter
     case lsStepCenter: getStepCenterPlotData(lineData, scatterData); break;
     case lsImpulse: getImpulsePlotData(lineData, scatterData); break;
   }
+  if (lineData && mLineStyle != lsNone)
+    clipLineData(lineData);
+}
+
+/*! \internal
+  
+  Clips the pixel coordinates in \a lineData to the axis rect, enlarged by a margin of the pen
+  width plus the selection tolerance, so nothing visible or selectable changes. Data far outside of
+  the value range (e.g. of tan(x) near its poles) otherwise gives huge pixel coordinates, which the
+  paint engine handles slowly.
+  
+  Segments crossing the border are cut at the intersection, and points outside are moved onto the
+  border instead of being removed. That way fills under the line stay correct. Runs of points on
+  the same border side are reduced to their first and last point.
+  
+  For \ref lsImpulse, the two points of each impulse are just clamped to the enlarged rect, so the
+  impulses stay pairs.
+*/
+void QCPGraph::clipLineData(QVector<QPointF> *lineData) const
+{
+  const double margin = qMax(mPen.widthF(), mSelectedPen.widthF())+mParentPlot->selectionTolerance()+1;
+  const QRectF bounds = QRectF(clipRect()).adjusted(-margin, -margin, margin, margin);
+  
+  // most of the time, there's nothing to clip:
+  bool outside = false;
+  for (int i=0; i<lineData->size() && !outside; ++i)
+  {
+    const QPointF &point = lineData->at(i);
+    outside = point.x() < bounds.left() || point.x() > bounds.right() || point.y() < bounds.top() || point.y() > bounds.bottom();
+  }
+  if (!outside)
+    return;
+  
+  if (mLineStyle == lsImpulse)
+  {
+    for (int i=0; i<lineData->size(); ++i)
+    {
+      QPointF &point = (*lineData)[i];
+      if (!qIsNaN(point.x()) && !qIsNaN(point.y()))
+        point = QPointF(qBound(bounds.left(), point.x(), bounds.right()), qBound(bounds.top(), point.y(), bounds.bottom()));
+    }
+    return;
+  }
+  
+  QVector<QPointF> clipped;
+  clipLineDataEdge(*lineData, &clipped, true, bounds.left(), true);
+  clipLineDataEdge(clipped, lineData, true, bounds.right(), false);
+  clipLineDataEdge(*lineData, &clipped, false, bounds.top(), true);
+  clipLineDataEdge(clipped, lineData, false, bounds.bottom(), false);
+}
+
+/*! \internal
+  
+  One pass of \ref clipLineData, against a single border: If \a clipX is true, the border is the
+  vertical line at x = \a bound, else the horizontal line at y = \a bound. If \a keepGreater is
+  true, points with a greater coordinate than \a bound are inside.
+  
+  Writes the clipped points of \a input to \a output. Points with NaN coordinates are passed on
+  unchanged, since they create gaps in the line.
+*/
+void QCPGraph::clipLineDataEdge(const QVector<QPointF> &input, QVector<QPointF> *output, bool clipX, double bound, bool keepGreater) const
+{
+  output->clear();
+  output->reserve(input.size());
+  bool previousValid = false;
+  bool previousInside = false;
+  int borderRun = 0; // number of points at the end of output that lie on the border
+  for (int i=0; i<input.size(); ++i)
+  {
+    const QPointF &point = input.at(i);
+    if (qIsNaN(point.x()) || qIsNaN(point.y()))
+    {
+      output->append(point);
+      previousValid = false;
+      borderRun = 0;
+      continue;
+    }
+    const double coord = clipX ? point.x() : point.y();
+    const bool inside = keepGreater ? coord >= bound : coord <= bound;
+    if (previousValid && inside != previousInside)
+    {
+      // cut the segment at the border:
+      const QPointF &previous = input.at(i-1);
+      const double t = (bound-(clipX ? previous.x() : previous.y()))/(coord-(clipX ? previous.x() : previous.y()));
+      if (clipX)
+        output->append(QPointF(bound, previous.y()+t*(point.y()-previous.y())));
+      else
+        output->append(QPointF(previous.x()+t*(point.x()-previous.x()), bound));
+      ++borderRun;
+    }
+    if (inside)
+    {
+      output->append(point);
+      borderRun = 0;
+    } else
+    {
+      const QPointF projected = clipX ? QPointF(bound, point.y()) : QPointF(point.x(), bound);
+      if (borderRun >= 2)
+        output->last() = projected; // the border run only needs its first and last point
+      else
+      {
+        output->append(projected);
+        ++borderRun;
+      }
+    }
+    previousValid = true;
+    previousInside = inside;
+  }
 }
 
 /*! \internal
@@ -15552,17 +18078,20 @@ void QCPGraph::drawScatterPlot(QCPPainter *painter, QVector<QCPData> *scatterDat
   // draw scatter point symbols:
   applyScattersAntialiasingHint(painter);
   mScatterStyle.applyTo(painter, mPen);
+  QVector<QPointF> positions;
+  positions.reserve(scatterData->size());
   if (keyAxis->orientation() == Qt::Vertical)
   {
     for (int i=0; i<scatterData->size(); ++i)
       if (!qIsNaN(scatterData->at(i).value))
-        mScatterStyle.drawShape(painter, valueAxis->coordToPixel(scatterData->at(i).value), keyAxis->coordToPixel(scatterData->at(i).key));
+        positions.append(QPointF(valueAxis->coordToPixel(scatterData->at(i).value), keyAxis->coordToPixel(scatterData->at(i).key)));
   } else
   {
     for (int i=0; i<scatterData->size(); ++i)
       if (!qIsNaN(scatterData->at(i).value))
-        mScatterStyle.drawShape(painter, keyAxis->coordToPixel(scatterData->at(i).key), valueAxis->coordToPixel(scatterData->at(i).value));
+        positions.append(QPointF(keyAxis->coordToPixel(scatterData->at(i).key), valueAxis->coordToPixel(scatterData->at(i).value)));
   }
+  mScatterStyle.drawShapes(painter, positions);
 }
 
 /*!  \internal
@@ -15604,6 +18133,9 @@ void QCPGraph::drawLinePlot(QCPPainter *painter, QVector<QPointF> *lineData) con
         !painter->modes().testFlag(QCPPainter::pmVectorized)&&
         !painter->modes().testFlag(QCPPainter::pmNoCaching))
     {
+      // thin lines on raster images are written directly into the pixels:
+      if (painter->drawRasterPolyline(lineData->constData(), lineData->size()))
+        return;
       int i = 1;
       int lineDataSize = lineData->size();
       while (i < lineDataSize)
@@ -15657,25 +18189,19 @@ void QCPGraph::drawImpulsePlot(QCPPainter *painter, QVector<QPointF> *lineData)
 
 /*! \internal
   
-  Returns the \a lineData and \a scatterData that need to be plotted for this graph taking into
-  consideration the current axis ranges and, if \ref setAdaptiveSampling is enabled, local point
-  densities.
-  
-  0 may be passed as \a lineData or \a scatterData to indicate that the respective dataset isn't
-  needed. For example, if the scatter style (\ref setScatterStyle) is \ref QCPScatterStyle::ssNone, \a
-  scatterData should be 0 to prevent unnecessary calculations.
-  
-  This method is used by the various "get(...)PlotData" methods to get the basic working set of data.
+  Implementation of \ref getPreparedData for both data containers, \a data is either \ref mData
+  or \ref mDataArray.
 */
-void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *scatterData) const
+template <class DataContainer>
+void QCPGraph::getPreparedData(const DataContainer *data, QVector<QCPData> *lineData, QVector<QCPData> *scatterData) const
 {
   QCPAxis *keyAxis = mKeyAxis.data();
   QCPAxis *valueAxis = mValueAxis.data();
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
   // get visible data range:
-  QCPDataMap::const_iterator lower, upper; // note that upper is the actual upper point, and not 1 step after the upper point
+  typename DataContainer::const_iterator lower, upper; // note that upper is the actual upper point, and not 1 step after the upper point
   getVisibleDataBounds(lower, upper);
-  if (lower == mData->constEnd() || upper == mData->constEnd())
+  if (lower == data->constEnd() || upper == data->constEnd())
     return;
   
   // count points in visible range, taking into account that we only need to count to the limit maxCount if using adaptive sampling:
@@ -15690,74 +18216,19 @@ void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *sca
   if (mAdaptiveSampling && dataCount >= maxCount) // use adaptive sampling only if there are at least two points per pixel on average
   {
     if (lineData)
-    {
-      QCPDataMap::const_iterator it = lower;
-      QCPDataMap::const_iterator upperEnd = upper+1;
-      double minValue = it.value().value;
-      double maxValue = it.value().value;
-      QCPDataMap::const_iterator currentIntervalFirstPoint = it;
-      int reversedFactor = keyAxis->rangeReversed() != (keyAxis->orientation()==Qt::Vertical) ? -1 : 1; // is used to calculate keyEpsilon pixel into the correct direction
-      int reversedRound = keyAxis->rangeReversed() != (keyAxis->orientation()==Qt::Vertical) ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
-      double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(lower.key())+reversedRound));
-      double lastIntervalEndKey = currentIntervalStartKey;
-      double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
-      bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic; // indicates whether keyEpsilon needs to be updated after every interval (for log axes)
-      int intervalDataCount = 1;
-      ++it; // advance iterator to second data point because adaptive sampling works in 1 point retrospect
-      while (it != upperEnd)
-      {
-        if (it.key() < currentIntervalStartKey+keyEpsilon) // data point is still within same pixel, so skip it and expand value span of this cluster if necessary
-        {
-          if (it.value().value < minValue)
-            minValue = it.value().value;
-          else if (it.value().value > maxValue)
-            maxValue = it.value().value;
-          ++intervalDataCount;
-        } else // new pixel interval started
-        {
-          if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
-          {
-            if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
-              lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint.value().value));
-            lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
-            lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
-            if (it.key() > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
-              lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.8, (it-1).value().value));
-          } else
-            lineData->append(QCPData(currentIntervalFirstPoint.key(), currentIntervalFirstPoint.value().value));
-          lastIntervalEndKey = (it-1).value().key;
-          minValue = it.value().value;
-          maxValue = it.value().value;
-          currentIntervalFirstPoint = it;
-          currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(it.key())+reversedRound));
-          if (keyEpsilonVariable)
-            keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
-          intervalDataCount = 1;
-        }
-        ++it;
-      }
-      // handle last interval:
-      if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
-      {
-        if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point wasn't a cluster, so first point of this cluster must be at a real data point
-          lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint.value().value));
-        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
-        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
-      } else
-        lineData->append(QCPData(currentIntervalFirstPoint.key(), currentIntervalFirstPoint.value().value));
-    }
+      getAdaptiveLineData(lower, upper, lineData);
     
     if (scatterData)
     {
       double valueMaxRange = valueAxis->range().upper;
       double valueMinRange = valueAxis->range().lower;
-      QCPDataMap::const_iterator it = lower;
-      QCPDataMap::const_iterator upperEnd = upper+1;
+      typename DataContainer::const_iterator it = lower;
+      typename DataContainer::const_iterator upperEnd = upper+1;
       double minValue = it.value().value;
       double maxValue = it.value().value;
-      QCPDataMap::const_iterator minValueIt = it;
-      QCPDataMap::const_iterator maxValueIt = it;
-      QCPDataMap::const_iterator currentIntervalStart = it;
+      typename DataContainer::const_iterator minValueIt = it;
+      typename DataContainer::const_iterator maxValueIt = it;
+      typename DataContainer::const_iterator currentIntervalStart = it;
       int reversedFactor = keyAxis->rangeReversed() ? -1 : 1; // is used to calculate keyEpsilon pixel into the correct direction
       int reversedRound = keyAxis->rangeReversed() ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
       double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(lower.key())+reversedRound));
@@ -15786,7 +18257,7 @@ void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *sca
             // determine value pixel span and add as many points in interval to maintain certain vertical data density (this is specific to scatter plot):
             double valuePixelSpan = qAbs(valueAxis->coordToPixel(minValue)-valueAxis->coordToPixel(maxValue));
             int dataModulo = qMax(1, qRound(intervalDataCount/(valuePixelSpan/4.0))); // approximately every 4 value pixels one data point on average
-            QCPDataMap::const_iterator intervalIt = currentIntervalStart;
+            typename DataContainer::const_iterator intervalIt = currentIntervalStart;
             int c = 0;
             while (intervalIt != it)
             {
@@ -15813,7 +18284,7 @@ void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *sca
         // determine value pixel span and add as many points in interval to maintain certain vertical data density (this is specific to scatter plot):
         double valuePixelSpan = qAbs(valueAxis->coordToPixel(minValue)-valueAxis->coordToPixel(maxValue));
         int dataModulo = qMax(1, qRound(intervalDataCount/(valuePixelSpan/4.0))); // approximately every 4 value pixels one data point on average
-        QCPDataMap::const_iterator intervalIt = currentIntervalStart;
+        typename DataContainer::const_iterator intervalIt = currentIntervalStart;
         int c = 0;
         while (intervalIt != it)
         {
@@ -15834,8 +18305,8 @@ void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *sca
       dataVector = scatterData;
     if (dataVector)
     {
-      QCPDataMap::const_iterator it = lower;
-      QCPDataMap::const_iterator upperEnd = upper+1;
+      typename DataContainer::const_iterator it = lower;
+      typename DataContainer::const_iterator upperEnd = upper+1;
       dataVector->reserve(dataCount+2); // +2 for possible fill end points
       while (it != upperEnd)
       {
@@ -15848,6 +18319,26 @@ void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *sca
   }
 }
 
+/*! \internal
+  
+  Returns the \a lineData and \a scatterData that need to be plotted for this graph taking into
+  consideration the current axis ranges and, if \ref setAdaptiveSampling is enabled, local point
+  densities.
+  
+  0 may be passed as \a lineData or \a scatterData to indicate that the respective dataset isn't
+  needed. For example, if the scatter style (\ref setScatterStyle) is \ref QCPScatterStyle::ssNone, \a
+  scatterData should be 0 to prevent unnecessary calculations.
+  
+  This method is used by the various "get(...)PlotData" methods to get the basic working set of data.
+*/
+void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *scatterData) const
+{
+  if (mDataStorage == QCP::dsArray)
+    getPreparedData(mDataArray, lineData, scatterData);
+  else
+    getPreparedData(mData, lineData, scatterData);
+}
+
 /*!  \internal
   
   called by the scatter drawing function (\ref drawScatterPlot) to draw the error bars on one data
@@ -15988,26 +18479,184 @@ void QCPGraph::getVisibleDataBounds(QCPDataMap::const_iterator &lower, QCPDataMa
 
 /*!  \internal
   
-  Counts the number of data points between \a lower and \a upper (including them), up to a maximum
-  of \a maxCount.
-  
-  This function is used by \ref getPreparedData to determine whether adaptive sampling shall be
-  used (if enabled via \ref setAdaptiveSampling) or not. This is also why counting of data points
-  only needs to be done until \a maxCount is reached, which should be set to the number of data
-  points at which adaptive sampling sets in.
+  Counts the number of data points between \a lower and \a upper (including them), up to a maximum
+  of \a maxCount.
+  
+  This function is used by \ref getPreparedData to determine whether adaptive sampling shall be
+  used (if enabled via \ref setAdaptiveSampling) or not. This is also why counting of data points
+  only needs to be done until \a maxCount is reached, which should be set to the number of data
+  points at which adaptive sampling sets in.
+*/
+int QCPGraph::countDataInBounds(const QCPDataMap::const_iterator &lower, const QCPDataMap::const_iterator &upper, int maxCount) const
+{
+  if (upper == mData->constEnd() && lower == mData->constEnd())
+    return 0;
+  QCPDataMap::const_iterator it = lower;
+  int count = 1;
+  while (it != upper && count < maxCount)
+  {
+    ++it;
+    ++count;
+  }
+  return count;
+}
+
+/*!  \internal
+  \overload
+  
+  Same as the QCPDataMap version, for the data array used with \ref QCP::dsArray. The key column
+  is binary searched.
+*/
+void QCPGraph::getVisibleDataBounds(QCPDataArray::const_iterator &lower, QCPDataArray::const_iterator &upper) const
+{
+  if (!mKeyAxis) { qDebug() << Q_FUNC_INFO << "invalid key axis"; return; }
+  if (mDataArray->isEmpty())
+  {
+    lower = mDataArray->constEnd();
+    upper = mDataArray->constEnd();
+    return;
+  }
+  
+  QCPDataArray::const_iterator lbound = mDataArray->lowerBound(mKeyAxis.data()->range().lower);
+  QCPDataArray::const_iterator ubound = mDataArray->upperBound(mKeyAxis.data()->range().upper);
+  bool lowoutlier = lbound != mDataArray->constBegin(); // indicates whether there exist points below axis range
+  bool highoutlier = ubound != mDataArray->constEnd(); // indicates whether there exist points above axis range
+  
+  lower = (lowoutlier ? lbound-1 : lbound); // data point range that will be actually drawn
+  upper = (highoutlier ? ubound : ubound-1); // data point range that will be actually drawn
+}
+
+/*!  \internal
+  \overload
+  
+  Same as the QCPDataMap version, for the data array used with \ref QCP::dsArray. Since the array
+  is contiguous, this doesn't need to step through the points.
+*/
+int QCPGraph::countDataInBounds(const QCPDataArray::const_iterator &lower, const QCPDataArray::const_iterator &upper, int maxCount) const
+{
+  if (upper == mDataArray->constEnd() && lower == mDataArray->constEnd())
+    return 0;
+  return qMin(upper-lower+1, maxCount);
+}
+
+/*!  \internal
+  
+  Appends the points of the line between \a lower and \a upper (including them) to \a lineData,
+  consolidating the points that fall into the same pixel along the key axis to their value range.
+  Used by \ref getPreparedData if adaptive sampling is in effect, see \ref setAdaptiveSampling.
+*/
+void QCPGraph::getAdaptiveLineData(const QCPDataMap::const_iterator &lower, const QCPDataMap::const_iterator &upper, QVector<QCPData> *lineData) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPDataMap::const_iterator it = lower;
+  QCPDataMap::const_iterator upperEnd = upper+1;
+  double minValue = it.value().value;
+  double maxValue = it.value().value;
+  QCPDataMap::const_iterator currentIntervalFirstPoint = it;
+  int reversedFactor = keyAxis->rangeReversed() != (keyAxis->orientation()==Qt::Vertical) ? -1 : 1; // is used to calculate keyEpsilon pixel into the correct direction
+  int reversedRound = keyAxis->rangeReversed() != (keyAxis->orientation()==Qt::Vertical) ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
+  double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(lower.key())+reversedRound));
+  double lastIntervalEndKey = currentIntervalStartKey;
+  double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
+  bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic; // indicates whether keyEpsilon needs to be updated after every interval (for log axes)
+  int intervalDataCount = 1;
+  ++it; // advance iterator to second data point because adaptive sampling works in 1 point retrospect
+  while (it != upperEnd)
+  {
+    if (it.key() < currentIntervalStartKey+keyEpsilon) // data point is still within same pixel, so skip it and expand value span of this cluster if necessary
+    {
+      if (it.value().value < minValue)
+        minValue = it.value().value;
+      else if (it.value().value > maxValue)
+        maxValue = it.value().value;
+      ++intervalDataCount;
+    } else // new pixel interval started
+    {
+      if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
+      {
+        if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
+          lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint.value().value));
+        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+        if (it.key() > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
+          lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.8, (it-1).value().value));
+      } else
+        lineData->append(QCPData(currentIntervalFirstPoint.key(), currentIntervalFirstPoint.value().value));
+      lastIntervalEndKey = (it-1).value().key;
+      minValue = it.value().value;
+      maxValue = it.value().value;
+      currentIntervalFirstPoint = it;
+      currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(it.key())+reversedRound));
+      if (keyEpsilonVariable)
+        keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
+      intervalDataCount = 1;
+    }
+    ++it;
+  }
+  // handle last interval:
+  if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
+  {
+    if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point wasn't a cluster, so first point of this cluster must be at a real data point
+      lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint.value().value));
+    lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+    lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+  } else
+    lineData->append(QCPData(currentIntervalFirstPoint.key(), currentIntervalFirstPoint.value().value));
+}
+
+/*!  \internal
+  \overload
+  
+  Same as the QCPDataMap version, for the data array used with \ref QCP::dsArray. Instead of
+  visiting every point, this jumps from pixel to pixel: the first point of the next pixel is
+  binary searched in the key column and the value range of the points in between is read from the
+  min/max pyramid of the array (see \ref QCPDataArray::valueBounds). So the cost depends on the
+  number of pixels and only logarithmically on the number of points.
 */
-int QCPGraph::countDataInBounds(const QCPDataMap::const_iterator &lower, const QCPDataMap::const_iterator &upper, int maxCount) const
+void QCPGraph::getAdaptiveLineData(const QCPDataArray::const_iterator &lower, const QCPDataArray::const_iterator &upper, QVector<QCPData> *lineData) const
 {
-  if (upper == mData->constEnd() && lower == mData->constEnd())
-    return 0;
-  QCPDataMap::const_iterator it = lower;
-  int count = 1;
-  while (it != upper && count < maxCount)
-  {
-    ++it;
-    ++count;
+  QCPAxis *keyAxis = mKeyAxis.data();
+  const QCPDataArray *data = mDataArray;
+  const int end = upper.index()+1;
+  int first = lower.index(); // first point of the current pixel interval
+  int reversedFactor = keyAxis->rangeReversed() != (keyAxis->orientation()==Qt::Vertical) ? -1 : 1; // is used to calculate keyEpsilon pixel into the correct direction
+  int reversedRound = keyAxis->rangeReversed() != (keyAxis->orientation()==Qt::Vertical) ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
+  double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(data->key(first))+reversedRound));
+  double lastIntervalEndKey = currentIntervalStartKey;
+  double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
+  bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic; // indicates whether keyEpsilon needs to be updated after every interval (for log axes)
+  while (first < end)
+  {
+    // the points up to next belong to this pixel interval:
+    const int next = qBound(first+1, data->lowerBoundIndex(currentIntervalStartKey+keyEpsilon), end);
+    const double firstValue = data->value(first);
+    if (next-first >= 2) // pixel has multiple data points, consolidate them to a cluster
+    {
+      double minValue = firstValue;
+      double maxValue = firstValue;
+      double intervalMin, intervalMax;
+      if (!qIsNaN(firstValue) && data->valueBounds(first+1, next, intervalMin, intervalMax)) // like the map version, a cluster starting at a NaN value stays a gap
+      {
+        minValue = qMin(minValue, intervalMin);
+        maxValue = qMax(maxValue, intervalMax);
+      }
+      if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
+        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, firstValue));
+      lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+      lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+      if (next < end && data->key(next) > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
+        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.8, data->value(next-1)));
+    } else
+      lineData->append(QCPData(data->key(first), firstValue));
+    lastIntervalEndKey = data->key(next-1);
+    first = next;
+    if (first < end)
+    {
+      currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(data->key(first))+reversedRound));
+      if (keyEpsilonVariable)
+        keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
+    }
   }
-  return count;
 }
 
 /*! \internal
@@ -16404,20 +19053,26 @@ int QCPGraph::findIndexAboveY(const QVector<QPointF> *data, double y) const
 */
 double QCPGraph::pointDistance(const QPointF &pixelPoint) const
 {
-  if (mData->isEmpty())
+  if (dataCount() == 0)
   {
     qDebug() << Q_FUNC_INFO << "requested point distance on graph" << mName << "without data";
     return 500;
   }
-  if (mData->size() == 1)
+  if (dataCount() == 1)
   {
-    QPointF dataPoint = coordsToPixels(mData->constBegin().key(), mData->constBegin().value().value);
+    QPointF dataPoint = mDataStorage == QCP::dsArray ?
+          coordsToPixels(mDataArray->key(0), mDataArray->value(0)) :
+          coordsToPixels(mData->constBegin().key(), mData->constBegin().value().value);
     return QVector2D(dataPoint-pixelPoint).length();
   }
   
   if (mLineStyle == lsNone && mScatterStyle.isNone())
     return 500;
   
+  // use the index of what was drawn in the last replot, if the axes haven't changed since:
+  if (hitIndexValid())
+    return hitIndexDistance(pixelPoint);
+  
   // calculate minimum distances to graph representation:
   if (mLineStyle == lsNone)
   {
@@ -16425,13 +19080,10 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint) const
     QVector<QCPData> *scatterData = new QVector<QCPData>;
     getScatterPlotData(scatterData);
     double minDistSqr = std::numeric_limits<double>::max();
-    QPointF ptA;
-    QPointF ptB = coordsToPixels(scatterData->at(0).key, scatterData->at(0).value); // getScatterPlotData returns in plot coordinates, so transform to pixels
-    for (int i=1; i<scatterData->size(); ++i)
+    for (int i=0; i<scatterData->size(); ++i)
     {
-      ptA = ptB;
-      ptB = coordsToPixels(scatterData->at(i).key, scatterData->at(i).value);
-      double currentDistSqr = distSqrToLine(ptA, ptB, pixelPoint);
+      QPointF scatterPoint = coordsToPixels(scatterData->at(i).key, scatterData->at(i).value); // getScatterPlotData returns in plot coordinates, so transform to pixels
+      double currentDistSqr = QVector2D(scatterPoint-pixelPoint).lengthSquared();
       if (currentDistSqr < minDistSqr)
         minDistSqr = currentDistSqr;
     }
@@ -16467,6 +19119,161 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint) const
   }
 }
 
+/*! \internal
+  
+  Keeps the pixel representation \a pixelData that was just drawn (the line, or the scatter points
+  if the graph has no line) for the hit-testing in \ref pointDistance, and indexes its segments by
+  the pixel columns along the key axis they cross. If \a pairwise is true, the points are connected
+  pairwise like in an impulse plot, otherwise consecutively. If the line style is \ref lsNone, the
+  points aren't connected at all, each one is indexed as a segment of zero length.
+  
+  The index is stored as compressed rows: the segments crossing column c are listed in \ref
+  mHitSegments from \ref mHitColumnStart[c] on. Only columns within the axis rect extended by its
+  own size to both sides are indexed, the segments outside are far enough from any point in the
+  axis rect to never be selected.
+*/
+void QCPGraph::updateHitIndex(QVector<QPointF> *pixelData, bool pairwise)
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  const QRect axisRect = keyAxis->axisRect()->rect();
+  mHitPoints.swap(*pixelData);
+  mHitLineStyle = mLineStyle; // determines the segment ends, see hitSegmentEnd
+  mHitHorizontal = keyAxis->orientation() == Qt::Horizontal;
+  const int low = mHitHorizontal ? axisRect.left() : axisRect.top();
+  const int high = mHitHorizontal ? axisRect.right() : axisRect.bottom();
+  mHitFirstColumn = low-(high-low+1);
+  const int columnCount = 3*(high-low+1);
+  mHitColumnStart.fill(0, columnCount+1);
+  
+  // count the segments per column, then turn the counts into start indices:
+  const int step = pairwise ? 2 : 1;
+  int first, last;
+  for (int i=0; hitSegmentEnd(i)<mHitPoints.size(); i+=step)
+  {
+    if (hitColumns(i, first, last))
+    {
+      for (int c=first; c<=last; ++c)
+        ++mHitColumnStart[c+1];
+    }
+  }
+  for (int c=0; c<columnCount; ++c)
+    mHitColumnStart[c+1] += mHitColumnStart[c];
+  mHitSegments.resize(mHitColumnStart.last());
+  QVector<int> next = mHitColumnStart; // next free entry of each column
+  for (int i=0; hitSegmentEnd(i)<mHitPoints.size(); i+=step)
+  {
+    if (hitColumns(i, first, last))
+    {
+      for (int c=first; c<=last; ++c)
+        mHitSegments[next[c]++] = i;
+    }
+  }
+  
+  mHitKeyRange = keyAxis->range();
+  mHitValueRange = mValueAxis.data()->range();
+  mHitAxisRect = axisRect;
+  // fills and error bars reach beyond the line, then the drawn region stays the clip rect:
+  if ((mainBrush().style() == Qt::NoBrush || mainBrush().color().alpha() == 0) && mErrorType == etNone)
+  {
+    double scatterSize = mScatterStyle.isNone() ? 0 : mScatterStyle.size();
+    if (mScatterStyle.shape() == QCPScatterStyle::ssPixmap)
+      scatterSize = qMax(mScatterStyle.pixmap().width(), mScatterStyle.pixmap().height());
+    setDrawnRect(mHitPoints, qMax(mainPen().widthF(), scatterSize)*0.5);
+  }
+}
+
+/*! \internal
+  
+  Sets \a first and \a last to the range of index columns (see \ref updateHitIndex) the segment
+  starting at \ref mHitPoints[\a segment] crosses. Returns false if it crosses none of them.
+*/
+bool QCPGraph::hitColumns(int segment, int &first, int &last) const
+{
+  const QPointF &a = mHitPoints.at(segment);
+  const QPointF &b = mHitPoints.at(hitSegmentEnd(segment));
+  const double lower = mHitHorizontal ? qMin(a.x(), b.x()) : qMin(a.y(), b.y());
+  const double upper = mHitHorizontal ? qMax(a.x(), b.x()) : qMax(a.y(), b.y());
+  const int columnCount = mHitColumnStart.size()-1;
+  if (!(upper >= mHitFirstColumn && lower < mHitFirstColumn+columnCount)) // also catches NaN coordinates
+    return false;
+  // clamp before rounding, far away points may exceed the int range:
+  first = qFloor(qMax(lower, (double)mHitFirstColumn))-mHitFirstColumn;
+  last = qMin(columnCount-1, qFloor(qMin(upper, (double)(mHitFirstColumn+columnCount)))-mHitFirstColumn);
+  return true;
+}
+
+/*! \internal
+  
+  Returns the index in \ref mHitPoints of the point the segment starting at \a segment ends at.
+  Without a line (\ref lsNone), segments are single scatter points, so this is \a segment itself.
+*/
+int QCPGraph::hitSegmentEnd(int segment) const
+{
+  return mHitLineStyle == lsNone ? segment : segment+1;
+}
+
+/*! \internal
+  
+  Returns the distance of \a pixelPoint to the representation of the graph drawn in the last
+  replot, using the index built by \ref updateHitIndex.
+  
+  Only the segments in the columns around \a pixelPoint are checked. The band of columns starts at
+  the selection tolerance and is doubled until the closest segment found lies within it, which
+  guarantees that no closer segment exists outside of the band. So a hit test usually only looks at
+  a handful of segments and doesn't allocate any memory.
+*/
+double QCPGraph::hitIndexDistance(const QPointF &pixelPoint) const
+{
+  const int columnCount = mHitColumnStart.size()-1;
+  const int column = qFloor(mHitHorizontal ? pixelPoint.x() : pixelPoint.y())-mHitFirstColumn;
+  int radius = qMax(1, mParentPlot->selectionTolerance());
+  int checkedLow = 0, checkedHigh = -1; // columns checked in the previous rounds
+  double minDistSqr = std::numeric_limits<double>::max();
+  while (true)
+  {
+    const int low = qMax(0, column-radius);
+    const int high = qMin(columnCount-1, column+radius);
+    for (int c=low; c<=high; ++c)
+    {
+      if (c >= checkedLow && c <= checkedHigh)
+        continue;
+      for (int j=mHitColumnStart.at(c); j<mHitColumnStart.at(c+1); ++j)
+      {
+        const int i = mHitSegments.at(j);
+        double currentDistSqr = distSqrToLine(mHitPoints.at(i), mHitPoints.at(hitSegmentEnd(i)), pixelPoint);
+        if (currentDistSqr < minDistSqr)
+          minDistSqr = currentDistSqr;
+      }
+    }
+    checkedLow = low;
+    checkedHigh = high;
+    if (minDistSqr <= (double)radius*radius || (low == 0 && high == columnCount-1))
+      break;
+    radius *= 2;
+  }
+  if (minDistSqr == std::numeric_limits<double>::max()) // no segment in reach of the axis rect
+    return 500;
+  return qSqrt(minDistSqr);
+}
+
+/*! \internal
+  
+  Returns whether the index built by \ref updateHitIndex still matches the graph as it would be
+  drawn now, i.e. the graph was drawn and neither the line style, the axis ranges nor the axis
+  rect changed since.
+  
+  Data changes aren't tracked, so until the next replot, hit-testing is done against the graph as
+  it's displayed.
+*/
+bool QCPGraph::hitIndexValid() const
+{
+  return !mHitColumnStart.isEmpty() &&
+      mHitLineStyle == mLineStyle &&
+      mHitKeyRange == mKeyAxis.data()->range() &&
+      mHitValueRange == mValueAxis.data()->range() &&
+      mHitAxisRect == mKeyAxis.data()->axisRect()->rect();
+}
+
 /*! \internal
   
   Finds the highest index of \a data, whose points y value is just below \a y. Assumes y values in
@@ -16513,6 +19320,23 @@ QCPRange QCPGraph::getValueRange(bool &foundRange, SignDomain inSignDomain) cons
   \see getKeyRange(bool &foundRange, SignDomain inSignDomain)
 */
 QCPRange QCPGraph::getKeyRange(bool &foundRange, SignDomain inSignDomain, bool includeErrors) const
+{
+  if (mDataStorage == QCP::dsArray)
+  {
+    if (includeErrors && mDataArray->hasKeyErrors())
+      return getKeyRange(mDataArray, foundRange, inSignDomain, includeErrors);
+    return mDataArray->keyRange(foundRange, inSignDomain);
+  }
+  return getKeyRange(mData, foundRange, inSignDomain, includeErrors);
+}
+
+/*! \internal
+  
+  Implementation of \ref getKeyRange for both data containers, \a data is either \ref mData or
+  \ref mDataArray.
+*/
+template <class DataContainer>
+QCPRange QCPGraph::getKeyRange(const DataContainer *data, bool &foundRange, SignDomain inSignDomain, bool includeErrors) const
 {
   QCPRange range;
   bool haveLower = false;
@@ -16522,8 +19346,8 @@ QCPRange QCPGraph::getKeyRange(bool &foundRange, SignDomain inSignDomain, bool i
   
   if (inSignDomain == sdBoth) // range may be anywhere
   {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
+    typename DataContainer::const_iterator it = data->constBegin();
+    while (it != data->constEnd())
     {
       current = it.value().key;
       currentErrorMinus = (includeErrors ? it.value().keyErrorMinus : 0);
@@ -16542,8 +19366,8 @@ QCPRange QCPGraph::getKeyRange(bool &foundRange, SignDomain inSignDomain, bool i
     }
   } else if (inSignDomain == sdNegative) // range may only be in the negative sign domain
   {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
+    typename DataContainer::const_iterator it = data->constBegin();
+    while (it != data->constEnd())
     {
       current = it.value().key;
       currentErrorMinus = (includeErrors ? it.value().keyErrorMinus : 0);
@@ -16575,8 +19399,8 @@ QCPRange QCPGraph::getKeyRange(bool &foundRange, SignDomain inSignDomain, bool i
     }
   } else if (inSignDomain == sdPositive) // range may only be in the positive sign domain
   {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
+    typename DataContainer::const_iterator it = data->constBegin();
+    while (it != data->constEnd())
     {
       current = it.value().key;
       currentErrorMinus = (includeErrors ? it.value().keyErrorMinus : 0);
@@ -16619,17 +19443,54 @@ QCPRange QCPGraph::getKeyRange(bool &foundRange, SignDomain inSignDomain, bool i
   \see getValueRange(bool &foundRange, SignDomain inSignDomain)
 */
 QCPRange QCPGraph::getValueRange(bool &foundRange, SignDomain inSignDomain, bool includeErrors) const
+{
+  if (mDataStorage == QCP::dsArray)
+  {
+    if (includeErrors && mDataArray->hasValueErrors())
+      return getValueRange(mDataArray, foundRange, inSignDomain, includeErrors, 0);
+    return mDataArray->valueRange(foundRange, inSignDomain);
+  }
+  return getValueRange(mData, foundRange, inSignDomain, includeErrors, 0);
+}
+
+/*! \overload
+  
+  Only takes into account the data points with keys inside \a inKeyRange (including its bounds).
+  
+  \see rescaleValueAxis
+*/
+QCPRange QCPGraph::getValueRange(bool &foundRange, SignDomain inSignDomain, bool includeErrors, const QCPRange &inKeyRange) const
+{
+  if (mDataStorage == QCP::dsArray)
+  {
+    if (includeErrors && mDataArray->hasValueErrors())
+      return getValueRange(mDataArray, foundRange, inSignDomain, includeErrors, &inKeyRange);
+    return mDataArray->valueRange(foundRange, inSignDomain, inKeyRange);
+  }
+  return getValueRange(mData, foundRange, inSignDomain, includeErrors, &inKeyRange);
+}
+
+/*! \internal
+  
+  Implementation of \ref getValueRange for both data containers, \a data is either \ref mData or
+  \ref mDataArray. If \a inKeyRange isn't 0, only the data points with keys inside it are taken
+  into account.
+*/
+template <class DataContainer>
+QCPRange QCPGraph::getValueRange(const DataContainer *data, bool &foundRange, SignDomain inSignDomain, bool includeErrors, const QCPRange *inKeyRange) const
 {
   QCPRange range;
   bool haveLower = false;
   bool haveUpper = false;
   
   double current, currentErrorMinus, currentErrorPlus;
+  typename DataContainer::const_iterator begin = inKeyRange ? data->lowerBound(inKeyRange->lower) : data->constBegin();
+  typename DataContainer::const_iterator end = inKeyRange ? data->upperBound(inKeyRange->upper) : data->constEnd();
   
   if (inSignDomain == sdBoth) // range may be anywhere
   {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
+    typename DataContainer::const_iterator it = begin;
+    while (it != end)
     {
       current = it.value().value;
       currentErrorMinus = (includeErrors ? it.value().valueErrorMinus : 0);
@@ -16648,8 +19509,8 @@ QCPRange QCPGraph::getValueRange(bool &foundRange, SignDomain inSignDomain, bool
     }
   } else if (inSignDomain == sdNegative) // range may only be in the negative sign domain
   {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
+    typename DataContainer::const_iterator it = begin;
+    while (it != end)
     {
       current = it.value().value;
       currentErrorMinus = (includeErrors ? it.value().valueErrorMinus : 0);
@@ -16681,8 +19542,8 @@ QCPRange QCPGraph::getValueRange(bool &foundRange, SignDomain inSignDomain, bool
     }
   } else if (inSignDomain == sdPositive) // range may only be in the positive sign domain
   {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
+    typename DataContainer::const_iterator it = begin;
+    while (it != end)
     {
       current = it.value().value;
       currentErrorMinus = (includeErrors ? it.value().valueErrorMinus : 0);
@@ -16719,41 +19580,364 @@ QCPRange QCPGraph::getValueRange(bool &foundRange, SignDomain inSignDomain, bool
 }
 
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////// QCPCurveData
-////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPCurveData
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPCurveData
+  \brief Holds the data of one single data point for QCPCurve.
+  
+  The container for storing multiple data points is \ref QCPCurveDataMap.
+  
+  The stored data is:
+  \li \a t: the free parameter of the curve at this curve point (cp. the mathematical vector <em>(x(t), y(t))</em>)
+  \li \a key: coordinate on the key axis of this curve point
+  \li \a value: coordinate on the value axis of this curve point
+  
+  \see QCPCurveDataMap
+*/
+
+/*!
+  Constructs a curve data point with t, key and value set to zero.
+*/
+QCPCurveData::QCPCurveData() :
+  t(0),
+  key(0),
+  value(0)
+{
+}
+
+/*!
+  Constructs a curve data point with the specified \a t, \a key and \a value.
+*/
+QCPCurveData::QCPCurveData(double t, double key, double value) :
+  t(t),
+  key(key),
+  value(value)
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPCurveDataArray
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPCurveDataArray
+  \brief Holds the data points of a QCPCurve in contiguous columns, sorted by the curve parameter.
+
+  This is the container a curve uses when its data storage is set to \ref QCP::dsArray (see \ref
+  QCPCurve::setDataStorage). It is the counterpart of \ref QCPDataArray for curves: the points are
+  held in a t, a key and a value column, sorted by t, so lookups by t are binary searches and
+  drawing iterates consecutive memory. Loading data that is already sorted by t takes a single
+  pass, unsorted data is sorted once. Points with a NaN t are dropped.
+
+  Like \ref QCPDataArray, points removed from the front are skipped instead of moved, and with a
+  \ref setCapacity "capacity" the array is a ring buffer: appending a point evicts the one with the
+  smallest t in amortized constant time.
+
+  The \ref const_iterator mirrors the interface of a QCPCurveDataMap::const_iterator (\a key is
+  t, \a value the point).
+*/
+
+/*!
+  Constructs an empty curve data array.
+*/
+QCPCurveDataArray::QCPCurveDataArray() :
+  mBegin(0),
+  mCapacity(0)
+{
+}
+
+/*!
+  Returns the index of the first data point whose t is not smaller than \a t, or \ref size if
+  there is none.
+*/
+int QCPCurveDataArray::lowerBoundIndex(double t) const
+{
+  const double *begin = mT.constData()+mBegin;
+  return std::lower_bound(begin, begin+size(), t)-begin;
+}
+
+/*!
+  Returns the index of the first data point whose t is greater than \a t, or \ref size if there
+  is none.
+*/
+int QCPCurveDataArray::upperBoundIndex(double t) const
+{
+  const double *begin = mT.constData()+mBegin;
+  return std::upper_bound(begin, begin+size(), t)-begin;
+}
+
+/*!
+  Sets the maximum number of data points the array holds. Whenever adding points exceeds the
+  capacity, the points with the smallest t are removed. Set \a capacity to 0 (the default) for no
+  limit.
+
+  \see QCPDataArray::setCapacity
+*/
+void QCPCurveDataArray::setCapacity(int capacity)
+{
+  mCapacity = qMax(0, capacity);
+  evict();
+}
+
+/*!
+  Replaces the data with the points in \a t, \a keys and \a values. The provided vectors should
+  have equal length. Else, the number of points will be the size of the smallest vector.
+
+  If \a t is sorted, the vectors are shared (not copied) if they have equal length. Otherwise the
+  points are sorted by t first.
+*/
+void QCPCurveDataArray::set(const QVector<double> &t, const QVector<double> &keys, const QVector<double> &values)
+{
+  mBegin = 0;
+  const int n = qMin(t.size(), qMin(keys.size(), values.size()));
+  if (QCPDataArray::isSorted(t.constData(), n))
+  {
+    mT = QCPDataArray::leading(t, n);
+    mKeys = QCPDataArray::leading(keys, n);
+    mValues = QCPDataArray::leading(values, n);
+  } else
+  {
+    const QVector<int> order = QCPDataArray::sortedOrder(t.constData(), n);
+    mT = QCPDataArray::gathered(t, order);
+    mKeys = QCPDataArray::gathered(keys, order);
+    mValues = QCPDataArray::gathered(values, order);
+  }
+  evict();
+}
+
+/*! \overload
+
+  Replaces the data with the points in \a dataMap.
+*/
+void QCPCurveDataArray::set(const QCPCurveDataMap &dataMap)
+{
+  clear();
+  reserve(dataMap.size());
+  QCPCurveDataMap::const_iterator it;
+  for (it = dataMap.constBegin(); it != dataMap.constEnd(); ++it)
+  {
+    if (qIsNaN(it.key()))
+      continue;
+    mT.append(it.key());
+    mKeys.append(it.value().key);
+    mValues.append(it.value().value);
+  }
+  evict();
+}
+
+/*!
+  Adds the points in \a t, \a keys and \a values to the data. The provided vectors should have
+  equal length. Else, the number of added points will be the size of the smallest vector.
+
+  If the new t are sorted and don't start below the current last t, they are simply appended.
+  Otherwise the new points are merged into the columns in linear time, after sorting them if
+  necessary.
+*/
+void QCPCurveDataArray::add(const QVector<double> &t, const QVector<double> &keys, const QVector<double> &values)
+{
+  const int n = qMin(t.size(), qMin(keys.size(), values.size()));
+  if (n == 0)
+    return;
+  const bool sorted = QCPDataArray::isSorted(t.constData(), n);
+  const QVector<int> order = sorted ? QVector<int>() : QCPDataArray::sortedOrder(t.constData(), n);
+  const int count = sorted ? n : order.size();
+  if (count == 0)
+    return;
+  const double firstT = t.at(sorted ? 0 : order.at(0));
+  if (isEmpty() || firstT >= this->t(size()-1))
+  {
+    reserve(size()+count);
+    for (int i=0; i<count; ++i)
+    {
+      const int j = sorted ? i : order.at(i);
+      mT.append(t.at(j));
+      mKeys.append(keys.at(j));
+      mValues.append(values.at(j));
+    }
+    evict();
+    return;
+  }
+  // merge the sorted new points into the existing columns:
+  QVector<double> mergedT(size()+count);
+  QVector<double> mergedKeys(size()+count);
+  QVector<double> mergedValues(size()+count);
+  int a = 0, b = 0, k = 0;
+  while (a < size() || b < count)
+  {
+    const int j = b < count ? (sorted ? b : order.at(b)) : -1;
+    if (j < 0 || (a < size() && this->t(a) <= t.at(j)))
+    {
+      mergedT[k] = this->t(a);
+      mergedKeys[k] = key(a);
+      mergedValues[k] = value(a);
+      ++a;
+    } else
+    {
+      mergedT[k] = t.at(j);
+      mergedKeys[k] = keys.at(j);
+      mergedValues[k] = values.at(j);
+      ++b;
+    }
+    ++k;
+  }
+  mT = mergedT;
+  mKeys = mergedKeys;
+  mValues = mergedValues;
+  mBegin = 0;
+  evict();
+}
+
+/*! \overload
+
+  Adds a single point with the specified \a t, \a key and \a value. Appending at the end is
+  amortized constant time (also when the capacity is reached and the oldest point is evicted),
+  inserting in between has to move the points behind it.
+*/
+void QCPCurveDataArray::add(double t, double key, double value)
+{
+  if (qIsNaN(t))
+    return;
+  if (isEmpty() || t >= this->t(size()-1))
+  {
+    mT.append(t);
+    mKeys.append(key);
+    mValues.append(value);
+  } else
+  {
+    const int index = mBegin+lowerBoundIndex(t);
+    mT.insert(index, t);
+    mKeys.insert(index, key);
+    mValues.insert(index, value);
+  }
+  evict();
+}
+
+/*!
+  Removes all data points with t smaller than \a t.
+*/
+void QCPCurveDataArray::removeBefore(double t)
+{
+  removePoints(0, lowerBoundIndex(t));
+}
+
+/*!
+  Removes all data points with t greater than \a t.
+*/
+void QCPCurveDataArray::removeAfter(double t)
+{
+  const int first = upperBoundIndex(t);
+  removePoints(first, size()-first);
+}
+
+/*!
+  Removes all data points with t greater than \a fromT and smaller or equal to \a toT. If \a fromT
+  is greater or equal to \a toT, the function does nothing.
+*/
+void QCPCurveDataArray::remove(double fromT, double toT)
+{
+  if (fromT >= toT)
+    return;
+  const int first = upperBoundIndex(fromT);
+  removePoints(first, upperBoundIndex(toT)-first);
+}
+
+/*! \overload
+
+  Removes all data points with a t equal to \a t.
+*/
+void QCPCurveDataArray::remove(double t)
+{
+  const int first = lowerBoundIndex(t);
+  removePoints(first, upperBoundIndex(t)-first);
+}
 
-/*! \class QCPCurveData
-  \brief Holds the data of one single data point for QCPCurve.
-  
-  The container for storing multiple data points is \ref QCPCurveDataMap.
-  
-  The stored data is:
-  \li \a t: the free parameter of the curve at this curve point (cp. the mathematical vector <em>(x(t), y(t))</em>)
-  \li \a key: coordinate on the key axis of this curve point
-  \li \a value: coordinate on the value axis of this curve point
-  
-  \see QCPCurveDataMap
+/*!
+  Removes all data points. The capacity is kept.
 */
+void QCPCurveDataArray::clear()
+{
+  mT.clear();
+  mKeys.clear();
+  mValues.clear();
+  mBegin = 0;
+}
 
 /*!
-  Constructs a curve data point with t, key and value set to zero.
+  Reserves memory for at least \a size data points.
 */
-QCPCurveData::QCPCurveData() :
-  t(0),
-  key(0),
-  value(0)
+void QCPCurveDataArray::reserve(int size)
 {
+  mT.reserve(mBegin+size);
+  mKeys.reserve(mBegin+size);
+  mValues.reserve(mBegin+size);
 }
 
 /*!
-  Constructs a curve data point with the specified \a t, \a key and \a value.
+  Releases memory that isn't needed to hold the current data points.
 */
-QCPCurveData::QCPCurveData(double t, double key, double value) :
-  t(t),
-  key(key),
-  value(value)
+void QCPCurveDataArray::squeeze()
+{
+  compact();
+  mT.squeeze();
+  mKeys.squeeze();
+  mValues.squeeze();
+}
+
+/*! \internal
+
+  Removes \a count points starting at index \a first. Points at the front are only skipped by
+  advancing \ref mBegin, see \ref compact.
+*/
+void QCPCurveDataArray::removePoints(int first, int count)
+{
+  if (count <= 0)
+    return;
+  if (first == 0)
+  {
+    mBegin += count;
+    if (mBegin >= size()) // the dead front is at least as large as the live data
+      compact();
+    return;
+  }
+  first += mBegin;
+  QVector<double> *columns[3] = {&mT, &mKeys, &mValues};
+  for (int c=0; c<3; ++c)
+  {
+    if (first+count == columns[c]->size())
+      columns[c]->resize(first);
+    else
+      columns[c]->remove(first, count);
+  }
+}
+
+/*! \internal
+
+  Moves the live points to the front of the columns, dropping the points that were removed from the
+  front before. The columns keep their allocated memory.
+*/
+void QCPCurveDataArray::compact()
+{
+  if (mBegin == 0)
+    return;
+  QVector<double> *columns[3] = {&mT, &mKeys, &mValues};
+  for (int c=0; c<3; ++c)
+  {
+    std::copy(columns[c]->begin()+mBegin, columns[c]->end(), columns[c]->begin());
+    columns[c]->resize(columns[c]->size()-mBegin);
+  }
+  mBegin = 0;
+}
+
+/*! \internal
+
+  Removes the points with the smallest t until the array holds no more than the capacity.
+*/
+void QCPCurveDataArray::evict()
 {
+  if (mCapacity > 0 && size() > mCapacity)
+    removePoints(0, size()-mCapacity);
 }
 
 
@@ -16773,6 +19957,10 @@ QCPCurveData::QCPCurveData(double t, double key, double value) :
 
   To plot data, assign it with the \ref setData or \ref addData functions.
   
+  Like QCPGraph, the curve can hold its points in contiguous columns instead of a map, see \ref
+  setDataStorage. With the array storage, \ref setDataCapacity makes the curve a ring buffer for
+  live data, e.g. a trajectory of which only the most recent points are shown.
+  
   \section appearance Changing the appearance
   
   The appearance of the curve is determined by the pen and the brush (\ref setPen, \ref setBrush).
@@ -16803,9 +19991,11 @@ QCPCurveData::QCPCurveData(double t, double key, double value) :
   then takes ownership of the graph.
 */
 QCPCurve::QCPCurve(QCPAxis *keyAxis, QCPAxis *valueAxis) :
-  QCPAbstractPlottable(keyAxis, valueAxis)
+  QCPAbstractPlottable(keyAxis, valueAxis),
+  mDataStorage(QCP::dsMap)
 {
   mData = new QCPCurveDataMap;
+  mDataArray = new QCPCurveDataArray;
   mPen.setColor(Qt::blue);
   mPen.setStyle(Qt::SolidLine);
   mBrush.setColor(Qt::blue);
@@ -16817,11 +20007,55 @@ QCPCurve::QCPCurve(QCPAxis *keyAxis, QCPAxis *valueAxis) :
   
   setScatterStyle(QCPScatterStyle());
   setLineStyle(lsLine);
+  setAdaptiveSampling(true);
+  mDataPrepared = false;
 }
 
 QCPCurve::~QCPCurve()
 {
   delete mData;
+  delete mDataArray;
+}
+
+/*!
+  Sets the container in which the curve holds its data points. The current data points are moved
+  to the new container.
+  
+  With \ref QCP::dsMap (the default), the data is held in the \ref QCPCurveDataMap returned by \ref
+  data. With \ref QCP::dsArray, it is held in the columns of the \ref QCPCurveDataArray returned by
+  \ref dataArray, sorted by t.
+*/
+void QCPCurve::setDataStorage(QCP::DataStorage storage)
+{
+  if (mDataStorage == storage)
+    return;
+  if (storage == QCP::dsArray)
+  {
+    mDataArray->set(*mData);
+    mData->clear();
+  } else
+  {
+    mData->clear();
+    for (int i=0; i<mDataArray->size(); ++i)
+      mData->insertMulti(mDataArray->t(i), mDataArray->at(i));
+    mDataArray->clear();
+  }
+  mDataStorage = storage;
+}
+
+/*!
+  Limits the number of data points the curve holds to \a capacity. Once the capacity is reached,
+  adding points removes the points with the smallest t. Appending a point is then amortized
+  constant time and doesn't allocate. Set \a capacity to 0 (the default) for no limit.
+  
+  Setting a non-zero capacity switches the data storage to \ref QCP::dsArray, see \ref
+  QCPGraph::setDataCapacity.
+*/
+void QCPCurve::setDataCapacity(int capacity)
+{
+  if (capacity > 0)
+    setDataStorage(QCP::dsArray);
+  mDataArray->setCapacity(capacity);
 }
 
 /*!
@@ -16838,6 +20072,13 @@ void QCPCurve::setData(QCPCurveDataMap *data, bool copy)
     qDebug() << Q_FUNC_INFO << "The data pointer is already in (and owned by) this plottable" << reinterpret_cast<quintptr>(data);
     return;
   }
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->set(*data);
+    if (!copy)
+      delete data;
+    return;
+  }
   if (copy)
   {
     *mData = *data;
@@ -16856,6 +20097,11 @@ void QCPCurve::setData(QCPCurveDataMap *data, bool copy)
 */
 void QCPCurve::setData(const QVector<double> &t, const QVector<double> &key, const QVector<double> &value)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->set(t, key, value);
+    return;
+  }
   mData->clear();
   int n = t.size();
   n = qMin(n, key.size());
@@ -16877,9 +20123,17 @@ void QCPCurve::setData(const QVector<double> &t, const QVector<double> &key, con
 */
 void QCPCurve::setData(const QVector<double> &key, const QVector<double> &value)
 {
-  mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
+  if (mDataStorage == QCP::dsArray)
+  {
+    QVector<double> t(n);
+    for (int i=0; i<n; ++i)
+      t[i] = i;
+    mDataArray->set(t, key, value);
+    return;
+  }
+  mData->clear();
   QCPCurveData newData;
   for (int i=0; i<n; ++i)
   {
@@ -16914,12 +20168,48 @@ void QCPCurve::setLineStyle(QCPCurve::LineStyle style)
   mLineStyle = style;
 }
 
+/*!
+  Sets whether the curve is decimated to the pixel grid before it is drawn.
+  
+  Parametric curves with many points often place long runs of consecutive points within the same
+  pixel. If adaptive sampling is enabled, only the first and last point of each such run are kept,
+  the points in between are skipped before the curve data is optimized for the visible region (see
+  \ref getCurveData). Since the skipped points lie in the same pixel as both of their kept
+  neighbours, the drawn line deviates from the original by less than a pixel, while the number of
+  points that are processed and drawn drops to roughly the number of pixels the curve passes
+  through.
+  
+  As with \ref QCPGraph::setAdaptiveSampling, scatter symbols of the skipped points aren't drawn.
+  They would have been drawn within a pixel of the kept ones. Disable adaptive sampling if every
+  single symbol is required, e.g. for an export at a larger scale.
+*/
+void QCPCurve::setAdaptiveSampling(bool enabled)
+{
+  mAdaptiveSampling = enabled;
+}
+
 /*!
   Adds the provided data points in \a dataMap to the current data.
   \see removeData
 */
 void QCPCurve::addData(const QCPCurveDataMap &dataMap)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    QVector<double> ts, keys, values;
+    ts.reserve(dataMap.size());
+    keys.reserve(dataMap.size());
+    values.reserve(dataMap.size());
+    QCPCurveDataMap::const_iterator it;
+    for (it = dataMap.constBegin(); it != dataMap.constEnd(); ++it)
+    {
+      ts.append(it.key());
+      keys.append(it.value().key);
+      values.append(it.value().value);
+    }
+    mDataArray->add(ts, keys, values);
+    return;
+  }
   mData->unite(dataMap);
 }
 
@@ -16929,7 +20219,10 @@ void QCPCurve::addData(const QCPCurveDataMap &dataMap)
 */
 void QCPCurve::addData(const QCPCurveData &data)
 {
-  mData->insertMulti(data.t, data);
+  if (mDataStorage == QCP::dsArray)
+    mDataArray->add(data.t, data.key, data.value);
+  else
+    mData->insertMulti(data.t, data);
 }
 
 /*! \overload
@@ -16938,6 +20231,11 @@ void QCPCurve::addData(const QCPCurveData &data)
 */
 void QCPCurve::addData(double t, double key, double value)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->add(t, key, value);
+    return;
+  }
   QCPCurveData newData;
   newData.t = t;
   newData.key = key;
@@ -16955,6 +20253,12 @@ void QCPCurve::addData(double t, double key, double value)
 */
 void QCPCurve::addData(double key, double value)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    const int n = mDataArray->size();
+    mDataArray->add(n > 0 ? mDataArray->t(n-1)+1 : 0, key, value);
+    return;
+  }
   QCPCurveData newData;
   if (!mData->isEmpty())
     newData.t = (mData->constEnd()-1).key()+1;
@@ -16971,6 +20275,11 @@ void QCPCurve::addData(double key, double value)
 */
 void QCPCurve::addData(const QVector<double> &ts, const QVector<double> &keys, const QVector<double> &values)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->add(ts, keys, values);
+    return;
+  }
   int n = ts.size();
   n = qMin(n, keys.size());
   n = qMin(n, values.size());
@@ -16990,6 +20299,11 @@ void QCPCurve::addData(const QVector<double> &ts, const QVector<double> &keys, c
 */
 void QCPCurve::removeDataBefore(double t)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->removeBefore(t);
+    return;
+  }
   QCPCurveDataMap::iterator it = mData->begin();
   while (it != mData->end() && it.key() < t)
     it = mData->erase(it);
@@ -17001,6 +20315,11 @@ void QCPCurve::removeDataBefore(double t)
 */
 void QCPCurve::removeDataAfter(double t)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->removeAfter(t);
+    return;
+  }
   if (mData->isEmpty()) return;
   QCPCurveDataMap::iterator it = mData->upperBound(t);
   while (it != mData->end())
@@ -17016,6 +20335,11 @@ void QCPCurve::removeDataAfter(double t)
 */
 void QCPCurve::removeData(double fromt, double tot)
 {
+  if (mDataStorage == QCP::dsArray)
+  {
+    mDataArray->remove(fromt, tot);
+    return;
+  }
   if (fromt >= tot || mData->isEmpty()) return;
   QCPCurveDataMap::iterator it = mData->upperBound(fromt);
   QCPCurveDataMap::iterator itEnd = mData->upperBound(tot);
@@ -17034,7 +20358,10 @@ void QCPCurve::removeData(double fromt, double tot)
 */
 void QCPCurve::removeData(double t)
 {
-  mData->remove(t);
+  if (mDataStorage == QCP::dsArray)
+    mDataArray->remove(t);
+  else
+    mData->remove(t);
 }
 
 /*!
@@ -17044,13 +20371,14 @@ void QCPCurve::removeData(double t)
 void QCPCurve::clearData()
 {
   mData->clear();
+  mDataArray->clear();
 }
 
 /* inherits documentation from base class */
 double QCPCurve::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const
 {
   Q_UNUSED(details)
-  if ((onlySelectable && !mSelectable) || mData->isEmpty())
+  if ((onlySelectable && !mSelectable) || dataCount() == 0)
     return -1;
   if (!mKeyAxis || !mValueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return -1; }
   
@@ -17063,13 +20391,18 @@ double QCPCurve::selectTest(const QPointF &pos, bool onlySelectable, QVariant *d
 /* inherits documentation from base class */
 void QCPCurve::draw(QCPPainter *painter)
 {
-  if (mData->isEmpty()) return;
+  if (dataCount() == 0) return;
   
   // allocate line vector:
   QVector<QPointF> *lineData = new QVector<QPointF>;
   
-  // fill with curve data:
-  getCurveData(lineData);
+  // fill with curve data, unless prepareDraw already did:
+  if (mDataPrepared)
+  {
+    lineData->swap(mPreparedLineData);
+    mDataPrepared = false;
+  } else
+    getCurveData(lineData);
   
   // check data validity if flag set:
 #ifdef QCUSTOMPLOT_CHECK_DATA
@@ -17103,15 +20436,19 @@ void QCPCurve::draw(QCPPainter *painter)
         !painter->modes().testFlag(QCPPainter::pmVectorized) &&
         !painter->modes().testFlag(QCPPainter::pmNoCaching))
     {
-      int i = 1;
-      int lineDataSize = lineData->size();
-      while (i < lineDataSize)
+      // thin lines on raster images are written directly into the pixels:
+      if (!painter->drawRasterPolyline(lineData->constData(), lineData->size()))
       {
-        if (!qIsNaN(lineData->at(i).y()) && !qIsNaN(lineData->at(i).x())) // NaNs create a gap in the line
-          painter->drawLine(lineData->at(i-1), lineData->at(i));
-        else
+        int i = 1;
+        int lineDataSize = lineData->size();
+        while (i < lineDataSize)
+        {
+          if (!qIsNaN(lineData->at(i).y()) && !qIsNaN(lineData->at(i).x())) // NaNs create a gap in the line
+            painter->drawLine(lineData->at(i-1), lineData->at(i));
+          else
+            ++i;
           ++i;
-        ++i;
+        }
       }
     } else
     {
@@ -17136,10 +20473,34 @@ void QCPCurve::draw(QCPPainter *painter)
   if (!mScatterStyle.isNone())
     drawScatterPlot(painter, lineData);
   
+  // pointDistance measures to the same line data, a single point is measured to directly:
+  if (dataCount() > 1)
+  {
+    double scatterSize = mScatterStyle.isNone() ? 0 : mScatterStyle.size();
+    if (mScatterStyle.shape() == QCPScatterStyle::ssPixmap)
+      scatterSize = qMax(mScatterStyle.pixmap().width(), mScatterStyle.pixmap().height());
+    setDrawnRect(*lineData, qMax(mainPen().widthF(), scatterSize)*0.5);
+  }
+  
   // free allocated line data:
   delete lineData;
 }
 
+/*! \internal
+  
+  Fills the curve pixel data the next \ref draw call paints. Runs on a worker thread if \ref
+  QCP::phParallelPreparation is set.
+*/
+void QCPCurve::prepareDraw()
+{
+  mDataPrepared = false;
+  mPreparedLineData.clear();
+  if (dataCount() == 0) return;
+  
+  getCurveData(&mPreparedLineData);
+  mDataPrepared = true;
+}
+
 /* inherits documentation from base class */
 void QCPCurve::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
 {
@@ -17185,9 +20546,12 @@ void QCPCurve::drawScatterPlot(QCPPainter *painter, const QVector<QPointF> *poin
   // draw scatter point symbols:
   applyScattersAntialiasingHint(painter);
   mScatterStyle.applyTo(painter, mPen);
+  QVector<QPointF> positions;
+  positions.reserve(pointData->size());
   for (int i=0; i<pointData->size(); ++i)
     if (!qIsNaN(pointData->at(i).x()) && !qIsNaN(pointData->at(i).y()))
-      mScatterStyle.drawShape(painter,  pointData->at(i));
+      positions.append(pointData->at(i));
+  mScatterStyle.drawShapes(painter, positions);
 }
 
 /*! \internal
@@ -17200,10 +20564,28 @@ void QCPCurve::drawScatterPlot(QCPPainter *painter, const QVector<QPointF> *poin
   regarding point count. The algorithm makes sure to preserve appearance of lines and fills inside
   the visible axis rect by generating new temporary points on the outer rect if necessary.
   
+  If adaptive sampling is enabled (\ref setAdaptiveSampling), points within the same pixel as both
+  their neighbours are skipped before the region handling, so it only sees the points that make a
+  visible difference.
+  
   Methods that are also involved in the algorithm are: \ref getRegion, \ref getOptimizedPoint, \ref
   getOptimizedCornerPoints \ref mayTraverse, \ref getTraverse, \ref getTraverseCornerPoints.
 */
 void QCPCurve::getCurveData(QVector<QPointF> *lineData) const
+{
+  if (mDataStorage == QCP::dsArray)
+    getCurveData(mDataArray, lineData);
+  else
+    getCurveData(mData, lineData);
+}
+
+/*! \internal
+  
+  Implementation of \ref getCurveData for both data containers, \a data is either \ref mData or
+  \ref mDataArray.
+*/
+template <class DataContainer>
+void QCPCurve::getCurveData(const DataContainer *data, QVector<QPointF> *lineData) const
 {
   QCPAxis *keyAxis = mKeyAxis.data();
   QCPAxis *valueAxis = mValueAxis.data();
@@ -17218,12 +20600,34 @@ void QCPCurve::getCurveData(QVector<QPointF> *lineData) const
   double rectBottom = valueAxis->pixelToCoord(valueAxis->coordToPixel(valueAxis->range().lower)+strokeMargin*((valueAxis->orientation()==Qt::Horizontal)!=valueAxis->rangeReversed()?-1:1));
   double rectTop = valueAxis->pixelToCoord(valueAxis->coordToPixel(valueAxis->range().upper)-strokeMargin*((valueAxis->orientation()==Qt::Horizontal)!=valueAxis->rangeReversed()?-1:1));
   int currentRegion;
-  QCPCurveDataMap::const_iterator it = mData->constBegin();
-  QCPCurveDataMap::const_iterator prevIt = mData->constEnd()-1;
+  typename DataContainer::const_iterator it = data->constBegin();
+  typename DataContainer::const_iterator prevIt = data->constEnd()-1;
   int prevRegion = getRegion(prevIt.value().key, prevIt.value().value, rectLeft, rectTop, rectRight, rectBottom);
   QVector<QPointF> trailingPoints; // points that must be applied after all other points (are generated only when handling first point to get virtual segment between last and first point right)
-  while (it != mData->constEnd())
-  {
+  // for adaptive sampling, the pixel cells of the previous, current and next point decide whether the current point is skipped:
+  const bool decimate = mAdaptiveSampling && data->size() > 2;
+  QPointF prevCell, currentCell, nextCell;
+  if (decimate)
+    currentCell = getPixelCell(it.value().key, it.value().value);
+  while (it != data->constEnd())
+  {
+    if (decimate)
+    {
+      typename DataContainer::const_iterator nextIt = it;
+      ++nextIt;
+      const bool hasNext = nextIt != data->constEnd();
+      nextCell = hasNext ? getPixelCell(nextIt.value().key, nextIt.value().value) : QPointF(qQNaN(), qQNaN());
+      // skip points in the middle of a run within the same pixel. First and last point are always kept,
+      // they form the virtual closing segment. prevIt/prevRegion stay at the last kept point:
+      const bool skip = it != data->constBegin() && hasNext && currentCell == prevCell && currentCell == nextCell;
+      prevCell = currentCell;
+      currentCell = nextCell;
+      if (skip)
+      {
+        ++it;
+        continue;
+      }
+    }
     currentRegion = getRegion(it.value().key, it.value().value, rectLeft, rectTop, rectRight, rectBottom);
     if (currentRegion != prevRegion) // changed region, possibly need to add some optimized edge points or original points if entering R
     {
@@ -17241,7 +20645,7 @@ void QCPCurve::getCurveData(QVector<QPointF> *lineData) const
           // add the two cross points optimized if segment crosses R and if segment isn't virtual zeroth segment between last and first curve point:
           QVector<QPointF> beforeTraverseCornerPoints, afterTraverseCornerPoints;
           getTraverseCornerPoints(prevRegion, currentRegion, rectLeft, rectTop, rectRight, rectBottom, beforeTraverseCornerPoints, afterTraverseCornerPoints);
-          if (it != mData->constBegin())
+          if (it != data->constBegin())
           {
             *lineData << beforeTraverseCornerPoints;
             lineData->append(crossA);
@@ -17259,7 +20663,7 @@ void QCPCurve::getCurveData(QVector<QPointF> *lineData) const
         }
       } else // segment does end in R, so we add previous point optimized and this point at original position
       {
-        if (it == mData->constBegin()) // it is first point in curve and prevIt is last one. So save optimized point for adding it to the lineData in the end
+        if (it == data->constBegin()) // it is first point in curve and prevIt is last one. So save optimized point for adding it to the lineData in the end
           trailingPoints << getOptimizedPoint(prevRegion, prevIt.value().key, prevIt.value().value, it.value().key, it.value().value, rectLeft, rectTop, rectRight, rectBottom);
         else
           lineData->append(getOptimizedPoint(prevRegion, prevIt.value().key, prevIt.value().value, it.value().key, it.value().value, rectLeft, rectTop, rectRight, rectBottom));
@@ -17282,6 +20686,20 @@ void QCPCurve::getCurveData(QVector<QPointF> *lineData) const
   *lineData << trailingPoints;
 }
 
+/*! \internal
+  
+  Returns the pixel that the point (\a key, \a value) falls into, as the floored pixel coordinates.
+  Used by the adaptive sampling in \ref getCurveData to find runs of points within the same pixel.
+  
+  The coordinates aren't converted to int, so points far outside the axis rect stay distinct. NaN
+  coordinates give a cell that compares unequal to any other, which keeps gaps in the curve.
+*/
+QPointF QCPCurve::getPixelCell(double key, double value) const
+{
+  const QPointF pixel = coordsToPixels(key, value);
+  return QPointF(floor(pixel.x()), floor(pixel.y()));
+}
+
 /*! \internal
   
   This function is part of the curve optimization algorithm of \ref getCurveData.
@@ -17899,14 +21317,16 @@ void QCPCurve::getTraverseCornerPoints(int prevRegion, int currentRegion, double
 */
 double QCPCurve::pointDistance(const QPointF &pixelPoint) const
 {
-  if (mData->isEmpty())
+  if (dataCount() == 0)
   {
     qDebug() << Q_FUNC_INFO << "requested point distance on curve" << mName << "without data";
     return 500;
   }
-  if (mData->size() == 1)
+  if (dataCount() == 1)
   {
-    QPointF dataPoint = coordsToPixels(mData->constBegin().key(), mData->constBegin().value().value);
+    QPointF dataPoint = mDataStorage == QCP::dsArray ?
+          coordsToPixels(mDataArray->t(0), mDataArray->value(0)) :
+          coordsToPixels(mData->constBegin().key(), mData->constBegin().value().value);
     return QVector2D(dataPoint-pixelPoint).length();
   }
   
@@ -17926,6 +21346,19 @@ double QCPCurve::pointDistance(const QPointF &pixelPoint) const
 
 /* inherits documentation from base class */
 QCPRange QCPCurve::getKeyRange(bool &foundRange, SignDomain inSignDomain) const
+{
+  if (mDataStorage == QCP::dsArray)
+    return getKeyRange(mDataArray, foundRange, inSignDomain);
+  return getKeyRange(mData, foundRange, inSignDomain);
+}
+
+/*! \internal
+  
+  Implementation of \ref getKeyRange for both data containers, \a data is either \ref mData or
+  \ref mDataArray.
+*/
+template <class DataContainer>
+QCPRange QCPCurve::getKeyRange(const DataContainer *data, bool &foundRange, SignDomain inSignDomain) const
 {
   QCPRange range;
   bool haveLower = false;
@@ -17933,8 +21366,8 @@ QCPRange QCPCurve::getKeyRange(bool &foundRange, SignDomain inSignDomain) const
   
   double current;
   
-  QCPCurveDataMap::const_iterator it = mData->constBegin();
-  while (it != mData->constEnd())
+  typename DataContainer::const_iterator it = data->constBegin();
+  while (it != data->constEnd())
   {
     current = it.value().key;
     if (inSignDomain == sdBoth || (inSignDomain == sdNegative && current < 0) || (inSignDomain == sdPositive && current > 0))
@@ -17959,6 +21392,19 @@ QCPRange QCPCurve::getKeyRange(bool &foundRange, SignDomain inSignDomain) const
 
 /* inherits documentation from base class */
 QCPRange QCPCurve::getValueRange(bool &foundRange, SignDomain inSignDomain) const
+{
+  if (mDataStorage == QCP::dsArray)
+    return getValueRange(mDataArray, foundRange, inSignDomain);
+  return getValueRange(mData, foundRange, inSignDomain);
+}
+
+/*! \internal
+  
+  Implementation of \ref getValueRange for both data containers, \a data is either \ref mData or
+  \ref mDataArray.
+*/
+template <class DataContainer>
+QCPRange QCPCurve::getValueRange(const DataContainer *data, bool &foundRange, SignDomain inSignDomain) const
 {
   QCPRange range;
   bool haveLower = false;
@@ -17966,8 +21412,8 @@ QCPRange QCPCurve::getValueRange(bool &foundRange, SignDomain inSignDomain) cons
   
   double current;
   
-  QCPCurveDataMap::const_iterator it = mData->constBegin();
-  while (it != mData->constEnd())
+  typename DataContainer::const_iterator it = data->constBegin();
+  while (it != data->constEnd())
   {
     current = it.value().value;
     if (inSignDomain == sdBoth || (inSignDomain == sdNegative && current < 0) || (inSignDomain == sdPositive && current > 0))
@@ -18424,6 +21870,17 @@ QCPBarData::QCPBarData(double key, double value) :
   \see barBelow, moveBelow, moveAbove
 */
 
+/*! \fn QCPBarDataMap *QCPBars::data() const
+  
+  Returns a pointer to the internal data storage of type \ref QCPBarDataMap. You may use it to
+  directly manipulate the data, which may be more convenient and faster than using the regular \ref
+  setData or \ref addData methods.
+  
+  The bars keep the stacked base values of their data points (see \ref moveAbove) until the data
+  changes through their own methods. After manipulating the data directly, call \ref
+  invalidateStackedBaseValues.
+*/
+
 /* end of documentation of inline functions */
 
 /*!
@@ -18441,7 +21898,8 @@ QCPBars::QCPBars(QCPAxis *keyAxis, QCPAxis *valueAxis) :
   mWidth(0.75),
   mWidthType(wtPlotCoords),
   mBarsGroup(0),
-  mBaseValue(0)
+  mBaseValue(0),
+  mStackValid(false)
 {
   // modify inherited properties from abstract plottable:
   mPen.setColor(Qt::blue);
@@ -18518,6 +21976,7 @@ void QCPBars::setBarsGroup(QCPBarsGroup *barsGroup)
 void QCPBars::setBaseValue(double baseValue)
 {
   mBaseValue = baseValue;
+  invalidateStackedBaseValues();
 }
 
 /*!
@@ -18542,6 +22001,7 @@ void QCPBars::setData(QCPBarDataMap *data, bool copy)
     delete mData;
     mData = data;
   }
+  invalidateStackedBaseValues();
 }
 
 /*! \overload
@@ -18562,6 +22022,7 @@ void QCPBars::setData(const QVector<double> &key, const QVector<double> &value)
     newData.value = value[i];
     mData->insertMulti(newData.key, newData);
   }
+  invalidateStackedBaseValues();
 }
 
 /*!
@@ -18637,6 +22098,7 @@ void QCPBars::moveAbove(QCPBars *bars)
 void QCPBars::addData(const QCPBarDataMap &dataMap)
 {
   mData->unite(dataMap);
+  invalidateStackedBaseValues();
 }
 
 /*! \overload
@@ -18646,6 +22108,7 @@ void QCPBars::addData(const QCPBarDataMap &dataMap)
 void QCPBars::addData(const QCPBarData &data)
 {
   mData->insertMulti(data.key, data);
+  invalidateStackedBaseValues();
 }
 
 /*! \overload
@@ -18658,6 +22121,7 @@ void QCPBars::addData(double key, double value)
   newData.key = key;
   newData.value = value;
   mData->insertMulti(newData.key, newData);
+  invalidateStackedBaseValues();
 }
 
 /*! \overload
@@ -18675,6 +22139,7 @@ void QCPBars::addData(const QVector<double> &keys, const QVector<double> &values
     newData.value = values[i];
     mData->insertMulti(newData.key, newData);
   }
+  invalidateStackedBaseValues();
 }
 
 /*!
@@ -18686,6 +22151,7 @@ void QCPBars::removeDataBefore(double key)
   QCPBarDataMap::iterator it = mData->begin();
   while (it != mData->end() && it.key() < key)
     it = mData->erase(it);
+  invalidateStackedBaseValues();
 }
 
 /*!
@@ -18698,6 +22164,7 @@ void QCPBars::removeDataAfter(double key)
   QCPBarDataMap::iterator it = mData->upperBound(key);
   while (it != mData->end())
     it = mData->erase(it);
+  invalidateStackedBaseValues();
 }
 
 /*!
@@ -18714,6 +22181,7 @@ void QCPBars::removeData(double fromKey, double toKey)
   QCPBarDataMap::iterator itEnd = mData->upperBound(toKey);
   while (it != itEnd)
     it = mData->erase(it);
+  invalidateStackedBaseValues();
 }
 
 /*! \overload
@@ -18727,6 +22195,22 @@ void QCPBars::removeData(double fromKey, double toKey)
 void QCPBars::removeData(double key)
 {
   mData->remove(key);
+  invalidateStackedBaseValues();
+}
+
+/*!
+  Discards the stacked base values this bars plottable and all bars stacked above it keep for their
+  data points, so they are recalculated when they are needed next.
+  
+  This happens automatically when the data is changed with methods like \ref setData, \ref addData
+  or \ref removeData, and when the stacking changes. Only call it after manipulating the data
+  directly via \ref data.
+*/
+void QCPBars::invalidateStackedBaseValues()
+{
+  // bars above a valid bar may be valid, above an invalid one they never are (see updateStackedBaseValues):
+  for (QCPBars *bars = this; bars && bars->mStackValid; bars = bars->mBarAbove.data())
+    bars->mStackValid = false;
 }
 
 /*!
@@ -18736,6 +22220,7 @@ void QCPBars::removeData(double key)
 void QCPBars::clearData()
 {
   mData->clear();
+  invalidateStackedBaseValues();
 }
 
 /* inherits documentation from base class */
@@ -18748,10 +22233,13 @@ double QCPBars::selectTest(const QPointF &pos, bool onlySelectable, QVariant *de
   
   if (mKeyAxis.data()->axisRect()->rect().contains(pos.toPoint()))
   {
+    updateStackedBaseValues();
     QCPBarDataMap::ConstIterator it;
-    for (it = mData->constBegin(); it != mData->constEnd(); ++it)
+    int index = 0;
+    for (it = mData->constBegin(); it != mData->constEnd(); ++it, ++index)
     {
-      if (getBarPolygon(it.value().key, it.value().value).boundingRect().contains(pos))
+      const double base = it.value().value >= 0 ? mStackPositiveBases.at(index) : mStackNegativeBases.at(index);
+      if (getBarPolygon(it.value().key, it.value().value, base).boundingRect().contains(pos))
         return mParentPlot->selectionTolerance()*0.99;
     }
   }
@@ -18764,16 +22252,20 @@ void QCPBars::draw(QCPPainter *painter)
   if (!mKeyAxis || !mValueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
   if (mData->isEmpty()) return;
   
+  updateStackedBaseValues();
   QCPBarDataMap::const_iterator it, lower, upperEnd;
   getVisibleDataBounds(lower, upperEnd);
-  for (it = lower; it != upperEnd; ++it)
+  // index of lower in the stack arrays, they hold the data points in the same order:
+  int index = lower == mData->constEnd() ? 0 : std::lower_bound(mStackKeys.constBegin(), mStackKeys.constEnd(), lower.key())-mStackKeys.constBegin();
+  for (it = lower; it != upperEnd; ++it, ++index)
   {
     // check data validity if flag set:
 #ifdef QCUSTOMPLOT_CHECK_DATA
     if (QCP::isInvalidData(it.value().key, it.value().value))
       qDebug() << Q_FUNC_INFO << "Data point at" << it.key() << "of drawn range invalid." << "Plottable name:" << name();
 #endif
-    QPolygonF barPolygon = getBarPolygon(it.key(), it.value().value);
+    const double base = it.value().value >= 0 ? mStackPositiveBases.at(index) : mStackNegativeBases.at(index);
+    QPolygonF barPolygon = getBarPolygon(it.key(), it.value().value, base);
     // draw bar fill:
     if (mainBrush().style() != Qt::NoBrush && mainBrush().color().alpha() != 0)
     {
@@ -18874,6 +22366,17 @@ void QCPBars::getVisibleDataBounds(QCPBarDataMap::const_iterator &lower, QCPBarD
   setBaseValue).
 */
 QPolygonF QCPBars::getBarPolygon(double key, double value) const
+{
+  return getBarPolygon(key, value, getStackedBaseValue(key, value >= 0));
+}
+
+/*! \internal
+  \overload
+  
+  Returns the polygon of a bar whose stacked base value \a base is already known, e.g. from the
+  stack arrays filled by \ref updateStackedBaseValues.
+*/
+QPolygonF QCPBars::getBarPolygon(double key, double value, double base) const
 {
   QCPAxis *keyAxis = mKeyAxis.data();
   QCPAxis *valueAxis = mValueAxis.data();
@@ -18882,7 +22385,6 @@ QPolygonF QCPBars::getBarPolygon(double key, double value) const
   QPolygonF result;
   double lowerPixelWidth, upperPixelWidth;
   getPixelWidth(key, lowerPixelWidth, upperPixelWidth);
-  double base = getStackedBaseValue(key, value >= 0);
   double basePixel = valueAxis->coordToPixel(base);
   double valuePixel = valueAxis->coordToPixel(base+value);
   double keyPixel = keyAxis->coordToPixel(key);
@@ -18958,37 +22460,90 @@ void QCPBars::getPixelWidth(double key, double &lower, double &upper) const
 
 /*! \internal
   
-  This function is called to find at which value to start drawing the base of a bar at \a key, when
-  it is stacked on top of another QCPBars (e.g. with \ref moveAbove).
+  This function is called to find at which value to start drawing the base of a bar at \a key,
+  when it is stacked on top of another QCPBars (e.g. with \ref moveAbove).
   
   positive and negative bars are separated per stack (positive are stacked above baseValue upwards,
   negative are stacked below baseValue downwards). This can be indicated with \a positive. So if the
   bar for which we need the base value is negative, set \a positive to false.
+  
+  The bars below are found with a binary search in the stack arrays of \ref mBarBelow, which
+  already hold the base values of its own data points (see \ref updateStackedBaseValues). So the
+  stack is only walked further down where \ref mBarBelow has no bar at \a key.
 */
 double QCPBars::getStackedBaseValue(double key, bool positive) const
 {
   if (mBarBelow)
   {
+    const QCPBars *below = mBarBelow.data();
+    below->updateStackedBaseValues();
     double max = 0; // don't use mBaseValue here because only base value of bottom-most bar has meaning in a bar stack
     // find bars of mBarBelow that are approximately at key and find largest one:
     double epsilon = qAbs(key)*1e-6; // should be safe even when changed to use float at some point
     if (key == 0)
       epsilon = 1e-6;
-    QCPBarDataMap::const_iterator it = mBarBelow.data()->mData->lowerBound(key-epsilon);
-    QCPBarDataMap::const_iterator itEnd = mBarBelow.data()->mData->upperBound(key+epsilon);
-    while (it != itEnd)
-    {
-      if ((positive && it.value().value > max) ||
-          (!positive && it.value().value < max))
-        max = it.value().value;
-      ++it;
-    }
-    // recurse down the bar-stack to find the total height:
-    return max + mBarBelow.data()->getStackedBaseValue(key, positive);
+    QVector<double>::const_iterator keysBegin = below->mStackKeys.constBegin();
+    int i = std::lower_bound(keysBegin, below->mStackKeys.constEnd(), key-epsilon)-keysBegin;
+    int iEnd = std::upper_bound(keysBegin, below->mStackKeys.constEnd(), key+epsilon)-keysBegin;
+    if (i == iEnd) // mBarBelow has no bar here, continue down the stack
+      return below->getStackedBaseValue(key, positive);
+    const double belowBase = positive ? below->mStackPositiveBases.at(i) : below->mStackNegativeBases.at(i);
+    for (; i<iEnd; ++i)
+    {
+      const double value = below->mStackValues.at(i);
+      if ((positive && value > max) ||
+          (!positive && value < max))
+        max = value;
+    }
+    return max + belowBase;
   } else
     return mBaseValue;
 }
 
+/*! \internal
+  
+  Fills the stack arrays \ref mStackKeys, \ref mStackValues, \ref mStackPositiveBases and \ref
+  mStackNegativeBases with the keys, values and stacked base values (for both signs) of all data
+  points, in the order of \ref mData. Does nothing if they are still valid.
+  
+  The arrays are recalculated only after the data of this bars plottable or of one below it changed,
+  or the stacking changed (see \ref invalidateStackedBaseValues). Drawing and the value range then
+  read the base of each bar in constant time, and the bars above look up their bases in these
+  arrays instead of walking the whole stack for every key. A bar above is only ever updated after
+  the bars below it, so if this bar is invalid, all bars above are invalid, too.
+*/
+void QCPBars::updateStackedBaseValues() const
+{
+  if (mStackValid && mStackKeys.size() == mData->size())
+    return;
+  if (mStackValid) // data was changed directly without invalidation, the bars above depend on it
+  {
+    for (QCPBars *bars = mBarAbove.data(); bars && bars->mStackValid; bars = bars->mBarAbove.data())
+      bars->mStackValid = false;
+  }
+  const int n = mData->size();
+  mStackKeys.resize(n);
+  mStackValues.resize(n);
+  mStackPositiveBases.resize(n);
+  mStackNegativeBases.resize(n);
+  int i = 0;
+  for (QCPBarDataMap::const_iterator it = mData->constBegin(); it != mData->constEnd(); ++it, ++i)
+  {
+    mStackKeys[i] = it.key();
+    mStackValues[i] = it.value().value;
+    if (i > 0 && mStackKeys.at(i) == mStackKeys.at(i-1)) // bars at the same key share their base
+    {
+      mStackPositiveBases[i] = mStackPositiveBases.at(i-1);
+      mStackNegativeBases[i] = mStackNegativeBases.at(i-1);
+    } else
+    {
+      mStackPositiveBases[i] = getStackedBaseValue(it.key(), true);
+      mStackNegativeBases[i] = getStackedBaseValue(it.key(), false);
+    }
+  }
+  mStackValid = true;
+}
+
 /*! \internal
 
   Connects \a below and \a above to each other via their mBarAbove/mBarBelow properties. The bar(s)
@@ -19001,6 +22556,12 @@ void QCPBars::connectBars(QCPBars *lower, QCPBars *upper)
 {
   if (!lower && !upper) return;
   
+  // the bars that get a different bar below them, and all bars above them, need new base values:
+  if (upper)
+    upper->invalidateStackedBaseValues();
+  if (lower && lower->mBarAbove)
+    lower->mBarAbove.data()->invalidateStackedBaseValues();
+  
   if (!lower) // disconnect upper at bottom
   {
     // disconnect old bar below upper:
@@ -19086,10 +22647,12 @@ QCPRange QCPBars::getValueRange(bool &foundRange, SignDomain inSignDomain) const
   bool haveUpper = true; // set to true, because baseValue should always be visible in bar charts
   double current;
   
+  updateStackedBaseValues();
   QCPBarDataMap::const_iterator it = mData->constBegin();
+  int index = 0;
   while (it != mData->constEnd())
   {
-    current = it.value().value + getStackedBaseValue(it.value().key, it.value().value >= 0);
+    current = it.value().value + (it.value().value >= 0 ? mStackPositiveBases.at(index) : mStackNegativeBases.at(index));
     if (inSignDomain == sdBoth || (inSignDomain == sdNegative && current < 0) || (inSignDomain == sdPositive && current > 0))
     {
       if (current < range.lower || !haveLower)
@@ -19104,6 +22667,7 @@ QCPRange QCPBars::getValueRange(bool &foundRange, SignDomain inSignDomain) const
       }
     }
     ++it;
+    ++index;
   }
   
   foundRange = true; // return true because bar charts always have the 0-line visible
@@ -21665,6 +25229,7 @@ void QCPItemLine::draw(QCPPainter *painter)
 {
   QVector2D startVec(start->pixelPoint());
   QVector2D endVec(end->pixelPoint());
+  setDrawnRect(QRectF(startVec.toPointF(), endVec.toPointF()), qMax(qMax(mHead.boundingDistance(), mTail.boundingDistance()), (double)mainPen().widthF()));
   if (startVec.toPoint() == endVec.toPoint())
     return;
   // get visible segment of straight line inside clipRect:
@@ -21925,6 +25490,7 @@ void QCPItemCurve::draw(QCPPainter *painter)
 
   QPainterPath cubicPath(startVec);
   cubicPath.cubicTo(startDirVec, endDirVec, endVec);
+  setDrawnRect(cubicPath.controlPointRect(), qMax(qMax(mHead.boundingDistance(), mTail.boundingDistance()), (double)mainPen().widthF())); // the curve never leaves its control polygon
 
   // paint visible segment, if existent:
   QRect clip = clipRect().adjusted(-mainPen().widthF(), -mainPen().widthF(), mainPen().widthF(), mainPen().widthF());
@@ -22054,6 +25620,7 @@ void QCPItemRect::draw(QCPPainter *painter)
 {
   QPointF p1 = topLeft->pixelPoint();
   QPointF p2 = bottomRight->pixelPoint();
+  setDrawnRect(QRectF(p1, p2), mainPen().widthF());
   if (p1.toPoint() == p2.toPoint())
     return;
   QRectF rect = QRectF(p1, p2).normalized();
@@ -22332,6 +25899,14 @@ void QCPItemText::draw(QCPPainter *painter)
   QPointF textPos = getTextDrawPoint(QPointF(0, 0), textBoxRect, mPositionAlignment); // 0, 0 because the transform does the translation
   textRect.moveTopLeft(textPos.toPoint()+QPoint(mPadding.left(), mPadding.top()));
   textBoxRect.moveTopLeft(textPos.toPoint());
+  if (mainFont() == mFont) // selectTest measures the text box with mFont, also when selected
+  {
+    QTransform pixelTransform; // without the painter's own transform, e.g. of an export scale
+    pixelTransform.translate(pos.x(), pos.y());
+    if (!qFuzzyIsNull(mRotation))
+      pixelTransform.rotate(mRotation);
+    setDrawnRect(pixelTransform.mapRect(QRectF(textBoxRect)), mainPen().widthF()+2); // +2: selectTest rounds the box position differently, glyphs may overhang
+  }
   double clipPad = mainPen().widthF();
   QRect boundingRect = textBoxRect.adjusted(-clipPad, -clipPad, clipPad, clipPad);
   if (transform.mapRect(boundingRect).intersects(painter->transform().mapRect(clipRect())))
@@ -22569,6 +26144,7 @@ void QCPItemEllipse::draw(QCPPainter *painter)
 {
   QPointF p1 = topLeft->pixelPoint();
   QPointF p2 = bottomRight->pixelPoint();
+  setDrawnRect(QRectF(p1, p2), mainPen().widthF());
   if (p1.toPoint() == p2.toPoint())
     return;
   QRectF ellipseRect = QRectF(p1, p2).normalized();
@@ -22738,6 +26314,7 @@ void QCPItemPixmap::draw(QCPPainter *painter)
   bool flipHorz = false;
   bool flipVert = false;
   QRect rect = getFinalRect(&flipHorz, &flipVert);
+  setDrawnRect(rect, mainPen().style() == Qt::NoPen ? 0 : mainPen().widthF());
   double clipPad = mainPen().style() == Qt::NoPen ? 0 : mainPen().widthF();
   QRect boundingRect = rect.adjusted(-clipPad, -clipPad, clipPad, clipPad);
   if (boundingRect.intersects(clipRect()))
@@ -23124,6 +26701,12 @@ void QCPItemTracer::draw(QCPPainter *painter)
   QPointF center(position->pixelPoint());
   double w = mSize/2.0;
   QRect clip = clipRect();
+  if (mStyle == tsCrosshair)
+  {
+    setDrawnRect(QRectF(clip.left(), center.y(), clip.width(), 0), mainPen().widthF());
+    addDrawnRect(QRectF(center.x(), clip.top(), 0, clip.height()), mainPen().widthF());
+  } else
+    setDrawnRect(QRectF(center-QPointF(w, w), center+QPointF(w, w)), mainPen().widthF());
   switch (mStyle)
   {
     case tsNone: return;
@@ -23177,46 +26760,60 @@ void QCPItemTracer::updatePosition()
   {
     if (mParentPlot->hasPlottable(mGraph))
     {
-      if (mGraph->data()->size() > 1)
+      if (mGraph->dataStorage() == QCP::dsArray)
+        updatePosition(mGraph->dataArray());
+      else
+        updatePosition(mGraph->data());
+    } else
+      qDebug() << Q_FUNC_INFO << "graph not contained in QCustomPlot instance (anymore)";
+  }
+}
+
+/*! \internal
+
+  Implementation of \ref updatePosition for both data containers of QCPGraph, \a data is either
+  the graph's \ref QCPGraph::data or \ref QCPGraph::dataArray.
+*/
+template <class DataContainer>
+void QCPItemTracer::updatePosition(const DataContainer *data)
+{
+  if (data->size() > 1)
+  {
+    typename DataContainer::const_iterator first = data->constBegin();
+    typename DataContainer::const_iterator last = data->constEnd()-1;
+    if (mGraphKey < first.key())
+      position->setCoords(first.key(), first.value().value);
+    else if (mGraphKey > last.key())
+      position->setCoords(last.key(), last.value().value);
+    else
+    {
+      typename DataContainer::const_iterator it = data->lowerBound(mGraphKey);
+      if (it != first) // mGraphKey is somewhere between iterators
       {
-        QCPDataMap::const_iterator first = mGraph->data()->constBegin();
-        QCPDataMap::const_iterator last = mGraph->data()->constEnd()-1;
-        if (mGraphKey < first.key())
-          position->setCoords(first.key(), first.value().value);
-        else if (mGraphKey > last.key())
-          position->setCoords(last.key(), last.value().value);
-        else
+        typename DataContainer::const_iterator prevIt = it-1;
+        if (mInterpolating)
         {
-          QCPDataMap::const_iterator it = mGraph->data()->lowerBound(mGraphKey);
-          if (it != first) // mGraphKey is somewhere between iterators
-          {
-            QCPDataMap::const_iterator prevIt = it-1;
-            if (mInterpolating)
-            {
-              // interpolate between iterators around mGraphKey:
-              double slope = 0;
-              if (!qFuzzyCompare((double)it.key(), (double)prevIt.key()))
-                slope = (it.value().value-prevIt.value().value)/(it.key()-prevIt.key());
-              position->setCoords(mGraphKey, (mGraphKey-prevIt.key())*slope+prevIt.value().value);
-            } else
-            {
-              // find iterator with key closest to mGraphKey:
-              if (mGraphKey < (prevIt.key()+it.key())*0.5)
-                it = prevIt;
-              position->setCoords(it.key(), it.value().value);
-            }
-          } else // mGraphKey is exactly on first iterator
-            position->setCoords(it.key(), it.value().value);
+          // interpolate between iterators around mGraphKey:
+          double slope = 0;
+          if (!qFuzzyCompare((double)it.key(), (double)prevIt.key()))
+            slope = (it.value().value-prevIt.value().value)/(it.key()-prevIt.key());
+          position->setCoords(mGraphKey, (mGraphKey-prevIt.key())*slope+prevIt.value().value);
+        } else
+        {
+          // find iterator with key closest to mGraphKey:
+          if (mGraphKey < (prevIt.key()+it.key())*0.5)
+            it = prevIt;
+          position->setCoords(it.key(), it.value().value);
         }
-      } else if (mGraph->data()->size() == 1)
-      {
-        QCPDataMap::const_iterator it = mGraph->data()->constBegin();
+      } else // mGraphKey is exactly on first iterator
         position->setCoords(it.key(), it.value().value);
-      } else
-        qDebug() << Q_FUNC_INFO << "graph has no data";
-    } else
-      qDebug() << Q_FUNC_INFO << "graph not contained in QCustomPlot instance (anymore)";
-  }
+    }
+  } else if (data->size() == 1)
+  {
+    typename DataContainer::const_iterator it = data->constBegin();
+    position->setCoords(it.key(), it.value().value);
+  } else
+    qDebug() << Q_FUNC_INFO << "graph has no data";
 }
 
 /*! \internal
@@ -33,6 +33,8 @@
 #include <QPaintEvent>
 #include <QMouseEvent>
 #include <QPixmap>
+#include <QImage>
+#include <QPicture>
 #include <QVector>
 #include <QString>
 #include <QDateTime>
@@ -43,8 +45,16 @@
 #include <QStack>
 #include <QCache>
 #include <QMargins>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QBitArray>
+#include <QTimer>
+#include <QElapsedTimer>
 #include <qmath.h>
 #include <limits>
+#include <algorithm>
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
 #  include <qnumeric.h>
 #  include <QPrinter>
@@ -52,6 +62,8 @@
 #else
 #  include <QtNumeric>
 #  include <QtPrintSupport>
+#  include <QWindow>
+#  include <QScreen>
 #endif
 
 class QCPPainter;
@@ -138,10 +150,14 @@ Q_DECLARE_FLAGS(AntialiasedElements, AntialiasedElement)
 */
 enum PlottingHint { phNone            = 0x000 ///< <tt>0x000</tt> No hints are set
                     ,phFastPolylines  = 0x001 ///< <tt>0x001</tt> Graph/Curve lines are drawn with a faster method. This reduces the quality
-                                              ///<                especially of the line segment joins. (Only relevant for solid line pens.)
+                                              ///<                especially of the line segment joins. (Only relevant for solid line pens.) Lines of width 0 or 1 on raster images
+                                              ///<                are written directly into the pixels, see \ref QCPPainter::drawRasterPolyline.
                     ,phForceRepaint   = 0x002 ///< <tt>0x002</tt> causes an immediate repaint() instead of a soft update() when QCustomPlot::replot() is called with parameter \ref QCustomPlot::rpHint.
                                               ///<                This is set by default to prevent the plot from freezing on fast consecutive replots (e.g. user drags ranges with mouse).
-                    ,phCacheLabels    = 0x004 ///< <tt>0x004</tt> axis (tick) labels will be cached as pixmaps, increasing replot performance.
+                    ,phCacheLabels    = 0x004 ///< <tt>0x004</tt> numeric axis tick labels are composed from pre-rendered glyphs that are shared by all axes of the plot, increasing
+                                              ///<                replot performance. Rotated labels and labels with other characters are drawn as text (see \ref QCPRenderStatistics::labelAtlasHits).
+                    ,phParallelPreparation = 0x008 ///< <tt>0x008</tt> the pixel data of the plottables is prepared concurrently on the global QThreadPool before painting (see \ref QCPAbstractPlottable::prepareDraw).
+                                              ///<                This is set by default.
                   };
 Q_DECLARE_FLAGS(PlottingHints, PlottingHint)
 
@@ -163,6 +179,16 @@ enum Interaction { iRangeDrag         = 0x001 ///< <tt>0x001</tt> Axis ranges ar
                  };
 Q_DECLARE_FLAGS(Interactions, Interaction)
 
+/*!
+  Defines the container in which a plottable holds its data points.
+
+  \see QCPGraph::setDataStorage
+*/
+enum DataStorage { dsMap   ///< Data points are nodes of a QMap (e.g. \ref QCPDataMap), keyed by their sort key. Cheap insertion at arbitrary keys.
+                   ,dsArray ///< Data points are held in contiguous, sorted key and value columns (e.g. \ref QCPDataArray). Far less memory per point,
+                            ///< sorted bulk loads in linear time and faster iteration when drawing.
+                 };
+
 /*! \internal
   
   Returns whether the specified \a value is considered an invalid data value for plottables (i.e.
@@ -293,6 +319,7 @@ public:
   void applyTo(QCPPainter *painter, const QPen &defaultPen) const;
   void drawShape(QCPPainter *painter, QPointF pos) const;
   void drawShape(QCPPainter *painter, double x, double y) const;
+  void drawShapes(QCPPainter *painter, const QVector<QPointF> &positions) const;
 
 protected:
   // property members:
@@ -305,6 +332,14 @@ protected:
   
   // non-property members:
   bool mPenDefined;
+  mutable QImage mStamp; // the shape rendered once by drawShapes, for mStampPen, mStampBrush and mStampAntialiased
+  mutable QPen mStampPen;
+  mutable QBrush mStampBrush;
+  mutable bool mStampAntialiased;
+  
+  // non-virtual methods:
+  bool canUseStamp(QCPPainter *painter) const;
+  int stampExtent(const QPen &pen) const;
 };
 Q_DECLARE_TYPEINFO(QCPScatterStyle, Q_MOVABLE_TYPE);
 
@@ -350,6 +385,7 @@ public:
   
   // non-virtual methods:
   void makeNonCosmetic();
+  bool drawRasterPolyline(const QPointF *points, int pointCount);
   
 protected:
   // property members:
@@ -358,6 +394,12 @@ protected:
   
   // non-property members:
   QStack<bool> mAntialiasingStack;
+  
+  // non-virtual methods:
+  bool clipRasterLine(const QRectF &clip, double &x0, double &y0, double &x1, double &y1) const;
+  void rasterizeLine(QRgb *bits, int stride, const QRect &clip, int x0, int y0, int x1, int y1, QRgb color, bool skipFirst) const;
+  void rasterizeAntialiasedLine(QRgb *bits, int stride, const QRect &clip, double x0, double y0, double x1, double y1, QRgb color) const;
+  void blendRasterPixel(QRgb *bits, int stride, const QRect &clip, int x, int y, QRgb color, int coverage) const;
 };
 Q_DECLARE_OPERATORS_FOR_FLAGS(QCPPainter::PainterModes)
 
@@ -371,8 +413,19 @@ class QCP_LIB_DECL QCPLayer : public QObject
   Q_PROPERTY(int index READ index)
   Q_PROPERTY(QList<QCPLayerable*> children READ children)
   Q_PROPERTY(bool visible READ visible WRITE setVisible)
+  Q_PROPERTY(LayerMode mode READ mode WRITE setMode)
   /// \endcond
 public:
+  /*!
+    Defines how the layer is rendered and cached during a replot.
+    
+    \see setMode, replot
+  */
+  enum LayerMode { lmLogical   ///< The layer only defines the rendering order. It shares its paint buffer with the neighbouring logical layers
+                   ,lmBuffered ///< The layer has a paint buffer of its own, so it can be replotted without redrawing the other layers, see \ref replot
+                 };
+  Q_ENUMS(LayerMode)
+  
   QCPLayer(QCustomPlot* parentPlot, const QString &layerName);
   ~QCPLayer();
   
@@ -382,9 +435,14 @@ public:
   int index() const { return mIndex; }
   QList<QCPLayerable*> children() const { return mChildren; }
   bool visible() const { return mVisible; }
+  LayerMode mode() const { return mMode; }
   
   // setters:
   void setVisible(bool visible);
+  void setMode(LayerMode mode);
+  
+  // non-property methods:
+  void replot();
   
 protected:
   // property members:
@@ -393,8 +451,14 @@ protected:
   int mIndex;
   QList<QCPLayerable*> mChildren;
   bool mVisible;
+  LayerMode mMode;
+  
+  // non-property members:
+  int mBufferIndex;
+  QRegion mDrawnRegion;
   
   // non-virtual methods:
+  void draw(QCPPainter *painter);
   void addChild(QCPLayerable *layerable, bool prepend);
   void removeChild(QCPLayerable *layerable);
   
@@ -425,6 +489,7 @@ public:
   QCPLayerable *parentLayerable() const { return mParentLayerable.data(); }
   QCPLayer *layer() const { return mLayer; }
   bool antialiased() const { return mAntialiased; }
+  QRect drawnRect() const { return mDrawnRegion.boundingRect(); }
   
   // setters:
   void setVisible(bool on);
@@ -449,6 +514,9 @@ protected:
   QCPLayer *mLayer;
   bool mAntialiased;
   
+  // non-property members:
+  QRegion mDrawnRegion;
+  
   // introduced virtual methods:
   virtual void parentPlotInitialized(QCustomPlot *parentPlot);
   virtual QCP::Interaction selectionCategory() const;
@@ -464,11 +532,15 @@ protected:
   void setParentLayerable(QCPLayerable* parentLayerable);
   bool moveToLayer(QCPLayer *layer, bool prepend);
   void applyAntialiasingHint(QCPPainter *painter, bool localAntialiased, QCP::AntialiasedElement overrideElement) const;
+  void setDrawnRect(const QRectF &rect, double margin=0);
+  void setDrawnRect(const QVector<QPointF> &points, double margin=0);
+  void addDrawnRect(const QRectF &rect, double margin=0);
   
 private:
   Q_DISABLE_COPY(QCPLayerable)
   
   friend class QCustomPlot;
+  friend class QCPLayer;
   friend class QCPAxisRect;
 };
 
@@ -1279,6 +1351,22 @@ protected:
   QVector<double> mSubTickVector;
   bool mCachedMarginValid;
   int mCachedMargin;
+  struct TickMemo // parameters of the last automatic tick setup, see setupTickVectors
+  {
+    bool valid;
+    QCPRange range;
+    ScaleType scaleType;
+    double scaleLogBase, tickStep;
+    int autoTickCount, subTickCount;
+    bool autoTickStep, autoSubTicks;
+    LabelType tickLabelType;
+    QString dateTimeFormat;
+    Qt::TimeSpec dateTimeSpec;
+    int numberPrecision;
+    char numberFormatChar;
+    QLocale locale;
+  };
+  TickMemo mTickMemo;
   
   // introduced virtual methods:
   virtual void setupTickVectors();
@@ -1296,6 +1384,9 @@ protected:
   
   // non-virtual methods:
   void visibleTickBounds(int &lowIndex, int &highIndex) const;
+  bool tickMemoHasSameTicks() const;
+  bool tickMemoHasSameLabels() const;
+  void updateTickMemo();
   double baseLog(double value) const;
   double basePow(double value) const;
   QPen getBasePen() const;
@@ -1318,6 +1409,34 @@ Q_DECLARE_OPERATORS_FOR_FLAGS(QCPAxis::AxisTypes)
 Q_DECLARE_METATYPE(QCPAxis::SelectablePart)
 
 
+class QCPLabelAtlas
+{
+public:
+  QCPLabelAtlas();
+  
+  bool measure(const QFont &font, const QString &text, QRect *bounds);
+  void draw(QCPPainter *painter, const QPointF &pos, const QFont &font, const QColor &color, const QString &text);
+  
+protected:
+  struct Glyph
+  {
+    int advance, left, width, x; // left and width of the cell relative to the pen position, x of the cell in the strip
+  };
+  struct GlyphSet
+  {
+    QVector<Glyph> glyphs; // in the order of mCharacters
+    int height, ascent, stripWidth;
+    QHash<QRgb, QPixmap> strips;
+  };
+  QString mCharacters;
+  QCache<QString, GlyphSet> mGlyphSets;
+  
+  bool contains(const QString &text) const;
+  GlyphSet *glyphSet(const QFont &font);
+  const QPixmap &strip(GlyphSet *glyphSet, const QFont &font, const QColor &color);
+};
+
+
 class QCPAxisPainterPrivate
 {
 public:
@@ -1326,7 +1445,6 @@ public:
   
   virtual void draw(QCPPainter *painter);
   virtual int size() const;
-  void clearCache();
   
   QRect axisSelectionBox() const { return mAxisSelectionBox; }
   QRect tickLabelsSelectionBox() const { return mTickLabelsSelectionBox; }
@@ -1359,27 +1477,20 @@ public:
   QVector<QString> tickLabels;
   
 protected:
-  struct CachedLabel
-  {
-    QPointF offset;
-    QPixmap pixmap;
-  };
   struct TickLabelData
   {
     QString basePart, expPart;
     QRect baseBounds, expBounds, totalBounds, rotatedTotalBounds;
     QFont baseFont, expFont;
+    bool composable; // bounds were measured with the label atlas of the parent plot, see drawComposedTickLabel
   };
   QCustomPlot *mParentPlot;
-  QByteArray mLabelParameterHash; // to determine whether mLabelCache needs to be cleared due to changed parameters
-  QCache<QString, CachedLabel> mLabelCache;
   QRect mAxisSelectionBox, mTickLabelsSelectionBox, mLabelSelectionBox;
   
-  virtual QByteArray generateLabelParameterHash() const;
-  
   virtual void placeTickLabel(QCPPainter *painter, double position, int distanceToAxis, const QString &text, QSize *tickLabelsSize);
   virtual void drawTickLabel(QCPPainter *painter, double x, double y, const TickLabelData &labelData) const;
-  virtual TickLabelData getTickLabelData(const QFont &font, const QString &text) const;
+  virtual void drawComposedTickLabel(QCPPainter *painter, double x, double y, const TickLabelData &labelData) const;
+  virtual TickLabelData getTickLabelData(const QFont &font, const QString &text, bool useAtlas) const;
   virtual QPointF getTickLabelDrawOffset(const TickLabelData &labelData) const;
   virtual void getMaxTickLabelSize(const QFont &font, const QString &text, QSize *tickLabelsSize) const;
 };
@@ -1478,6 +1589,7 @@ protected:
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const = 0;
   virtual QCPRange getKeyRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const = 0;
   virtual QCPRange getValueRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const = 0;
+  virtual void prepareDraw();
   
   // non-virtual methods:
   void coordsToPixels(double key, double value, double &x, double &y) const;
@@ -1497,6 +1609,7 @@ private:
   friend class QCustomPlot;
   friend class QCPAxis;
   friend class QCPPlottableLegendItem;
+  friend class QCPPlottablePreparation;
 };
 
 
@@ -1677,6 +1790,22 @@ private:
 };
 
 
+class QCP_LIB_DECL QCPRenderStatistics
+{
+public:
+  int frames, droppedFrames, coalescedRequests;
+  int labelAtlasHits, labelAtlasMisses;
+  int tickSetupsReused, tickLabelsReused, tickLabelsFormatted;
+  double lastFrameTime, maxFrameTime, totalFrameTime; // in milliseconds
+  
+  QCPRenderStatistics();
+  
+  double averageFrameTime() const { return frames > 0 ? totalFrameTime/frames : 0; }
+  void addFrame(double frameTime);
+};
+Q_DECLARE_TYPEINFO(QCPRenderStatistics, Q_MOVABLE_TYPE);
+
+
 class QCP_LIB_DECL QCustomPlot : public QWidget
 {
   Q_OBJECT
@@ -1690,6 +1819,7 @@ class QCP_LIB_DECL QCustomPlot : public QWidget
   Q_PROPERTY(int selectionTolerance READ selectionTolerance WRITE setSelectionTolerance)
   Q_PROPERTY(bool noAntialiasingOnDrag READ noAntialiasingOnDrag WRITE setNoAntialiasingOnDrag)
   Q_PROPERTY(Qt::KeyboardModifier multiSelectModifier READ multiSelectModifier WRITE setMultiSelectModifier)
+  Q_PROPERTY(bool asynchronousReplot READ asynchronousReplot WRITE setAsynchronousReplot)
   /// \endcond
 public:
   /*!
@@ -1710,6 +1840,7 @@ public:
   enum RefreshPriority { rpImmediate ///< The QCustomPlot surface is immediately refreshed, by calling QWidget::repaint() after the replot
                          ,rpQueued   ///< Queues the refresh such that it is performed at a slightly delayed point in time after the replot, by calling QWidget::update() after the replot
                          ,rpHint     ///< Whether to use immediate repaint or queued update depends on whether the plotting hint \ref QCP::phForceRepaint is set, see \ref setPlottingHints.
+                         ,rpQueuedReplot ///< Doesn't replot right away, but schedules the replot for the next display refresh. Further requests until then are merged into that replot.
                        };
   
   explicit QCustomPlot(QWidget *parent = 0);
@@ -1729,6 +1860,7 @@ public:
   bool noAntialiasingOnDrag() const { return mNoAntialiasingOnDrag; }
   QCP::PlottingHints plottingHints() const { return mPlottingHints; }
   Qt::KeyboardModifier multiSelectModifier() const { return mMultiSelectModifier; }
+  bool asynchronousReplot() const { return mAsynchronousReplot; }
 
   // setters:
   void setViewport(const QRect &rect);
@@ -1749,6 +1881,7 @@ public:
   void setPlottingHints(const QCP::PlottingHints &hints);
   void setPlottingHint(QCP::PlottingHint hint, bool enabled=true);
   void setMultiSelectModifier(Qt::KeyboardModifier modifier);
+  void setAsynchronousReplot(bool enabled);
   
   // non-property methods:
   // plottable interface:
@@ -1815,6 +1948,8 @@ public:
   QPixmap toPixmap(int width=0, int height=0, double scale=1.0);
   void toPainter(QCPPainter *painter, int width=0, int height=0);
   Q_SLOT void replot(QCustomPlot::RefreshPriority refreshPriority=QCustomPlot::rpHint);
+  QCPRenderStatistics renderStatistics() const { return mRenderStatistics; }
+  void resetRenderStatistics();
   
   QCPAxis *xAxis, *yAxis, *xAxis2, *yAxis2;
   QCPLegend *legend;
@@ -1862,12 +1997,24 @@ protected:
   QCPLayer *mCurrentLayer;
   QCP::PlottingHints mPlottingHints;
   Qt::KeyboardModifier mMultiSelectModifier;
+  bool mAsynchronousReplot;
   
   // non-property members:
-  QPixmap mPaintBuffer;
+  QImage mPaintBuffer;
+  QList<QImage> mLayerBuffers;
+  QVector<double> mLayerBufferGeometry;
+  bool mLayerBuffersValid;
   QPoint mMousePressPos;
   QPointer<QCPLayoutElement> mMouseEventElement;
   bool mReplotting;
+  QImage mAsyncFrame; // last frame finished by the worker thread, see setAsynchronousReplot
+  QThreadPool mAsyncPool;
+  bool mAsyncReplotRunning, mAsyncReplotPending;
+  QElapsedTimer mAsyncFrameClock;
+  QTimer mReplotTimer; // fires the replot scheduled with rpQueuedReplot
+  QElapsedTimer mFrameClock; // started at the beginning of each replot
+  QCPRenderStatistics mRenderStatistics;
+  QCPLabelAtlas mLabelAtlas; // glyphs of the tick labels, shared by all axes
   
   // reimplemented virtual methods:
   virtual QSize minimumSizeHint() const;
@@ -1888,12 +2035,23 @@ protected:
   // non-virtual methods:
   void updateLayerIndices() const;
   QCPLayerable *layerableAt(const QPointF &pos, bool onlySelectable, QVariant *selectionDetails=0) const;
+  void updateLayout();
+  void preparePlottables(const QList<QCPLayer*> &layers);
   void drawBackground(QCPPainter *painter);
+  bool hasBufferedLayers() const;
+  void setupLayerBuffers();
+  bool drawLayerBuffers();
+  bool composeLayerBuffers(const QRegion &region);
+  QVector<double> layerBufferGeometry() const;
+  bool startAsyncReplot();
+  Q_SLOT void finishAsyncReplot(const QImage &frame);
+  int frameInterval() const;
   
   friend class QCPLegend;
   friend class QCPAxis;
   friend class QCPLayer;
   friend class QCPAxisRect;
+  friend class QCPAxisPainterPrivate;
 };
 
 
@@ -2487,6 +2645,109 @@ typedef QMapIterator<double, QCPData> QCPDataMapIterator;
 typedef QMutableMapIterator<double, QCPData> QCPDataMutableMapIterator;
 
 
+class QCP_LIB_DECL QCPDataArray
+{
+  friend class QCPCurveDataArray;
+public:
+  class const_iterator
+  {
+  public:
+    const_iterator() : mArray(0), mIndex(0) {}
+    const_iterator(const QCPDataArray *array, int index) : mArray(array), mIndex(index) {}
+    double key() const { return mArray->key(mIndex); }
+    QCPData value() const { return mArray->at(mIndex); }
+    int index() const { return mIndex; }
+    const_iterator &operator++() { ++mIndex; return *this; }
+    const_iterator &operator--() { --mIndex; return *this; }
+    const_iterator operator+(int j) const { return const_iterator(mArray, mIndex+j); }
+    const_iterator operator-(int j) const { return const_iterator(mArray, mIndex-j); }
+    int operator-(const const_iterator &other) const { return mIndex-other.mIndex; }
+    bool operator==(const const_iterator &other) const { return mIndex == other.mIndex; }
+    bool operator!=(const const_iterator &other) const { return mIndex != other.mIndex; }
+  private:
+    const QCPDataArray *mArray;
+    int mIndex;
+  };
+
+  typedef void (*BufferDeleter)(double *buffer);
+  
+  QCPDataArray();
+
+  // getters:
+  int size() const { return mExternalKeys.isNull() ? mKeys.size()-mBegin : mExternalSize; }
+  int capacity() const { return mCapacity; }
+  bool isEmpty() const { return size() == 0; }
+  bool isExternal() const { return !mExternalKeys.isNull(); }
+  bool hasKeyErrors() const { return !mKeyErrorMinus.isEmpty(); }
+  bool hasValueErrors() const { return !mValueErrorMinus.isEmpty(); }
+  double key(int index) const { return keys()[index]; }
+  double value(int index) const { return values()[index]; }
+  QCPData at(int index) const;
+  const double *keys() const { return mExternalKeys.isNull() ? mKeys.constData()+mBegin : mExternalKeys.data(); }
+  const double *values() const { return mExternalKeys.isNull() ? mValues.constData()+mBegin : mExternalValues.data(); }
+  const_iterator constBegin() const { return const_iterator(this, 0); }
+  const_iterator constEnd() const { return const_iterator(this, size()); }
+  const_iterator lowerBound(double key) const { return const_iterator(this, lowerBoundIndex(key)); }
+  const_iterator upperBound(double key) const { return const_iterator(this, upperBoundIndex(key)); }
+  int lowerBoundIndex(double key) const;
+  int upperBoundIndex(double key) const;
+  QCPRange keyRange(bool &foundRange, QCPAbstractPlottable::SignDomain inSignDomain=QCPAbstractPlottable::sdBoth) const;
+  QCPRange valueRange(bool &foundRange, QCPAbstractPlottable::SignDomain inSignDomain=QCPAbstractPlottable::sdBoth) const;
+  QCPRange valueRange(bool &foundRange, QCPAbstractPlottable::SignDomain inSignDomain, const QCPRange &inKeyRange) const;
+  bool valueBounds(int from, int to, double &lower, double &upper, QCPAbstractPlottable::SignDomain inSignDomain=QCPAbstractPlottable::sdBoth) const;
+  
+  // setters:
+  void setCapacity(int capacity);
+
+  // non-property methods:
+  void set(const QVector<double> &keys, const QVector<double> &values);
+  void set(const QVector<double> &keys, const QVector<double> &values, const QVector<double> &keyErrorMinus, const QVector<double> &keyErrorPlus, const QVector<double> &valueErrorMinus, const QVector<double> &valueErrorPlus);
+  void set(const QCPDataMap &dataMap);
+  void adopt(double *keys, double *values, int count, BufferDeleter deleter=deleteBuffer);
+  static void deleteBuffer(double *buffer);
+  static void keepBuffer(double *buffer);
+  void add(const QVector<double> &keys, const QVector<double> &values);
+  void add(double key, double value);
+  void removeBefore(double key);
+  void removeAfter(double key);
+  void remove(double fromKey, double toKey);
+  void remove(double key);
+  void clear();
+  void reserve(int size);
+  void squeeze();
+
+protected:
+  // property members:
+  QVector<double> mKeys;
+  QVector<double> mValues;
+  QVector<double> mKeyErrorMinus, mKeyErrorPlus; // empty if the points have no key errors
+  QVector<double> mValueErrorMinus, mValueErrorPlus; // empty if the points have no value errors
+  QSharedPointer<double> mExternalKeys;
+  QSharedPointer<double> mExternalValues;
+  int mExternalSize;
+  int mBegin; // index of the first live point in the own columns, the points before it were removed
+  int mCapacity;
+  enum { pyramidBaseShift = 4 }; // level 0 of the pyramid has a bucket for every 2^pyramidBaseShift points
+  mutable QVector<QVector<double> > mPyramid; // bounds of the value buckets (see foldValue), per level
+  mutable int mPyramidPoints; // number of values the pyramid is up to date with
+
+  // non-virtual methods:
+  void removePoints(int first, int count);
+  void compact();
+  void evict();
+  void updatePyramid() const;
+  static void foldValue(double *bounds, double value);
+  static void foldBounds(double *bounds, const double *other);
+  void resizeErrors();
+  void detach();
+  void releaseExternal();
+  static QVector<double> leading(const QVector<double> &column, int count);
+  static QVector<double> gathered(const QVector<double> &column, const QVector<int> &order);
+  static bool isSorted(const double *keys, int count);
+  static QVector<int> sortedOrder(const double *keys, int count);
+};
+
+
 class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable
 {
   Q_OBJECT
@@ -2530,6 +2791,10 @@ public:
   
   // getters:
   QCPDataMap *data() const { return mData; }
+  QCPDataArray *dataArray() const { return mDataArray; }
+  QCP::DataStorage dataStorage() const { return mDataStorage; }
+  int dataCount() const { return mDataStorage == QCP::dsArray ? mDataArray->size() : mData->size(); }
+  int dataCapacity() const { return mDataArray->capacity(); }
   LineStyle lineStyle() const { return mLineStyle; }
   QCPScatterStyle scatterStyle() const { return mScatterStyle; }
   ErrorType errorType() const { return mErrorType; }
@@ -2540,8 +2805,11 @@ public:
   bool adaptiveSampling() const { return mAdaptiveSampling; }
   
   // setters:
+  void setDataStorage(QCP::DataStorage storage);
+  void setDataCapacity(int capacity);
   void setData(QCPDataMap *data, bool copy=false);
   void setData(const QVector<double> &key, const QVector<double> &value);
+  void setData(double *key, double *value, int count, QCPDataArray::BufferDeleter deleter=QCPDataArray::deleteBuffer);
   void setDataKeyError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyError);
   void setDataKeyError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyErrorMinus, const QVector<double> &keyErrorPlus);
   void setDataValueError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &valueError);
@@ -2575,11 +2843,13 @@ public:
   using QCPAbstractPlottable::rescaleValueAxis;
   void rescaleAxes(bool onlyEnlarge, bool includeErrorBars) const; // overloads base class interface
   void rescaleKeyAxis(bool onlyEnlarge, bool includeErrorBars) const; // overloads base class interface
-  void rescaleValueAxis(bool onlyEnlarge, bool includeErrorBars) const; // overloads base class interface
+  void rescaleValueAxis(bool onlyEnlarge, bool includeErrorBars, bool inKeyRange=false) const; // overloads base class interface
   
 protected:
   // property members:
   QCPDataMap *mData;
+  QCPDataArray *mDataArray;
+  QCP::DataStorage mDataStorage;
   QPen mErrorPen;
   LineStyle mLineStyle;
   QCPScatterStyle mScatterStyle;
@@ -2589,13 +2859,28 @@ protected:
   QPointer<QCPGraph> mChannelFillGraph;
   bool mAdaptiveSampling;
   
+  // non-property members:
+  QVector<QPointF> mHitPoints; // pixel representation drawn in the last replot, see updateHitIndex
+  QVector<int> mHitColumnStart; // empty if there is no valid hit index
+  QVector<int> mHitSegments;
+  int mHitFirstColumn;
+  bool mHitHorizontal; // whether the key axis, along which the columns are counted, is horizontal
+  LineStyle mHitLineStyle;
+  QCPRange mHitKeyRange, mHitValueRange;
+  QRect mHitAxisRect;
+  QVector<QPointF> mPreparedLineData; // filled by prepareDraw, consumed by the next draw
+  QVector<QCPData> mPreparedScatterData;
+  bool mDataPrepared;
+  
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter);
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const;
   virtual QCPRange getKeyRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const;
   virtual QCPRange getValueRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const;
+  virtual void prepareDraw();
   virtual QCPRange getKeyRange(bool &foundRange, SignDomain inSignDomain, bool includeErrors) const; // overloads base class interface
   virtual QCPRange getValueRange(bool &foundRange, SignDomain inSignDomain, bool includeErrors) const; // overloads base class interface
+  QCPRange getValueRange(bool &foundRange, SignDomain inSignDomain, bool includeErrors, const QCPRange &inKeyRange) const;
   
   // introduced virtual methods:
   virtual void drawFill(QCPPainter *painter, QVector<QPointF> *lineData) const;
@@ -2605,6 +2890,12 @@ protected:
   
   // non-virtual methods:
   void getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *scatterData) const;
+  template <class DataContainer>
+  void getPreparedData(const DataContainer *data, QVector<QCPData> *lineData, QVector<QCPData> *scatterData) const;
+  template <class DataContainer>
+  QCPRange getKeyRange(const DataContainer *data, bool &foundRange, SignDomain inSignDomain, bool includeErrors) const;
+  template <class DataContainer>
+  QCPRange getValueRange(const DataContainer *data, bool &foundRange, SignDomain inSignDomain, bool includeErrors, const QCPRange *inKeyRange) const;
   void getPlotData(QVector<QPointF> *lineData, QVector<QCPData> *scatterData) const;
   void getScatterPlotData(QVector<QCPData> *scatterData) const;
   void getLinePlotData(QVector<QPointF> *linePixelData, QVector<QCPData> *scatterData) const;
@@ -2612,9 +2903,15 @@ protected:
   void getStepRightPlotData(QVector<QPointF> *linePixelData, QVector<QCPData> *scatterData) const;
   void getStepCenterPlotData(QVector<QPointF> *linePixelData, QVector<QCPData> *scatterData) const;
   void getImpulsePlotData(QVector<QPointF> *linePixelData, QVector<QCPData> *scatterData) const;
+  void clipLineData(QVector<QPointF> *lineData) const;
+  void clipLineDataEdge(const QVector<QPointF> &input, QVector<QPointF> *output, bool clipX, double bound, bool keepGreater) const;
   void drawError(QCPPainter *painter, double x, double y, const QCPData &data) const;
   void getVisibleDataBounds(QCPDataMap::const_iterator &lower, QCPDataMap::const_iterator &upper) const;
+  void getVisibleDataBounds(QCPDataArray::const_iterator &lower, QCPDataArray::const_iterator &upper) const;
   int countDataInBounds(const QCPDataMap::const_iterator &lower, const QCPDataMap::const_iterator &upper, int maxCount) const;
+  int countDataInBounds(const QCPDataArray::const_iterator &lower, const QCPDataArray::const_iterator &upper, int maxCount) const;
+  void getAdaptiveLineData(const QCPDataMap::const_iterator &lower, const QCPDataMap::const_iterator &upper, QVector<QCPData> *lineData) const;
+  void getAdaptiveLineData(const QCPDataArray::const_iterator &lower, const QCPDataArray::const_iterator &upper, QVector<QCPData> *lineData) const;
   void addFillBasePoints(QVector<QPointF> *lineData) const;
   void removeFillBasePoints(QVector<QPointF> *lineData) const;
   QPointF lowerFillBasePoint(double lowerKey) const;
@@ -2625,6 +2922,11 @@ protected:
   int findIndexBelowY(const QVector<QPointF> *data, double y) const;
   int findIndexAboveY(const QVector<QPointF> *data, double y) const;
   double pointDistance(const QPointF &pixelPoint) const;
+  void updateHitIndex(QVector<QPointF> *pixelData, bool pairwise);
+  bool hitColumns(int segment, int &first, int &last) const;
+  int hitSegmentEnd(int segment) const;
+  double hitIndexDistance(const QPointF &pixelPoint) const;
+  bool hitIndexValid() const;
   
   friend class QCustomPlot;
   friend class QCPLegend;
@@ -2657,12 +2959,82 @@ typedef QMapIterator<double, QCPCurveData> QCPCurveDataMapIterator;
 typedef QMutableMapIterator<double, QCPCurveData> QCPCurveDataMutableMapIterator;
 
 
+class QCP_LIB_DECL QCPCurveDataArray
+{
+public:
+  class const_iterator
+  {
+  public:
+    const_iterator() : mArray(0), mIndex(0) {}
+    const_iterator(const QCPCurveDataArray *array, int index) : mArray(array), mIndex(index) {}
+    double key() const { return mArray->t(mIndex); }
+    QCPCurveData value() const { return mArray->at(mIndex); }
+    int index() const { return mIndex; }
+    const_iterator &operator++() { ++mIndex; return *this; }
+    const_iterator &operator--() { --mIndex; return *this; }
+    const_iterator operator+(int j) const { return const_iterator(mArray, mIndex+j); }
+    const_iterator operator-(int j) const { return const_iterator(mArray, mIndex-j); }
+    int operator-(const const_iterator &other) const { return mIndex-other.mIndex; }
+    bool operator==(const const_iterator &other) const { return mIndex == other.mIndex; }
+    bool operator!=(const const_iterator &other) const { return mIndex != other.mIndex; }
+  private:
+    const QCPCurveDataArray *mArray;
+    int mIndex;
+  };
+  
+  QCPCurveDataArray();
+  
+  // getters:
+  int size() const { return mT.size()-mBegin; }
+  bool isEmpty() const { return size() == 0; }
+  int capacity() const { return mCapacity; }
+  double t(int index) const { return mT.constData()[mBegin+index]; }
+  double key(int index) const { return mKeys.constData()[mBegin+index]; }
+  double value(int index) const { return mValues.constData()[mBegin+index]; }
+  QCPCurveData at(int index) const { return QCPCurveData(t(index), key(index), value(index)); }
+  const_iterator constBegin() const { return const_iterator(this, 0); }
+  const_iterator constEnd() const { return const_iterator(this, size()); }
+  int lowerBoundIndex(double t) const;
+  int upperBoundIndex(double t) const;
+  
+  // setters:
+  void setCapacity(int capacity);
+  
+  // non-property methods:
+  void set(const QVector<double> &t, const QVector<double> &keys, const QVector<double> &values);
+  void set(const QCPCurveDataMap &dataMap);
+  void add(const QVector<double> &t, const QVector<double> &keys, const QVector<double> &values);
+  void add(double t, double key, double value);
+  void removeBefore(double t);
+  void removeAfter(double t);
+  void remove(double fromT, double toT);
+  void remove(double t);
+  void clear();
+  void reserve(int size);
+  void squeeze();
+  
+protected:
+  // property members:
+  QVector<double> mT;
+  QVector<double> mKeys;
+  QVector<double> mValues;
+  int mBegin; // index of the first live point, the points before it were removed
+  int mCapacity;
+  
+  // non-virtual methods:
+  void removePoints(int first, int count);
+  void compact();
+  void evict();
+};
+
+
 class QCP_LIB_DECL QCPCurve : public QCPAbstractPlottable
 {
   Q_OBJECT
   /// \cond INCLUDE_QPROPERTIES
   Q_PROPERTY(QCPScatterStyle scatterStyle READ scatterStyle WRITE setScatterStyle)
   Q_PROPERTY(LineStyle lineStyle READ lineStyle WRITE setLineStyle)
+  Q_PROPERTY(bool adaptiveSampling READ adaptiveSampling WRITE setAdaptiveSampling)
   /// \endcond
 public:
   /*!
@@ -2678,15 +3050,23 @@ public:
   
   // getters:
   QCPCurveDataMap *data() const { return mData; }
+  QCPCurveDataArray *dataArray() const { return mDataArray; }
+  QCP::DataStorage dataStorage() const { return mDataStorage; }
+  int dataCount() const { return mDataStorage == QCP::dsArray ? mDataArray->size() : mData->size(); }
+  int dataCapacity() const { return mDataArray->capacity(); }
   QCPScatterStyle scatterStyle() const { return mScatterStyle; }
   LineStyle lineStyle() const { return mLineStyle; }
+  bool adaptiveSampling() const { return mAdaptiveSampling; }
   
   // setters:
+  void setDataStorage(QCP::DataStorage storage);
+  void setDataCapacity(int capacity);
   void setData(QCPCurveDataMap *data, bool copy=false);
   void setData(const QVector<double> &t, const QVector<double> &key, const QVector<double> &value);
   void setData(const QVector<double> &key, const QVector<double> &value);
   void setScatterStyle(const QCPScatterStyle &style);
   void setLineStyle(LineStyle style);
+  void setAdaptiveSampling(bool enabled);
   
   // non-property methods:
   void addData(const QCPCurveDataMap &dataMap);
@@ -2706,20 +3086,35 @@ public:
 protected:
   // property members:
   QCPCurveDataMap *mData;
+  QCPCurveDataArray *mDataArray;
+  QCP::DataStorage mDataStorage;
   QCPScatterStyle mScatterStyle;
   LineStyle mLineStyle;
+  bool mAdaptiveSampling;
+  
+  // non-property members:
+  QVector<QPointF> mPreparedLineData; // filled by prepareDraw, consumed by the next draw
+  bool mDataPrepared;
   
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter);
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const;
   virtual QCPRange getKeyRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const;
   virtual QCPRange getValueRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const;
+  virtual void prepareDraw();
   
   // introduced virtual methods:
   virtual void drawScatterPlot(QCPPainter *painter, const QVector<QPointF> *pointData) const;
   
   // non-virtual methods:
   void getCurveData(QVector<QPointF> *lineData) const;
+  template <class DataContainer>
+  void getCurveData(const DataContainer *data, QVector<QPointF> *lineData) const;
+  template <class DataContainer>
+  QCPRange getKeyRange(const DataContainer *data, bool &foundRange, SignDomain inSignDomain) const;
+  template <class DataContainer>
+  QCPRange getValueRange(const DataContainer *data, bool &foundRange, SignDomain inSignDomain) const;
+  QPointF getPixelCell(double key, double value) const;
   int getRegion(double x, double y, double rectLeft, double rectTop, double rectRight, double rectBottom) const;
   QPointF getOptimizedPoint(int prevRegion, double prevKey, double prevValue, double key, double value, double rectLeft, double rectTop, double rectRight, double rectBottom) const;
   QVector<QPointF> getOptimizedCornerPoints(int prevRegion, int currentRegion, double prevKey, double prevValue, double key, double value, double rectLeft, double rectTop, double rectRight, double rectBottom) const;
@@ -2875,6 +3270,7 @@ public:
   void removeDataAfter(double key);
   void removeData(double fromKey, double toKey);
   void removeData(double key);
+  void invalidateStackedBaseValues();
   
   // reimplemented virtual methods:
   virtual void clearData();
@@ -2889,6 +3285,10 @@ protected:
   double mBaseValue;
   QPointer<QCPBars> mBarBelow, mBarAbove;
   
+  // non-property members:
+  mutable QVector<double> mStackKeys, mStackValues, mStackPositiveBases, mStackNegativeBases;
+  mutable bool mStackValid;
+  
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter);
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const;
@@ -2898,8 +3298,10 @@ protected:
   // non-virtual methods:
   void getVisibleDataBounds(QCPBarDataMap::const_iterator &lower, QCPBarDataMap::const_iterator &upperEnd) const;
   QPolygonF getBarPolygon(double key, double value) const;
+  QPolygonF getBarPolygon(double key, double value, double base) const;
   void getPixelWidth(double key, double &lower, double &upper) const;
   double getStackedBaseValue(double key, bool positive) const;
+  void updateStackedBaseValues() const;
   static void connectBars(QCPBars* lower, QCPBars* upper);
   
   friend class QCustomPlot;
@@ -3707,6 +4109,8 @@ protected:
   // non-virtual methods:
   QPen mainPen() const;
   QBrush mainBrush() const;
+  template <class DataContainer>
+  void updatePosition(const DataContainer *data);
 };
 
 
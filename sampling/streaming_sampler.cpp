@@ -0,0 +1,425 @@
+#include "streaming_sampler.h"
+#include "../data_export/data_export_writer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifdef _WIN32
+#  define NOMINMAX
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+using namespace std;
+using namespace sampling;
+using data_export::ColumnWriter;
+using data_export::RawHeader;
+
+const char LodHeader::MAGIC[8] = {'F', 'P', 'L', 'T', 'L', 'O', 'D', '1'};
+
+static void put_le(unsigned char* bytes, uint64_t value, int size) {
+  for (int i = 0; i < size; i++) {
+    bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+  }
+}
+
+static uint64_t get_le(const unsigned char* bytes, int size) {
+  uint64_t value = 0;
+  for (int i = size - 1; i >= 0; i--) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+// Converts doubles in place between host and little-endian byte order
+static void swap_to_le(double* values, size_t count) {
+  if (ColumnWriter::host_is_little_endian()) return;
+  for (size_t i = 0; i < count; i++) {
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(values + i);
+    for (size_t b = 0; b < sizeof(double) / 2; b++) {
+      swap(bytes[b], bytes[sizeof(double) - 1 - b]);
+    }
+  }
+}
+
+// Merges value into the [min, max] interval, NaN samples are ignored
+static void expand(double& min, double& max, double value) {
+  if (value != value) return;
+  if (min != min || value < min) min = value;
+  if (max != max || value > max) max = value;
+}
+
+void LodHeader::encode(unsigned char* bytes) const {
+  memcpy(bytes, MAGIC, sizeof(MAGIC));
+  put_le(bytes + 8, SIZE, 4);
+  put_le(bytes + 12, base_shift, 4);
+  put_le(bytes + 16, samples, 8);
+  put_le(bytes + 24, levels, 4);
+  put_le(bytes + 28, 0, 4);
+}
+
+bool LodHeader::decode(const unsigned char* bytes) {
+  if (memcmp(bytes, MAGIC, sizeof(MAGIC)) != 0 || get_le(bytes + 8, 4) != SIZE) {
+    return false;
+  }
+  base_shift = static_cast<uint32_t>(get_le(bytes + 12, 4));
+  samples = get_le(bytes + 16, 8);
+  levels = static_cast<uint32_t>(get_le(bytes + 24, 4));
+  return base_shift < 64;
+}
+
+uint64_t LodHeader::bucket_count(int level) const {
+  const unsigned shift = base_shift + level;
+  if (samples == 0) return 0;
+  if (shift >= 64) return 1;
+  return ((samples - 1) >> shift) + 1;
+}
+
+uint64_t LodHeader::level_offset(int level) const {
+  uint64_t offset = SIZE;
+  for (int i = 0; i < level; i++) {
+    offset += bucket_count(i) * 2 * sizeof(double);
+  }
+  return offset;
+}
+
+/*
+  MappedFile
+ */
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+  : file_size(0), writable(false),
+    file_handle(INVALID_HANDLE_VALUE), mapping_handle(nullptr) {}
+
+static uint64_t allocation_granularity() {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwAllocationGranularity;
+}
+
+bool MappedFile::create(const string& path, uint64_t size) {
+  close();
+  file_handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+    FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER end;
+  end.QuadPart = static_cast<LONGLONG>(size);
+  if (!SetFilePointerEx(file_handle, end, nullptr, FILE_BEGIN) ||
+      !SetEndOfFile(file_handle)) {
+    close();
+    return false;
+  }
+  file_size = size;
+  writable = true;
+  if (size > 0) {
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READWRITE,
+      static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+    if (!mapping_handle) {
+      close();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MappedFile::open(const string& path) {
+  close();
+  file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_handle, &size)) {
+    close();
+    return false;
+  }
+  file_size = static_cast<uint64_t>(size.QuadPart);
+  writable = false;
+  if (file_size > 0) {
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_handle) {
+      close();
+      return false;
+    }
+  }
+  return true;
+}
+
+void MappedFile::close() {
+  if (mapping_handle) CloseHandle(mapping_handle);
+  if (file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+  mapping_handle = nullptr;
+  file_handle = INVALID_HANDLE_VALUE;
+  file_size = 0;
+}
+
+bool MappedFile::is_open() const {
+  return file_handle != INVALID_HANDLE_VALUE;
+}
+
+MappedFile::View MappedFile::map(uint64_t offset, size_t length) const {
+  View view;
+  if (!mapping_handle || length == 0 || offset + length > file_size) return view;
+  const uint64_t aligned = offset - offset % allocation_granularity();
+  view.base_length = static_cast<size_t>(offset - aligned) + length;
+  view.base = MapViewOfFile(mapping_handle, writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+    static_cast<DWORD>(aligned >> 32), static_cast<DWORD>(aligned), view.base_length);
+  if (view.base) {
+    view.data = static_cast<char*>(view.base) + (offset - aligned);
+  }
+  return view;
+}
+
+void MappedFile::unmap(View& view) {
+  if (view.base) UnmapViewOfFile(view.base);
+  view = View();
+}
+
+#else
+
+MappedFile::MappedFile() : file_size(0), writable(false), descriptor(-1) {}
+
+bool MappedFile::create(const string& path, uint64_t size) {
+  close();
+  descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (descriptor < 0) return false;
+  if (ftruncate(descriptor, static_cast<off_t>(size)) != 0) {
+    close();
+    return false;
+  }
+  file_size = size;
+  writable = true;
+  return true;
+}
+
+bool MappedFile::open(const string& path) {
+  close();
+  descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) return false;
+  struct stat status;
+  if (fstat(descriptor, &status) != 0) {
+    close();
+    return false;
+  }
+  file_size = static_cast<uint64_t>(status.st_size);
+  writable = false;
+  return true;
+}
+
+void MappedFile::close() {
+  if (descriptor >= 0) ::close(descriptor);
+  descriptor = -1;
+  file_size = 0;
+}
+
+bool MappedFile::is_open() const {
+  return descriptor >= 0;
+}
+
+MappedFile::View MappedFile::map(uint64_t offset, size_t length) const {
+  View view;
+  if (descriptor < 0 || length == 0 || offset + length > file_size) return view;
+  const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  const uint64_t aligned = offset - offset % page;
+  view.base_length = static_cast<size_t>(offset - aligned) + length;
+  void* base = mmap(nullptr, view.base_length,
+    writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+    descriptor, static_cast<off_t>(aligned));
+  if (base != MAP_FAILED) {
+    view.base = base;
+    view.data = static_cast<char*>(base) + (offset - aligned);
+  }
+  return view;
+}
+
+void MappedFile::unmap(View& view) {
+  if (view.base) munmap(view.base, view.base_length);
+  view = View();
+}
+
+#endif
+
+/*
+  StreamingSampler
+ */
+
+bool StreamingSampler::run(double lower, double upper, uint64_t samples,
+    const string& data_path, const string& pyramid_path) {
+  const uint64_t column_bytes = samples * sizeof(double);
+  MappedFile data_file;
+  if (!data_file.create(data_path, RawHeader::SIZE + 2 * column_bytes)) {
+    return false;
+  }
+  RawHeader raw_header;
+  raw_header.row_count = samples;
+  MappedFile::View header_view = data_file.map(0, RawHeader::SIZE);
+  if (!header_view.data) return false;
+  raw_header.encode(reinterpret_cast<unsigned char*>(header_view.data));
+  MappedFile::unmap(header_view);
+
+  pyramid_header = LodHeader();
+  pyramid_header.base_shift = base_shift;
+  pyramid_header.samples = samples;
+  while (pyramid_header.bucket_count(pyramid_header.levels) > 1) {
+    pyramid_header.levels++;
+  }
+  if (samples > 0) pyramid_header.levels++; // the single bucket level
+  if (!pyramid_file.create(pyramid_path,
+        pyramid_header.level_offset(pyramid_header.levels))) {
+    return false;
+  }
+  header_view = pyramid_file.map(0, LodHeader::SIZE);
+  if (!header_view.data) return false;
+  pyramid_header.encode(reinterpret_cast<unsigned char*>(header_view.data));
+  MappedFile::unmap(header_view);
+
+  const double nan = numeric_limits<double>::quiet_NaN();
+  levels.assign(pyramid_header.levels, Level());
+  for (Level& level : levels) {
+    level.flushed = 0;
+    level.min = level.max = nan;
+    level.filled = 0;
+  }
+  pyramid_ok = true;
+
+  const double step = samples > 0 ? (upper - lower) / samples : 0;
+  const uint64_t base_bucket = uint64_t(1) << base_shift;
+  bool ok = true;
+  for (uint64_t first = 0; first < samples && ok; first += chunk_size) {
+    const size_t count = static_cast<size_t>(
+      samples - first < chunk_size ? samples - first : chunk_size);
+    const uint64_t offset = RawHeader::SIZE + first * sizeof(double);
+    MappedFile::View x_view = data_file.map(offset, count * sizeof(double));
+    MappedFile::View y_view = data_file.map(offset + column_bytes, count * sizeof(double));
+    if (!x_view.data || !y_view.data) {
+      ok = false;
+    } else {
+      double* x = reinterpret_cast<double*>(x_view.data);
+      double* y = reinterpret_cast<double*>(y_view.data);
+      Level& finest = levels[0];
+      for (size_t i = 0; i < count; i++) {
+        x[i] = lower + (first + i) * step;
+        y[i] = function(x[i]);
+        expand(finest.min, finest.max, y[i]);
+        if (++finest.filled == base_bucket) {
+          push_bucket(0, finest.min, finest.max);
+          finest.min = finest.max = nan;
+          finest.filled = 0;
+        }
+      }
+      swap_to_le(x, count);
+      swap_to_le(y, count);
+    }
+    MappedFile::unmap(x_view);
+    MappedFile::unmap(y_view);
+  }
+
+  // Close the partial buckets, from the finest level to the coarsest
+  for (size_t i = 0; i < levels.size() && ok; i++) {
+    if (levels[i].filled > 0) {
+      push_bucket(i, levels[i].min, levels[i].max);
+      levels[i].filled = 0;
+    }
+    ok = flush(i);
+  }
+  ok = ok && pyramid_ok;
+  levels.clear();
+  pyramid_file.close();
+  return ok;
+}
+
+/*
+  Emits a finished bucket of the given level and merges it into the
+  pending bucket of the next one, two children make a parent bucket.
+ */
+void StreamingSampler::push_bucket(size_t level, double min, double max) {
+  Level& current = levels[level];
+  current.pending.push_back(min);
+  current.pending.push_back(max);
+  if (current.pending.size() >= 2 * 8192) {
+    pyramid_ok = flush(level) && pyramid_ok;
+  }
+  if (level + 1 < levels.size()) {
+    Level& parent = levels[level + 1];
+    expand(parent.min, parent.max, min);
+    expand(parent.min, parent.max, max);
+    if (++parent.filled == 2) {
+      const double nan = numeric_limits<double>::quiet_NaN();
+      const double parent_min = parent.min;
+      const double parent_max = parent.max;
+      parent.min = parent.max = nan;
+      parent.filled = 0;
+      push_bucket(level + 1, parent_min, parent_max);
+    }
+  }
+}
+
+bool StreamingSampler::flush(size_t level) {
+  Level& current = levels[level];
+  if (current.pending.empty()) return true;
+  const size_t pairs = current.pending.size() / 2;
+  const uint64_t offset = pyramid_header.level_offset(static_cast<int>(level)) +
+    current.flushed * 2 * sizeof(double);
+  MappedFile::View view = pyramid_file.map(offset, current.pending.size() * sizeof(double));
+  if (!view.data) return false;
+  swap_to_le(current.pending.data(), current.pending.size());
+  memcpy(view.data, current.pending.data(), current.pending.size() * sizeof(double));
+  MappedFile::unmap(view);
+  current.flushed += pairs;
+  current.pending.clear();
+  return true;
+}
+
+/*
+  LodPyramid
+ */
+
+bool LodPyramid::open(const string& path) {
+  header = LodHeader();
+  if (!file.open(path) || file.size() < LodHeader::SIZE) return false;
+  MappedFile::View view = file.map(0, LodHeader::SIZE);
+  const bool ok = view.data &&
+    header.decode(reinterpret_cast<const unsigned char*>(view.data)) &&
+    file.size() >= header.level_offset(header.levels);
+  MappedFile::unmap(view);
+  if (!ok) {
+    header = LodHeader();
+    file.close();
+  }
+  return ok;
+}
+
+int LodPyramid::level_for(uint64_t visible_samples, int pixels) const {
+  const uint64_t wanted = 2 * static_cast<uint64_t>(pixels > 0 ? pixels : 1);
+  for (int level = levels() - 1; level >= 0; level--) {
+    if (visible_samples / bucket_size(level) >= wanted) return level;
+  }
+  return levels() > 0 ? 0 : -1;
+}
+
+bool LodPyramid::read(int level, uint64_t first, size_t count,
+    double* min, double* max) const {
+  if (level < 0 || level >= levels() || first + count > bucket_count(level)) {
+    return false;
+  }
+  if (count == 0) return true;
+  const uint64_t offset = header.level_offset(level) + first * 2 * sizeof(double);
+  MappedFile::View view = file.map(offset, count * 2 * sizeof(double));
+  if (!view.data) return false;
+  const bool little_endian = ColumnWriter::host_is_little_endian();
+  for (size_t i = 0; i < count; i++) {
+    double pair[2];
+    memcpy(pair, view.data + i * sizeof(pair), sizeof(pair));
+    if (!little_endian) swap_to_le(pair, 2);
+    min[i] = pair[0];
+    max[i] = pair[1];
+  }
+  MappedFile::unmap(view);
+  return true;
+}
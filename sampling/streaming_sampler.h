@@ -0,0 +1,140 @@
+#ifndef STREAMING_SAMPLER_H
+#define STREAMING_SAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace sampling {
+  class MappedFile;
+  class StreamingSampler;
+  class LodPyramid;
+  struct LodHeader;
+}
+
+/*
+  A file whose contents are accessed through memory-mapped windows, so
+  only the window being read or written needs to be resident. Windows may
+  start at any offset, the alignment required by the OS is handled here.
+ */
+class sampling::MappedFile {
+ public:
+  struct View {
+    View() : base(nullptr), base_length(0), data(nullptr) {}
+    void* base;
+    std::size_t base_length;
+    char* data;
+  };
+  MappedFile();
+  ~MappedFile() { close(); }
+  bool create(const std::string& path, std::uint64_t size);
+  bool open(const std::string& path);
+  void close();
+  bool is_open() const;
+  std::uint64_t size() const { return file_size; }
+  View map(std::uint64_t offset, std::size_t length) const;
+  static void unmap(View& view);
+ private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  std::uint64_t file_size;
+  bool writable;
+#ifdef _WIN32
+  void* file_handle;
+  void* mapping_handle;
+#else
+  int descriptor;
+#endif
+};
+
+/*
+  Header of the min/max decimation pyramid (*.lod). Little-endian, followed
+  by the levels from the finest (0) to the coarsest. Level k holds one
+  (min, max) pair of doubles for every 2^(base_shift + k) samples, the
+  last bucket of a level may be partial. The coarsest level has a single
+  bucket.
+
+    offset | size | field
+         0 |    8 | magic "FPLTLOD1"
+         8 |    4 | header_size (bytes, currently 32)
+        12 |    4 | base_shift
+        16 |    8 | samples
+        24 |    4 | levels
+        28 |    4 | reserved
+ */
+struct sampling::LodHeader {
+  static const char MAGIC[8];
+  static const std::uint32_t SIZE = 32;
+  std::uint32_t base_shift = 0;
+  std::uint64_t samples = 0;
+  std::uint32_t levels = 0;
+  void encode(unsigned char* bytes) const;
+  bool decode(const unsigned char* bytes);
+  std::uint64_t bucket_count(int level) const;
+  std::uint64_t level_offset(int level) const;
+};
+
+/*
+  Evaluates a function over [lower, upper] in fixed size chunks, so the
+  number of samples is only limited by the disk. Every chunk is written
+  through a mapped window into a raw columnar file (see
+  data_export::RawHeader) and, while streaming, the min/max pyramid is
+  accumulated with one pending bucket per level. Peak memory is therefore
+  O(chunk_size + levels) no matter how many samples are taken.
+
+  @author Christian González León
+ */
+class sampling::StreamingSampler {
+ public:
+  typedef std::function<double(double)> Function;
+  explicit StreamingSampler(const Function& function)
+    : function(function), chunk_size(1 << 20), base_shift(4) {}
+  void set_chunk_size(std::size_t samples) { chunk_size = samples > 0 ? samples : 1; }
+  void set_base_shift(int shift) { base_shift = shift; }
+  bool run(double lower, double upper, std::uint64_t samples,
+           const std::string& data_path, const std::string& pyramid_path);
+ private:
+  struct Level {
+    std::vector<double> pending; // (min, max) pairs waiting to be flushed
+    std::uint64_t flushed;
+    double min, max;
+    std::uint64_t filled; // samples (level 0) or children in current bucket
+  };
+  void push_bucket(std::size_t level, double min, double max);
+  bool flush(std::size_t level);
+
+  Function function;
+  std::size_t chunk_size;
+  int base_shift;
+  MappedFile pyramid_file;
+  LodHeader pyramid_header;
+  std::vector<Level> levels;
+  bool pyramid_ok;
+};
+
+/*
+  Read side of the decimation pyramid. A plot only needs as many buckets
+  as it has pixels, so level_for picks the coarsest level that still gives
+  at least two buckets per pixel and read copies a range of that level.
+ */
+class sampling::LodPyramid {
+ public:
+  bool open(const std::string& path);
+  std::uint64_t samples() const { return header.samples; }
+  int levels() const { return header.levels; }
+  std::uint64_t bucket_count(int level) const { return header.bucket_count(level); }
+  std::uint64_t bucket_size(int level) const {
+    return std::uint64_t(1) << (header.base_shift + level);
+  }
+  int level_for(std::uint64_t visible_samples, int pixels) const;
+  bool read(int level, std::uint64_t first, std::size_t count,
+            double* min, double* max) const;
+ private:
+  MappedFile file;
+  LodHeader header;
+};
+
+#endif // STREAMING_SAMPLER_H